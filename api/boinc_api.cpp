@@ -151,6 +151,8 @@ const char* api_version = "API_VERSION_" PACKAGE_VERSION;
 static APP_INIT_DATA aid;
 static FILE_LOCK file_lock;
 APP_CLIENT_SHM* app_client_shm = 0;
+static SHMEM_RINGS* shmem_rings = 0;
+    // version 2 shared-mem rings, if the client created them
 static volatile int time_until_checkpoint;
     // time until enable checkpoint
 static volatile double fraction_done;
@@ -338,10 +340,31 @@ static int setup_shared_mem() {
 #endif
 #endif  // ! _WIN32
     if (app_client_shm == NULL) return -1;
+
+    // tell the client we'll use the rings, if it has them
+    //
+    if (aid.shmem_version >= SHMEM_VERSION) {
+        shmem_rings = &app_client_shm->shm->rings;
+        shmem_rings->app_version = SHMEM_VERSION;
+    }
     return 0;
 }
 #endif      // MSGS_FROM_FILE
 
+// Get a process-control message.
+// Check the channel first: the client may have sent something there
+// before it saw that we use the ring.
+//
+static bool get_process_control_msg(char* buf) {
+    if (app_client_shm->shm->process_control_request.get_msg(buf)) {
+        return true;
+    }
+    if (shmem_rings) {
+        return shmem_rings->process_control_request.get_msg(buf);
+    }
+    return false;
+}
+
 // a mutex for data structures shared between time and worker threads
 //
 #ifdef _WIN32
@@ -415,6 +438,22 @@ static bool update_app_progress(double cpu_t, double cp_cpu_t) {
 
     if (standalone) return true;
 
+    if (shmem_rings) {
+        APP_STATUS_REC rec;
+        rec.current_cpu_time = cpu_t;
+        rec.checkpoint_cpu_time = cp_cpu_t;
+        rec.fraction_done = -1;
+        if (fraction_done >= 0) {
+            double range = aid.fraction_done_end - aid.fraction_done_start;
+            rec.fraction_done = aid.fraction_done_start + fraction_done*range;
+        }
+        rec.bytes_sent = bytes_sent;
+        rec.bytes_received = bytes_received;
+        rec.want_network = want_network?1:0;
+        rec.other_pid = 0;
+        return shmem_rings->app_status.put(rec);
+    }
+
     sprintf(msg_buf,
         "<current_cpu_time>%e</current_cpu_time>\n"
         "<checkpoint_cpu_time>%e</checkpoint_cpu_time>\n",
@@ -454,6 +493,19 @@ static void handle_heartbeat_msg() {
     double dtemp;
     bool btemp;
 
+    if (shmem_rings) {
+        HEARTBEAT_REC hb;
+        bool found = false;
+        while (shmem_rings->heartbeat.get(hb)) {
+            found = true;
+        }
+        if (found) {
+            heartbeat_giveup_count = interrupt_count + HEARTBEAT_GIVEUP_COUNT;
+            boinc_status.working_set_size = hb.wss;
+            boinc_status.max_working_set_size = hb.max_wss;
+            boinc_status.network_suspended = (hb.network_suspended != 0);
+        }
+    }
     if (!app_client_shm->shm->heartbeat.get_msg(buf)) {
         return;
     }
@@ -523,7 +575,7 @@ static void parallel_master(int child_pid) {
         interrupt_count++;
         if (app_client_shm) {
             handle_heartbeat_msg();
-            if (app_client_shm->shm->process_control_request.get_msg(buf)) {
+            if (get_process_control_msg(buf)) {
                 if (match_tag(buf, "<suspend/>")) {
                     kill(child_pid, SIGSTOP);
                 } else if (match_tag(buf, "<resume/>")) {
@@ -965,6 +1017,18 @@ int boinc_report_app_status_aux(
     char msg_buf[MSG_CHANNEL_SIZE], buf[1024];
     if (standalone) return 0;
 
+    if (shmem_rings) {
+        APP_STATUS_REC rec;
+        rec.current_cpu_time = cpu_time;
+        rec.checkpoint_cpu_time = checkpoint_cpu_time;
+        rec.fraction_done = _fraction_done;
+        rec.bytes_sent = _bytes_sent;
+        rec.bytes_received = _bytes_received;
+        rec.want_network = 0;
+        rec.other_pid = other_pid;
+        return shmem_rings->app_status.put(rec)?0:ERR_WRITE;
+    }
+
     sprintf(msg_buf,
         "<current_cpu_time>%e</current_cpu_time>\n"
         "<checkpoint_cpu_time>%e</checkpoint_cpu_time>\n"
@@ -1162,7 +1226,7 @@ static void handle_process_control_msg() {
         return;
     }
 #else
-    if (!app_client_shm->shm->process_control_request.get_msg(buf)) {
+    if (!get_process_control_msg(buf)) {
         return;
     }
 #endif
@@ -1374,10 +1438,35 @@ DWORD WINAPI timer_thread(void *) {
 
 #else
 
+// Sleep for TIMER_PERIOD.
+// If we're using the rings, the client wakes us when it sends
+// a process-control message (suspend, resume, quit etc.);
+// handle it right away rather than at the next tick.
+//
+static void timer_sleep() {
+    if (!shmem_rings || !options.handle_process_control) {
+        boinc_sleep(TIMER_PERIOD);
+        return;
+    }
+    double end = dtime() + TIMER_PERIOD;
+    while (1) {
+        double dt = end - dtime();
+        if (dt <= 0) break;
+        shmem_rings->process_control_request.wait(dt);
+        if (!shmem_rings->process_control_request.has_msg()) continue;
+        if (boinc_disable_timer_thread || finishing) {
+            dt = end - dtime();
+            if (dt > 0) boinc_sleep(dt);
+            break;
+        }
+        handle_process_control_msg();
+    }
+}
+
 static void* timer_thread(void*) {
     block_sigalrm();
     while(1) {
-        boinc_sleep(TIMER_PERIOD);
+        timer_sleep();
         timer_handler();
     }
     return 0;
@@ -101,6 +101,12 @@ ACTIVE_TASK::ACTIVE_TASK() {
     wup = NULL;
     app_version = NULL;
     pid = 0;
+#ifdef __linux__
+    cgroup_dir[0] = 0;
+    cgroup_cpu_quota = -1;
+    cgroup_mem_max = -1;
+    cgroup_frozen = false;
+#endif
 
     _task_state = PROCESS_UNINITIALIZED;
     slot = 0;
@@ -271,6 +277,9 @@ void ACTIVE_TASK::cleanup_task() {
 #endif
 
     kill_subsidiary_processes();
+#ifdef __linux__
+    cgroup_remove();
+#endif
 
     if (cc_config.exit_after_finish) {
         gstate.write_state_file();
@@ -370,7 +379,34 @@ void ACTIVE_TASK_SET::get_memory_usage() {
 
     last_mem_time = gstate.now;
     PROC_MAP pm;
-    retval = procinfo_setup(pm);
+
+    // On Linux, if we don't need to look for exclusive apps,
+    // get info only for our tasks and their descendants,
+    // and get the CPU usage of other processes from system totals.
+    //
+    bool tasks_only = false;
+#ifdef __linux__
+    tasks_only = procinfo_children_supported()
+        && cc_config.exclusive_apps.empty()
+        && cc_config.exclusive_gpu_apps.empty();
+#endif
+    if (tasks_only) {
+#ifdef __linux__
+        vector<int> pids;
+        for (i=0; i<active_tasks.size(); i++) {
+            ACTIVE_TASK* atp = active_tasks[i];
+            if (atp->task_state() == PROCESS_UNINITIALIZED) continue;
+            if (atp->pid ==0) continue;
+            pids.push_back(atp->pid);
+            for (unsigned int j=0; j<atp->other_pids.size(); j++) {
+                pids.push_back(atp->other_pids[j]);
+            }
+        }
+        retval = procinfo_setup_pids(pm, pids);
+#endif
+    } else {
+        retval = procinfo_setup(pm);
+    }
     if (retval) {
         if (log_flags.mem_usage_debug) {
             msg_printf(NULL, MSG_INTERNAL_ERROR,
@@ -384,6 +420,7 @@ void ACTIVE_TASK_SET::get_memory_usage() {
         boinc_total.clear();
         boinc_total.working_set_size_smoothed = 0;
     }
+    double boinc_cpu_delta = 0;
     for (i=0; i<active_tasks.size(); i++) {
         ACTIVE_TASK* atp = active_tasks[i];
         if (atp->task_state() == PROCESS_UNINITIALIZED) continue;
@@ -398,6 +435,7 @@ void ACTIVE_TASK_SET::get_memory_usage() {
 
         PROCINFO& pi = atp->procinfo;
         unsigned long last_page_fault_count = pi.page_fault_count;
+        double last_task_cpu = pi.user_time + pi.kernel_time;
         pi.clear();
         pi.id = atp->pid;
         vector<int>* v = NULL;
@@ -405,6 +443,11 @@ void ACTIVE_TASK_SET::get_memory_usage() {
             v = &(atp->other_pids);
         }
         procinfo_app(pi, v, pm, atp->app_version->graphics_exec_file);
+#ifdef __linux__
+        if (atp->cgroup_dir[0]) {
+            atp->cgroup_get_usage(pi);
+        }
+#endif
         if (atp->app_version->is_vm_app) {
             // the memory of virtual machine apps is not reported correctly,
             // at least on Windows.  Use the VM size instead.
@@ -420,6 +463,10 @@ void ACTIVE_TASK_SET::get_memory_usage() {
         if (pi.swap_size > atp->peak_swap_size) {
             atp->peak_swap_size = pi.swap_size;
         }
+        double task_cpu = pi.user_time + pi.kernel_time;
+        if (task_cpu > last_task_cpu) {
+            boinc_cpu_delta += task_cpu - last_task_cpu;
+        }
 
         if (!first) {
             int pf = pi.page_fault_count - last_page_fault_count;
@@ -486,18 +533,59 @@ void ACTIVE_TASK_SET::get_memory_usage() {
     // not all of them generate disk I/O,
     // so they're not useful for detecting paging/thrashing.
     //
-    PROCINFO pi;
-    procinfo_non_boinc(pi, pm);
-    if (log_flags.mem_usage_debug) {
-        //procinfo_show(pm);
-        msg_printf(NULL, MSG_INFO,
-            "[mem_usage] All others: WS %.2fMB, swap %.2fMB, user %.3fs, kernel %.3fs",
-            pi.working_set_size/MEGA, pi.swap_size/MEGA,
-            pi.user_time, pi.kernel_time
-        );
+    double new_cpu_time;
+    if (tasks_only) {
+#ifdef __linux__
+        // BOINC apps normally run niced, so most of their CPU time
+        // is in the system "nice" total;
+        // subtract that, then whatever of theirs wasn't niced,
+        // then the CPU time of this process.
+        // Other niced processes are low-priority; don't count them.
+        //
+        static double last_busy=0, last_nice=0, last_self=0, total=0;
+        double busy, nice, self;
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        self = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec/1e6
+            + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec/1e6;
+        if (!procinfo_system_cpu(busy, nice)) {
+            if (last_busy) {
+                double d_nice = nice - last_nice;
+                double d_other = (busy - last_busy) - d_nice;
+                double d_boinc = boinc_cpu_delta - d_nice;
+                if (d_boinc > 0) d_other -= d_boinc;
+                d_other -= self - last_self;
+                if (d_other > 0) total += d_other;
+            }
+            last_busy = busy;
+            last_nice = nice;
+        }
+        last_self = self;
+        new_cpu_time = total;
+        if (log_flags.mem_usage_debug) {
+            msg_printf(NULL, MSG_INFO,
+                "[mem_usage] All others: CPU %.3fs", total
+            );
+        }
+#endif
+    } else {
+        PROCINFO pi;
+        procinfo_non_boinc(pi, pm);
+        if (log_flags.mem_usage_debug) {
+            //procinfo_show(pm);
+            msg_printf(NULL, MSG_INFO,
+                "[mem_usage] All others: WS %.2fMB, swap %.2fMB, user %.3fs, kernel %.3fs",
+                pi.working_set_size/MEGA, pi.swap_size/MEGA,
+                pi.user_time, pi.kernel_time
+            );
+        }
+        new_cpu_time = pi.user_time + pi.kernel_time;
     }
-    double new_cpu_time = pi.user_time + pi.kernel_time;
-    if (!first) {
+    // the two methods measure different things;
+    // if we changed methods, wait for another sample
+    //
+    static bool last_tasks_only = false;
+    if (!first && tasks_only == last_tasks_only) {
         non_boinc_cpu_usage = (new_cpu_time - last_cpu_time)/(diff*gstate.host_info.p_ncpus);
         // processes might have exited in the last 10 sec,
         // causing this to be negative.
@@ -509,6 +597,7 @@ void ACTIVE_TASK_SET::get_memory_usage() {
         }
     }
     last_cpu_time = new_cpu_time;
+    last_tasks_only = tasks_only;
     first = false;
 }
 
@@ -950,8 +1039,16 @@ void MSG_QUEUE::init(char* n) {
     msgs.clear();
 }
 
-void MSG_QUEUE::msg_queue_send(const char* msg, MSG_CHANNEL& channel) {
-    if ((msgs.size()==0) && channel.send_msg(msg)) {
+static inline bool send_msg(
+    const char* msg, MSG_CHANNEL& channel, MSG_RING* ring
+) {
+    return ring?ring->send_msg(msg):channel.send_msg(msg);
+}
+
+void MSG_QUEUE::msg_queue_send(
+    const char* msg, MSG_CHANNEL& channel, MSG_RING* ring
+) {
+    if ((msgs.size()==0) && send_msg(msg, channel, ring)) {
         if (log_flags.app_msg_send) {
             msg_printf(NULL, MSG_INFO,
                 "[app_msg_send] sent %s to %s", msg, name
@@ -969,7 +1066,7 @@ void MSG_QUEUE::msg_queue_send(const char* msg, MSG_CHANNEL& channel) {
     if (!last_block) last_block = gstate.now;
 }
 
-void MSG_QUEUE::msg_queue_poll(MSG_CHANNEL& channel) {
+void MSG_QUEUE::msg_queue_poll(MSG_CHANNEL& channel, MSG_RING* ring) {
     if (msgs.empty()) return;
     if (log_flags.app_msg_send) {
         msg_printf(NULL, MSG_INFO,
@@ -977,7 +1074,9 @@ void MSG_QUEUE::msg_queue_poll(MSG_CHANNEL& channel) {
             (int)msgs.size(), name
         );
     }
-    if (channel.send_msg(msgs[0].c_str())) {
+    // a channel holds one message; a ring may take several
+    //
+    while (msgs.size() && send_msg(msgs[0].c_str(), channel, ring)) {
         if (log_flags.app_msg_send) {
             msg_printf(NULL, MSG_INFO,
                 "[app_msg_send] poll: delayed sent %s", msgs[0].c_str()
@@ -1170,6 +1269,20 @@ void* throttler(void*) {
 
     while (1) {
         client_mutex.lock();
+#ifdef __linux__
+        // tasks in cgroups are throttled by cpu.max.
+        // Others (VM apps, or if the cgroup couldn't be created)
+        // are throttled by suspending and resuming them, as usual
+        //
+        if (cgroups_usable()) {
+            gstate.active_tasks.cgroup_set_limits();
+            if (!gstate.active_tasks.need_suspend_throttle()) {
+                client_mutex.unlock();
+                boinc_sleep(CGROUP_LIMITS_PERIOD);
+                continue;
+            }
+        }
+#endif
         if (gstate.tasks_suspended
             || gstate.global_prefs.cpu_usage_limit > 99
             || gstate.global_prefs.cpu_usage_limit < 0.005
@@ -162,6 +162,16 @@ struct ACTIVE_TASK {
         // core/app shared mem segment
     MSG_QUEUE graphics_request_queue;
     MSG_QUEUE process_control_queue;
+    SHMEM_RINGS* shmem_rings() {
+        // the version 2 rings, if the app is using them
+        if (!app_client_shm.shm) return NULL;
+        if (app_client_shm.shm->rings.app_version < SHMEM_VERSION) return NULL;
+        return &app_client_shm.shm->rings;
+    }
+    MSG_RING* process_control_ring() {
+        SHMEM_RINGS* r = shmem_rings();
+        return r?&r->process_control_request:NULL;
+    }
     std::vector<int> other_pids;
         // IDs of processes that are part of this task
         // but not descendants of the main process
@@ -173,6 +183,23 @@ struct ACTIVE_TASK {
     double finish_file_time;
         // time when we saw finish file in slot dir.
         // Used to kill apps that hang after writing finished file
+#ifdef __linux__
+    char cgroup_dir[MAXPATHLEN];
+        // if nonempty, the cgroup (v2) the task runs in
+    double cgroup_cpu_quota;
+        // last value written to cpu.max (usec per 100 ms; 0 = no limit)
+    double cgroup_mem_max;
+        // last value written to memory.max
+    bool cgroup_frozen;
+        // suspended using cgroup.freeze
+    int cgroup_create();
+    int cgroup_enter(int pid);
+    void cgroup_remove();
+    void cgroup_set_limits();
+    int cgroup_freeze(bool);
+    void cgroup_get_usage(PROCINFO&);
+    bool cgroup_cpu_limited();
+#endif
 
     void set_task_state(int, const char*);
     inline int task_state() {
@@ -272,6 +299,7 @@ struct ACTIVE_TASK {
     bool check_max_disk_exceeded();
 
     bool get_app_status_msg();
+    void handle_app_status(APP_STATUS_REC&);
     bool get_trickle_up_msg();
     void get_graphics_msg();
     double est_dur();
@@ -326,6 +354,10 @@ public:
     bool want_network();    // does any task want network?
     void network_available();   // notify tasks that network is available
     void free_mem();
+#ifdef __linux__
+    void cgroup_set_limits();
+    bool need_suspend_throttle();
+#endif
     bool slot_taken(int);
     void get_memory_usage();
 
@@ -344,6 +376,11 @@ extern double non_boinc_cpu_usage;
 
 extern void run_test_app();
 
+#ifdef __linux__
+extern bool cgroups_usable();
+    // <use_cgroups> is set and per-task cgroups can be created
+#endif
+
 #ifdef _WIN32
 extern DWORD WINAPI throttler(void*);
 #else
@@ -56,6 +56,11 @@
 #if HAVE_SYS_WAIT_H
 #include <sys/wait.h>
 #endif
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
 
 #include <vector>
 
@@ -194,10 +199,14 @@ static void print_descendants(int pid, vector<int>desc, const char* where) {
 // Send a quit message, start timer, get descendants
 //
 int ACTIVE_TASK::request_exit() {
+#ifdef __linux__
+    if (cgroup_frozen) cgroup_freeze(false);
+#endif
     if (app_client_shm.shm) {
         process_control_queue.msg_queue_send(
             "<quit/>",
-            app_client_shm.shm->process_control_request
+            app_client_shm.shm->process_control_request,
+            process_control_ring()
         );
     }
     set_task_state(PROCESS_QUIT_PENDING, "request_exit()");
@@ -212,10 +221,14 @@ int ACTIVE_TASK::request_exit() {
 // Send an abort message, start timer, get descendants
 //
 int ACTIVE_TASK::request_abort() {
+#ifdef __linux__
+    if (cgroup_frozen) cgroup_freeze(false);
+#endif
     if (app_client_shm.shm) {
         process_control_queue.msg_queue_send(
             "<abort/>",
-            app_client_shm.shm->process_control_request
+            app_client_shm.shm->process_control_request,
+            process_control_ring()
         );
     }
     set_task_state(PROCESS_ABORT_PENDING, "request_abort");
@@ -693,15 +706,25 @@ void ACTIVE_TASK_SET::send_heartbeats() {
         atp = active_tasks[i];
         if (!atp->process_exists()) continue;
         if (!atp->app_client_shm.shm) continue;
-        snprintf(buf, sizeof(buf), "<heartbeat/>"
-            "<wss>%e</wss>"
-            "<max_wss>%e</max_wss>",
-            atp->procinfo.working_set_size, ar
-        );
-        if (gstate.network_suspended) {
-            safe_strcat(buf, "<network_suspended/>");
+        bool sent;
+        SHMEM_RINGS* rings = atp->shmem_rings();
+        if (rings) {
+            HEARTBEAT_REC hb;
+            hb.wss = atp->procinfo.working_set_size;
+            hb.max_wss = ar;
+            hb.network_suspended = gstate.network_suspended?1:0;
+            sent = rings->heartbeat.put(hb);
+        } else {
+            snprintf(buf, sizeof(buf), "<heartbeat/>"
+                "<wss>%e</wss>"
+                "<max_wss>%e</max_wss>",
+                atp->procinfo.working_set_size, ar
+            );
+            if (gstate.network_suspended) {
+                safe_strcat(buf, "<network_suspended/>");
+            }
+            sent = atp->app_client_shm.shm->heartbeat.send_msg(buf);
         }
-        bool sent = atp->app_client_shm.shm->heartbeat.send_msg(buf);
         if (log_flags.heartbeat_debug) {
             if (sent) {
                 msg_printf(atp->result->project, MSG_INFO,
@@ -741,7 +764,8 @@ void ACTIVE_TASK_SET::process_control_poll() {
             atp->kill_running_task(true);
         } else {
             atp->process_control_queue.msg_queue_poll(
-                atp->app_client_shm.shm->process_control_request
+                atp->app_client_shm.shm->process_control_request,
+                atp->process_control_ring()
             );
         }
     }
@@ -1030,7 +1054,8 @@ int ACTIVE_TASK::request_reread_app_info() {
     if (retval) return retval;
     process_control_queue.msg_queue_send(
         "<reread_app_info/>",
-        app_client_shm.shm->process_control_request
+        app_client_shm.shm->process_control_request,
+        process_control_ring()
     );
     return 0;
 }
@@ -1193,6 +1218,9 @@ void ACTIVE_TASK_SET::suspend_all(int reason) {
         //
         if (reason == SUSPEND_REASON_CPU_THROTTLE) {
             if (atp->result->dont_throttle()) continue;
+#ifdef __linux__
+            if (atp->cgroup_cpu_limited()) continue;
+#endif
             atp->preempt(REMOVE_NEVER, reason);
             continue;
         }
@@ -1312,11 +1340,21 @@ int ACTIVE_TASK::suspend() {
             result->name
         );
     }
+#ifdef __linux__
+    // VM apps need to be told to suspend the VM,
+    // which isn't in the task's cgroup
+    //
+    if (cgroup_dir[0] && !app_version->is_vm_app && !cgroup_freeze(true)) {
+        set_task_state(PROCESS_SUSPENDED, "suspend");
+        return 0;
+    }
+#endif
     int n = process_control_queue.msg_queue_purge("<resume/>");
     if (n == 0) {
         process_control_queue.msg_queue_send(
             "<suspend/>",
-            app_client_shm.shm->process_control_request
+            app_client_shm.shm->process_control_request,
+            process_control_ring()
         );
     }
     set_task_state(PROCESS_SUSPENDED, "suspend");
@@ -1337,22 +1375,343 @@ int ACTIVE_TASK::unsuspend(int reason) {
             "[cpu_sched] Resuming %s", result->name
         );
     }
+#ifdef __linux__
+    if (cgroup_frozen) {
+        cgroup_freeze(false);
+        set_task_state(PROCESS_EXECUTING, "unsuspend");
+        return 0;
+    }
+#endif
     int n = process_control_queue.msg_queue_purge("<suspend/>");
     if (n == 0) {
         process_control_queue.msg_queue_send(
             "<resume/>",
-            app_client_shm.shm->process_control_request
+            app_client_shm.shm->process_control_request,
+            process_control_ring()
         );
     }
     set_task_state(PROCESS_EXECUTING, "unsuspend");
     return 0;
 }
 
+#ifdef __linux__
+// Per-task cgroups (cgroup v2).
+//
+// If <use_cgroups> is set, the client moves itself into a leaf cgroup
+// "boinc_client" below the cgroup it was started in,
+// enables the cpu and memory controllers there,
+// and runs each task in a sibling cgroup "slot_N".
+// This requires that the client's cgroup be delegated to it
+// (e.g. Delegate=yes in the systemd unit file).
+// Then
+// - CPU throttling is done with cpu.max, rather than by
+//   suspending and resuming tasks every few seconds
+// - memory.max is set to the client's RAM limit when the computer
+//   is not in use (the larger limit; when in use, tasks are
+//   preempted rather than killed by the OOM killer)
+// - tasks (except VM apps) are suspended with cgroup.freeze
+// - CPU time and memory usage include all the task's processes,
+//   even those that have exited
+// If any of this fails we fall back to the usual mechanisms.
+
+static char cgroup_base[MAXPATHLEN];
+static int cgroup_status = 0;
+    // 0 = not checked yet, 1 = usable, -1 = not usable
+
+static int write_cgroup_file(const char* dir, const char* name, const char* val) {
+    char path[MAXPATHLEN];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        return ERR_BUFFER_OVERFLOW;
+    }
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return ERR_FOPEN;
+    ssize_t n = write(fd, val, strlen(val));
+    close(fd);
+    if (n != (ssize_t)strlen(val)) return ERR_WRITE;
+    return 0;
+}
+
+// read "key value" lines (cpu.stat, memory.stat)
+//
+static bool read_cgroup_stat(const char* dir, const char* name, const char* key, double& x) {
+    char path[MAXPATHLEN], buf[256];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        return false;
+    }
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    size_t n = strlen(key);
+    bool found = false;
+    while (fgets(buf, sizeof(buf), f)) {
+        if (!strncmp(buf, key, n) && buf[n] == ' ') {
+            x = atof(buf+n+1);
+            found = true;
+            break;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static bool cgroup_setup() {
+    char buf[MAXPATHLEN], path[MAXPATHLEN], leaf[MAXPATHLEN];
+
+    // with cgroup v2, /proc/self/cgroup has a line "0::/path"
+    //
+    FILE* f = fopen("/proc/self/cgroup", "r");
+    if (!f) return false;
+    bool found = false;
+    while (fgets(buf, sizeof(buf), f)) {
+        if (strstr(buf, "0::") == buf) {
+            strip_whitespace(buf);
+            safe_strcpy(path, buf+3);
+            found = true;
+            break;
+        }
+    }
+    fclose(f);
+    if (!found) {
+        msg_printf(NULL, MSG_INFO, "cgroup v2 not available; not using cgroups");
+        return false;
+    }
+    if (!strcmp(path, "/")) {
+        msg_printf(NULL, MSG_INFO, "client is in root cgroup; not using cgroups");
+        return false;
+    }
+
+    // we may have been restarted from within our own leaf
+    //
+    char* p = strrchr(path, '/');
+    if (p && !strcmp(p, "/boinc_client")) {
+        *p = 0;
+    }
+    if (snprintf(cgroup_base, sizeof(cgroup_base), "/sys/fs/cgroup%s", path)
+        >= (int)sizeof(cgroup_base)
+    ) {
+        return false;
+    }
+
+    // A cgroup with controllers enabled for its children can't
+    // contain processes, so move ourselves to a leaf
+    //
+    if (snprintf(leaf, sizeof(leaf), "%s/boinc_client", cgroup_base)
+        >= (int)sizeof(leaf)
+    ) {
+        return false;
+    }
+    if (mkdir(leaf, 0755) && errno != EEXIST) {
+        msg_printf(NULL, MSG_INFO,
+            "Can't create cgroup %s: %s; not using cgroups", leaf, strerror(errno)
+        );
+        return false;
+    }
+    snprintf(buf, sizeof(buf), "%d", getpid());
+    if (write_cgroup_file(leaf, "cgroup.procs", buf)) {
+        msg_printf(NULL, MSG_INFO,
+            "Can't move client to cgroup %s; not using cgroups", leaf
+        );
+        return false;
+    }
+    if (write_cgroup_file(cgroup_base, "cgroup.subtree_control", "+cpu +memory")) {
+        msg_printf(NULL, MSG_INFO,
+            "Can't enable cpu and memory controllers in %s; not using cgroups",
+            cgroup_base
+        );
+        // go back where we were, so that things are as we found them
+        //
+        write_cgroup_file(cgroup_base, "cgroup.procs", buf);
+        rmdir(leaf);
+        return false;
+    }
+
+    // thaw tasks left frozen by a previous run,
+    // so that they notice the client is gone
+    //
+    DIR* dir = opendir(cgroup_base);
+    if (dir) {
+        while (1) {
+            dirent* de = readdir(dir);
+            if (!de) break;
+            if (strstr(de->d_name, "slot_") != de->d_name) continue;
+            if (snprintf(path, sizeof(path), "%s/%s", cgroup_base, de->d_name)
+                >= (int)sizeof(path)
+            ) {
+                continue;
+            }
+            write_cgroup_file(path, "cgroup.freeze", "0");
+        }
+        closedir(dir);
+    }
+
+    msg_printf(NULL, MSG_INFO, "Running tasks in cgroups under %s", cgroup_base);
+    return true;
+}
+
+bool cgroups_usable() {
+    if (!cc_config.use_cgroups) return false;
+    if (!cgroup_status) {
+        cgroup_status = cgroup_setup()?1:-1;
+    }
+    return cgroup_status > 0;
+}
+
+// create the task's cgroup; called before the process is created
+//
+int ACTIVE_TASK::cgroup_create() {
+    cgroup_dir[0] = 0;
+    if (!cgroups_usable()) return 0;
+    char dir[MAXPATHLEN];
+    if (snprintf(dir, sizeof(dir), "%s/slot_%d", cgroup_base, slot)
+        >= (int)sizeof(dir)
+    ) {
+        return ERR_BUFFER_OVERFLOW;
+    }
+    if (mkdir(dir, 0755) && errno != EEXIST) {
+        msg_printf(wup->project, MSG_INTERNAL_ERROR,
+            "Can't create cgroup %s: %s", dir, strerror(errno)
+        );
+        return ERR_MKDIR;
+    }
+    write_cgroup_file(dir, "cgroup.freeze", "0");
+    safe_strcpy(cgroup_dir, dir);
+    cgroup_cpu_quota = -1;
+    cgroup_mem_max = -1;
+    cgroup_frozen = false;
+    cgroup_set_limits();
+    return 0;
+}
+
+// move a process into the task's cgroup.
+// Called both in the new process, before exec()
+// (so that the app's children are created in the cgroup)
+// and in the client, which checks that the move worked.
+//
+int ACTIVE_TASK::cgroup_enter(int p) {
+    char buf[64];
+    if (!cgroup_dir[0]) return 0;
+    snprintf(buf, sizeof(buf), "%d", p);
+    return write_cgroup_file(cgroup_dir, "cgroup.procs", buf);
+}
+
+// remove the cgroup after the task's processes have exited.
+// If some are still around this fails; we'll reuse it later.
+//
+void ACTIVE_TASK::cgroup_remove() {
+    if (!cgroup_dir[0]) return;
+    if (cgroup_frozen) {
+        cgroup_freeze(false);
+    }
+    rmdir(cgroup_dir);
+    cgroup_dir[0] = 0;
+}
+
+// Set the task's CPU limit (from the CPU usage limit pref)
+// and memory limit (from the RAM usage pref for when the computer
+// isn't in use; this doesn't change when the user becomes active,
+// since the client enforces the in-use limit by preempting tasks)
+//
+void ACTIVE_TASK::cgroup_set_limits() {
+    char buf[256];
+    if (!cgroup_dir[0]) return;
+
+    double quota = 0;
+    double limit = gstate.global_prefs.cpu_usage_limit;
+    if (limit >= 0.005 && limit <= 99 && !result->dont_throttle()) {
+        double ncpus = app_version->avg_ncpus;
+        if (ncpus < 1) ncpus = 1;
+        quota = ncpus * limit/100 * CGROUP_CPU_PERIOD;
+        if (quota < 1000) quota = 1000;
+    }
+    if (quota != cgroup_cpu_quota) {
+        if (quota) {
+            snprintf(buf, sizeof(buf), "%.0f %d", quota, CGROUP_CPU_PERIOD);
+        } else {
+            snprintf(buf, sizeof(buf), "max %d", CGROUP_CPU_PERIOD);
+        }
+        if (!write_cgroup_file(cgroup_dir, "cpu.max", buf)) {
+            cgroup_cpu_quota = quota;
+            if (log_flags.task_debug) {
+                msg_printf(result->project, MSG_INFO,
+                    "[task] %s: cpu.max %s", result->name, buf
+                );
+            }
+        }
+    }
+
+    double mem_max = gstate.host_info.m_nbytes
+        * gstate.global_prefs.ram_max_used_idle_frac;
+    if (mem_max != cgroup_mem_max) {
+        snprintf(buf, sizeof(buf), "%.0f", mem_max);
+        if (!write_cgroup_file(cgroup_dir, "memory.max", buf)) {
+            cgroup_mem_max = mem_max;
+        }
+    }
+}
+
+// is the task's CPU usage limited by cpu.max?
+// If not, it has to be throttled by suspending and resuming it.
+//
+bool ACTIVE_TASK::cgroup_cpu_limited() {
+    if (!cgroup_dir[0]) return false;
+    if (app_version->is_vm_app) return false;
+    return cgroup_cpu_quota > 0;
+}
+
+// are there running tasks that need throttling but aren't limited by cpu.max?
+//
+bool ACTIVE_TASK_SET::need_suspend_throttle() {
+    double limit = gstate.global_prefs.cpu_usage_limit;
+    if (limit < 0.005 || limit > 99) return false;
+    for (unsigned int i=0; i<active_tasks.size(); i++) {
+        ACTIVE_TASK* atp = active_tasks[i];
+        if (!atp->process_exists()) continue;
+        if (atp->result->dont_throttle()) continue;
+        if (atp->cgroup_cpu_limited()) continue;
+        return true;
+    }
+    return false;
+}
+
+void ACTIVE_TASK_SET::cgroup_set_limits() {
+    for (unsigned int i=0; i<active_tasks.size(); i++) {
+        ACTIVE_TASK* atp = active_tasks[i];
+        if (!atp->process_exists()) continue;
+        atp->cgroup_set_limits();
+    }
+}
+
+// freeze or thaw all the task's processes
+//
+int ACTIVE_TASK::cgroup_freeze(bool freeze) {
+    if (!cgroup_dir[0]) return ERR_NOT_FOUND;
+    int retval = write_cgroup_file(cgroup_dir, "cgroup.freeze", freeze?"1":"0");
+    if (retval) return retval;
+    cgroup_frozen = freeze;
+    return 0;
+}
+
+// get CPU time and memory usage of all the task's processes
+//
+void ACTIVE_TASK::cgroup_get_usage(PROCINFO& pi) {
+    double x;
+    if (read_cgroup_stat(cgroup_dir, "cpu.stat", "user_usec", x)) {
+        pi.user_time = x/1e6;
+    }
+    if (read_cgroup_stat(cgroup_dir, "cpu.stat", "system_usec", x)) {
+        pi.kernel_time = x/1e6;
+    }
+    if (read_cgroup_stat(cgroup_dir, "memory.stat", "anon", x)) {
+        pi.working_set_size = x;
+    }
+}
+#endif
+
 void ACTIVE_TASK::send_network_available() {
     if (!app_client_shm.shm) return;
     process_control_queue.msg_queue_send(
         "<network_available/>",
-        app_client_shm.shm->process_control_request
+        app_client_shm.shm->process_control_request,
+        process_control_ring()
     );
     return;
 }
@@ -1363,10 +1722,8 @@ void ACTIVE_TASK::send_network_available() {
 //
 bool ACTIVE_TASK::get_app_status_msg() {
     char msg_buf[MSG_CHANNEL_SIZE];
-    double fd;
-    int other_pid;
     double dtemp;
-    static double last_msg_time=0;
+    APP_STATUS_REC rec;
 
     if (!app_client_shm.shm) {
         msg_printf(result->project, MSG_INFO,
@@ -1374,6 +1731,29 @@ bool ACTIVE_TASK::get_app_status_msg() {
         );
         return false;
     }
+
+    // the app may have sent several records since we last looked;
+    // only the latest matters
+    //
+    SHMEM_RINGS* rings = shmem_rings();
+    if (rings) {
+        bool found = false;
+        while (rings->app_status.get(rec)) {
+            found = true;
+        }
+        if (found) {
+            if (log_flags.app_msg_receive) {
+                msg_printf(this->wup->project, MSG_INFO,
+                    "[app_msg_receive] got status from slot %d: CPU %f checkpoint CPU %f fraction done %f",
+                    slot, rec.current_cpu_time, rec.checkpoint_cpu_time,
+                    rec.fraction_done
+                );
+            }
+            handle_app_status(rec);
+            return true;
+        }
+    }
+
     if (!app_client_shm.shm->app_status.get_msg(msg_buf)) {
         return false;
     }
@@ -1382,57 +1762,76 @@ bool ACTIVE_TASK::get_app_status_msg() {
             "[app_msg_receive] got msg from slot %d: %s", slot, msg_buf
         );
     }
-    want_network = 0;
-    current_cpu_time = checkpoint_cpu_time = 0.0;
-    if (parse_double(msg_buf, "<fraction_done>", fd)) {
-        // fraction_done will be reported as zero
-        // until the app's first call to boinc_fraction_done().
-        // So ignore zeros.
-        //
-        if (fd) {
-            fraction_done = fd;
-            fraction_done_elapsed_time = elapsed_time;
-            if (!first_fraction_done) {
-                first_fraction_done = fd;
-                first_fraction_done_elapsed_time = elapsed_time;
-            }
-            if (log_flags.task_debug && (fd<0 || fd>1)) {
-                if (gstate.now > last_msg_time + 60) {
-                    msg_printf(this->wup->project, MSG_INFO,
-                        "[task_debug] app reported bad fraction done: %f", fd
-                    );
-                    last_msg_time = gstate.now;
-                }
-            }
-        }
-    }
-    parse_double(msg_buf, "<current_cpu_time>", current_cpu_time);
-    parse_double(msg_buf, "<checkpoint_cpu_time>", checkpoint_cpu_time);
+    memset(&rec, 0, sizeof(rec));
+    rec.fraction_done = -1;
+    parse_double(msg_buf, "<fraction_done>", rec.fraction_done);
+    parse_double(msg_buf, "<current_cpu_time>", rec.current_cpu_time);
+    parse_double(msg_buf, "<checkpoint_cpu_time>", rec.checkpoint_cpu_time);
     parse_double(msg_buf, "<fpops_per_cpu_sec>", result->fpops_per_cpu_sec);
     parse_double(msg_buf, "<fpops_cumulative>", result->fpops_cumulative);
     parse_double(msg_buf, "<intops_per_cpu_sec>", result->intops_per_cpu_sec);
     parse_double(msg_buf, "<intops_cumulative>", result->intops_cumulative);
     if (parse_double(msg_buf, "<bytes_sent>", dtemp)) {
-        if (dtemp > bytes_sent_episode) {
-            double nbytes = dtemp - bytes_sent_episode;
+        rec.bytes_sent = dtemp;
+    }
+    if (parse_double(msg_buf, "<bytes_received>", dtemp)) {
+        rec.bytes_received = dtemp;
+    }
+    parse_int(msg_buf, "<want_network>", rec.want_network);
+    parse_int(msg_buf, "<other_pid>", rec.other_pid);
+    handle_app_status(rec);
+    return true;
+}
+
+// update the task from a status message or record
+//
+void ACTIVE_TASK::handle_app_status(APP_STATUS_REC& rec) {
+    static double last_msg_time=0;
+    double fd = rec.fraction_done;
+
+    // fraction_done will be reported as zero
+    // until the app's first call to boinc_fraction_done().
+    // So ignore zeros.
+    //
+    if (fd != -1 && fd) {
+        fraction_done = fd;
+        fraction_done_elapsed_time = elapsed_time;
+        if (!first_fraction_done) {
+            first_fraction_done = fd;
+            first_fraction_done_elapsed_time = elapsed_time;
+        }
+        if (log_flags.task_debug && (fd<0 || fd>1)) {
+            if (gstate.now > last_msg_time + 60) {
+                msg_printf(this->wup->project, MSG_INFO,
+                    "[task_debug] app reported bad fraction done: %f", fd
+                );
+                last_msg_time = gstate.now;
+            }
+        }
+    }
+    current_cpu_time = rec.current_cpu_time;
+    checkpoint_cpu_time = rec.checkpoint_cpu_time;
+    if (rec.bytes_sent) {
+        if (rec.bytes_sent > bytes_sent_episode) {
+            double nbytes = rec.bytes_sent - bytes_sent_episode;
             daily_xfer_history.add(nbytes, true);
             bytes_sent += nbytes;
         }
-        bytes_sent_episode = dtemp;
+        bytes_sent_episode = rec.bytes_sent;
     }
-    if (parse_double(msg_buf, "<bytes_received>", dtemp)) {
-        if (dtemp > bytes_received_episode) {
-            double nbytes = dtemp - bytes_received_episode;
+    if (rec.bytes_received) {
+        if (rec.bytes_received > bytes_received_episode) {
+            double nbytes = rec.bytes_received - bytes_received_episode;
             daily_xfer_history.add(nbytes, false);
             bytes_received += nbytes;
         }
-        bytes_received_episode = dtemp;
+        bytes_received_episode = rec.bytes_received;
     }
-    parse_int(msg_buf, "<want_network>", want_network);
-    if (parse_int(msg_buf, "<other_pid>", other_pid)) {
+    want_network = rec.want_network;
+    if (rec.other_pid) {
         // for now, we handle only one of these
         other_pids.clear();
-        other_pids.push_back(other_pid);
+        other_pids.push_back(rec.other_pid);
     }
     if (current_cpu_time < 0) {
         msg_printf(result->project, MSG_INFO,
@@ -1446,7 +1845,6 @@ bool ACTIVE_TASK::get_app_status_msg() {
         );
         checkpoint_cpu_time = 0;
     }
-    return true;
 }
 
 void ACTIVE_TASK::get_graphics_msg() {
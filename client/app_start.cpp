@@ -281,6 +281,7 @@ void ACTIVE_TASK::init_app_init_data(APP_INIT_DATA& aid) {
 #else
     aid.shmem_seg_name = shmem_seg_name;
 #endif
+    aid.shmem_version = SHMEM_VERSION;
     aid.wu_cpu_time = checkpoint_cpu_time;
     APP_VERSION* avp = app_version;
     for (unsigned int i=0; i<avp->app_files.size(); i++) {
@@ -903,6 +904,19 @@ int ACTIVE_TASK::start(bool test) {
         );
     }
 
+#ifdef __linux__
+    // The child can't tell us if it couldn't enter the cgroup.
+    // Move it ourselves (this is a no-op if it's already there);
+    // if that fails, suspend and throttle the task with signals instead
+    //
+    if (cgroup_dir[0] && cgroup_enter(pid)) {
+        msg_printf(wup->project, MSG_INTERNAL_ERROR,
+            "Can't move task %s to cgroup %s", result->name, cgroup_dir
+        );
+        cgroup_remove();
+    }
+#endif
+
     if (!cc_config.no_priority_change) {
         int priority = get_priority(high_priority);
         if (setpriority(PRIO_PROCESS, pid, priority)) {
@@ -988,6 +1002,11 @@ int ACTIVE_TASK::start(bool test) {
         set_task_state(PROCESS_EXECUTING, "start");
         return 0;
     }
+#ifdef __linux__
+    // if this fails the task runs in the client's cgroup
+    //
+    cgroup_create();
+#endif
     pid = fork();
     if (pid == -1) {
         snprintf(buf, sizeof(buf), "fork() failed: %s", strerror(errno));
@@ -999,6 +1018,15 @@ int ACTIVE_TASK::start(bool test) {
         // If an error happens,
         // exit nonzero so that the client knows there was a problem.
 
+#ifdef __linux__
+        // do this before exec() so that all the app's processes
+        // are in the task's cgroup
+        //
+        if (cgroup_enter(getpid())) {
+            perror("cgroup_enter");
+        }
+#endif
+
         // don't pass stdout to the app
         //
         int fd = open("/dev/null", O_RDWR);
@@ -15,16 +15,28 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with BOINC.  If not, see <http://www.gnu.org/licenses/>.
 
-// logic for "asynchronous" file copy and unzip/verify operations.
-// "asynchronous" means that the the operations are done in 64KB chunks
-// in the client's polling loop,
+// logic for asynchronous file copy and unzip/verify operations.
+// The I/O is done by a small pool of worker threads,
 // so that the client continues to respond to GUI RPCs
 // and the manager won't freeze.
+// Finished operations are queued and handled in the client's
+// polling loop (do_async_file_op()),
+// which does everything involving client data structures.
 
 #ifdef _WIN32
 #include "boinc_win.h"
 #else
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
+#endif
 #endif
 
 #ifdef _MSC_VER
@@ -42,15 +54,101 @@
 #include "client_state.h"
 #include "project.h"
 #include "sandbox.h"
+#include "thread.h"
 
 #include "async_file.h"
 
 using std::vector;
 
-vector<ASYNC_VERIFY*> async_verifies;
-vector<ASYNC_COPY*> async_copies;
+vector<ASYNC_FILE_OP*> async_file_ops;
+
+#define BUFSIZE 1024*1024
+#define COPY_RANGE_SIZE 64*1024*1024
+
+// state shared with the worker threads; protected by async_lock
+//
+static THREAD_LOCK async_lock;
+static THREAD_COND async_cond;
+static vector<ASYNC_FILE_OP*> work_queue;
+static vector<ASYNC_FILE_OP*> done_queue;
+static THREAD async_threads[ASYNC_FILE_NTHREADS];
+static int nasync_threads = 0;
+static int nidle_threads = 0;
+
+#ifdef _WIN32
+static DWORD WINAPI async_file_worker(LPVOID) {
+#else
+static void* async_file_worker(void*) {
+#endif
+    async_lock.lock();
+    while (1) {
+        while (work_queue.empty()) {
+            nidle_threads++;
+            async_cond.wait(async_lock);
+            nidle_threads--;
+        }
+        ASYNC_FILE_OP* op = work_queue[0];
+        work_queue.erase(work_queue.begin());
+        op->state = ASYNC_OP_RUNNING;
+        async_lock.unlock();
+
+        int retval = op->work();
+
+        async_lock.lock();
+        op->work_retval = retval;
+        op->state = ASYNC_OP_DONE;
+        done_queue.push_back(op);
+    }
+    return 0;
+}
 
-#define BUFSIZE 64*1024
+// queue an op for the worker threads,
+// starting another thread if none is idle
+//
+static void start_async_file_op(ASYNC_FILE_OP* op) {
+    async_file_ops.push_back(op);
+    async_lock.lock();
+    work_queue.push_back(op);
+    if (!nidle_threads && nasync_threads < ASYNC_FILE_NTHREADS) {
+        if (!async_threads[nasync_threads].run(async_file_worker, NULL)) {
+            nasync_threads++;
+        }
+    }
+    async_cond.signal();
+    async_lock.unlock();
+}
+
+// the op's FILE_INFO or ACTIVE_TASK is going away.
+// If a worker hasn't started it, delete it;
+// otherwise it's deleted by do_async_file_op() when the worker is done
+//
+static void cancel_async_file_op(ASYNC_FILE_OP* op) {
+    vector<ASYNC_FILE_OP*>::iterator i;
+    bool queued = false;
+
+    async_lock.lock();
+    if (op->state == ASYNC_OP_QUEUED) {
+        for (i=work_queue.begin(); i!=work_queue.end(); ++i) {
+            if (*i == op) {
+                work_queue.erase(i);
+                break;
+            }
+        }
+        queued = true;
+    } else {
+        op->cancelled = true;
+    }
+    async_lock.unlock();
+
+    if (!queued) return;
+    for (i=async_file_ops.begin(); i!=async_file_ops.end(); ++i) {
+        if (*i == op) {
+            async_file_ops.erase(i);
+            break;
+        }
+    }
+    delete op;
+}
 
 // set up an async copy operation.
 //
@@ -87,7 +185,7 @@ int ASYNC_COPY::init(
         return ERR_FOPEN;
     }
     atp->async_copy = this;
-    async_copies.push_back(this);
+    start_async_file_op(this);
     return 0;
 }
 
@@ -95,6 +193,7 @@ ASYNC_COPY::ASYNC_COPY() {
     in = out = NULL;
     atp = NULL;
     fip = NULL;
+    method = "read/write";
     safe_strcpy(to_path, "");
     safe_strcpy(temp_path, "");
 }
@@ -107,52 +206,109 @@ ASYNC_COPY::~ASYNC_COPY() {
     }
 }
 
-// copy a 64KB chunk.
-// return nonzero if we're done (success or fail)
+// copy the file (in a worker thread).
+// On Linux, first try to clone it (instant on btrfs, XFS etc.),
+// then to copy it in the kernel.
 //
-int ASYNC_COPY::copy_chunk() {
-    unsigned char buf[BUFSIZE];
-    int retval;
-
-    size_t n = fread(buf, 1, BUFSIZE, in);
-    if (n == 0) {
-        // copy done.  rename temp file
-        //
-        fclose(in);
-        fclose(out);
-        in = out = NULL;
-        retval = boinc_rename(temp_path, to_path);
-        if (retval) {
-            error(retval);
-            return 1;
-        }
-
-        if (log_flags.async_file_debug) {
-            msg_printf(atp->wup->project, MSG_INFO,
-                "[async] async copy of %s finished", to_path
+int ASYNC_COPY::work() {
+    int retval = 0;
+#ifdef __linux__
+    int infd = fileno(in), outfd = fileno(out);
+#ifdef FICLONE
+    if (ioctl(outfd, FICLONE, infd) == 0) {
+        method = "reflink";
+        goto close_files;
+    }
+#endif
+#ifdef HAVE_COPY_FILE_RANGE
+    {
+        bool copied_any = false;
+        while (!cancelled) {
+            ssize_t n = copy_file_range(
+                infd, NULL, outfd, NULL, COPY_RANGE_SIZE, 0
             );
+            if (n == 0) {
+                method = "copy_file_range";
+                goto close_files;
+            }
+            if (n < 0) {
+                if (copied_any) {
+                    retval = ERR_FWRITE;
+                    goto close_files;
+                }
+                // not supported for these files; do it ourselves
+                //
+                break;
+            }
+            copied_any = true;
         }
-    
-        atp->async_copy = NULL;
-        fip->set_permissions(to_path);
-
-        // If task is still scheduled, start it.
-        //
-        if (atp->scheduler_state == CPU_SCHED_SCHEDULED) {
-            retval = atp->start();
-            if (retval) {
-                error(retval);
+    }
+#endif
+#endif
+    {
+        unsigned char* buf = (unsigned char*)malloc(BUFSIZE);
+        if (!buf) {
+            retval = ERR_MALLOC;
+            goto close_files;
+        }
+        while (!cancelled) {
+            size_t n = fread(buf, 1, BUFSIZE, in);
+            if (n == 0) {
+                if (ferror(in)) retval = ERR_FREAD;
+                break;
+            }
+            size_t m = fwrite(buf, 1, n, out);
+            if (m != n) {
+                retval = ERR_FWRITE;
+                break;
             }
         }
-        return 1;       // tell caller we're done
-    } else {
-        size_t m = fwrite(buf, 1, n, out);
-        if (m != n) {
-            error(ERR_FWRITE);
-            return 1;
+        free(buf);
+    }
+close_files:
+    fclose(in);
+    in = NULL;
+    if (fclose(out) && !retval) {
+        retval = ERR_FWRITE;
+    }
+    out = NULL;
+    return retval;
+}
+
+// the copy is done (in main thread).
+// Rename the temp file and start the task
+//
+void ASYNC_COPY::done() {
+    int retval;
+
+    if (cancelled || work_retval) {
+        boinc_delete_file(temp_path);
+        if (!cancelled) error(work_retval);
+        return;
+    }
+    retval = boinc_rename(temp_path, to_path);
+    if (retval) {
+        error(retval);
+        return;
+    }
+
+    if (log_flags.async_file_debug) {
+        msg_printf(atp->wup->project, MSG_INFO,
+            "[async] async copy of %s finished (%s)", to_path, method
+        );
+    }
+
+    atp->async_copy = NULL;
+    fip->set_permissions(to_path);
+
+    // If task is still scheduled, start it.
+    //
+    if (atp->scheduler_state == CPU_SCHED_SCHEDULED) {
+        retval = atp->start();
+        if (retval) {
+            error(retval);
         }
     }
-    return 0;
 }
 
 // handle the failure of a copy; error out the result
@@ -168,29 +324,24 @@ void ASYNC_COPY::error(int retval) {
 }
 
 void remove_async_copy(ASYNC_COPY* acp) {
-    vector<ASYNC_COPY*>::iterator i = async_copies.begin();
-    while (i != async_copies.end()) {
-        if (*i == acp) {
-            async_copies.erase(i);
-            break;
-        }
-        ++i;
-    }
-    delete acp;
+    acp->atp = NULL;
+    acp->fip = NULL;
+    cancel_async_file_op(acp);
 }
 
 int ASYNC_VERIFY::init(FILE_INFO* _fip) {
     fip = _fip;
+    gzipped = fip->download_gzipped;
     md5_init(&md5_state);
     get_pathname(fip, inpath, sizeof(inpath));
 
     if (log_flags.async_file_debug) {
         msg_printf(fip->project, MSG_INFO,
             "[async] started async MD5%s of %s",
-            fip->download_gzipped?" and uncompress":"", fip->name
+            gzipped?" and uncompress":"", fip->name
         );
     }
-    if (fip->download_gzipped) {
+    if (gzipped) {
         safe_strcpy(outpath, inpath);
         char dir[MAXPATHLEN];
         boinc_path_to_dir(outpath, dir);
@@ -200,7 +351,6 @@ int ASYNC_VERIFY::init(FILE_INFO* _fip) {
         out = boinc_temp_file(dir, "verify", temp_path);
 #endif
         if (!out) {
-            fclose(in);
             return ERR_FOPEN;
         }
 
@@ -208,6 +358,7 @@ int ASYNC_VERIFY::init(FILE_INFO* _fip) {
         gzin = gzopen(inpath, "rb");
         if (gzin == Z_NULL) {
             fclose(out);
+            out = NULL;
             boinc_delete_file(temp_path);
             return ERR_FOPEN;
         }
@@ -215,11 +366,69 @@ int ASYNC_VERIFY::init(FILE_INFO* _fip) {
         in = boinc_fopen(inpath, "rb");
         if (!in) return ERR_FOPEN;
     }
-    async_verifies.push_back(this);
     fip->async_verify = this;
+    start_async_file_op(this);
     return 0;
 }
 
+ASYNC_VERIFY::~ASYNC_VERIFY() {
+    if (gzin) gzclose(gzin);
+    if (in) fclose(in);
+    if (out) fclose(out);
+}
+
+// compute the MD5, uncompressing if needed (in a worker thread)
+//
+int ASYNC_VERIFY::work() {
+    int retval = 0;
+    unsigned char* buf = (unsigned char*)malloc(BUFSIZE);
+    if (!buf) {
+        retval = ERR_MALLOC;
+    } else if (gzipped) {
+        while (!cancelled) {
+            int n = gzread(gzin, buf, BUFSIZE);
+            if (n <= 0) break;
+            size_t m = fwrite(buf, 1, n, out);
+            if (m != (size_t)n || ferror(out)) {
+                retval = ERR_FWRITE;
+                break;
+            }
+            md5_append(&md5_state, buf, n);
+        }
+        gzclose(gzin);
+        gzin = NULL;
+        if (fclose(out) && !retval) {
+            retval = ERR_FWRITE;
+        }
+        out = NULL;
+    } else {
+        while (!cancelled) {
+            size_t n = fread(buf, 1, BUFSIZE, in);
+            if (!n || ferror(in)) break;
+            md5_append(&md5_state, buf, (int)n);
+        }
+        fclose(in);
+        in = NULL;
+    }
+    free(buf);
+    return retval;
+}
+
+// the worker is done (in main thread)
+//
+void ASYNC_VERIFY::done() {
+    if (cancelled || work_retval) {
+        if (gzipped) boinc_delete_file(temp_path);
+        if (!cancelled) error(work_retval);
+        return;
+    }
+    if (gzipped) {
+        delete_project_owned_file(inpath, true);
+        boinc_rename(temp_path, outpath);
+    }
+    finish();
+}
+
 // the MD5 has been computed.  Finish up.
 //
 void ASYNC_VERIFY::finish() {
@@ -272,74 +481,30 @@ void ASYNC_VERIFY::error(int retval) {
     fip->status = retval;
 }
 
-int ASYNC_VERIFY::verify_chunk() {
-    size_t n;
-    unsigned char buf[BUFSIZE];
-    if (fip->download_gzipped) {
-        n = gzread(gzin, buf, BUFSIZE);
-        if (n <=0) {
-            // done
-            //
-            gzclose(gzin);
-            fclose(out);
-            delete_project_owned_file(inpath, true);
-            boinc_rename(temp_path, outpath);
-            finish();
-            return 1;
-        } else {
-            size_t m = fwrite(buf, 1, n, out);
-            if (m != n || ferror(out)) {
-                // write failed
-                //
-                error(ERR_FWRITE);
-                return 1;
-            }
-            md5_append(&md5_state, buf, (int)n);
-        }
-    } else {
-        n = fread(buf, 1, BUFSIZE, in);
-        if (!n || ferror(in)) {
-            fclose(in);
-            finish();
-            return 1;
-        } else {
-            md5_append(&md5_state, buf, (int)n);
-        }
-    }
-    return 0;
-}
-
 void remove_async_verify(ASYNC_VERIFY* avp) {
-    vector<ASYNC_VERIFY*>::iterator i = async_verifies.begin();
-    while (i != async_verifies.end()) {
-        if (*i == avp) {
-            async_verifies.erase(i);
-            break;
-        }
-        ++i;
-    }
-    delete avp;
+    avp->fip = NULL;
+    cancel_async_file_op(avp);
 }
 
-// If there are any async file operations,
-// do a 64KB chunk of the first one and return true.
-//
-// Note: if there are lots of pending operations,
-// it's better to finish the oldest one before starting the rest
+// Handle async file operations that the worker threads have finished.
 //
 void do_async_file_op() {
-    if (async_copies.size()) {
-        ASYNC_COPY* acp = async_copies[0];
-        if (acp->copy_chunk()) {
-            async_copies.erase(async_copies.begin());
-            delete acp;
-        }
-        return;
-    }
-    if (async_verifies.size()) {
-        if (async_verifies[0]->verify_chunk()) {
-            async_verifies.erase(async_verifies.begin());
+    vector<ASYNC_FILE_OP*> done;
+    vector<ASYNC_FILE_OP*>::iterator j;
+
+    async_lock.lock();
+    done.swap(done_queue);
+    async_lock.unlock();
+
+    for (unsigned int i=0; i<done.size(); i++) {
+        ASYNC_FILE_OP* op = done[i];
+        op->done();
+        for (j=async_file_ops.begin(); j!=async_file_ops.end(); ++j) {
+            if (*j == op) {
+                async_file_ops.erase(j);
+                break;
+            }
         }
+        delete op;
     }
 }
-
@@ -38,15 +38,48 @@ struct ACTIVE_TASK;
 
 #define ASYNC_FILE_THRESHOLD    1e7
     // use async ops for files exceeding this size
+#define ASYNC_FILE_NTHREADS     4
+    // max number of worker threads doing async ops;
+    // this many files can be copied or verified in parallel
+#define ASYNC_FILE_POLL_PERIOD  0.1
+    // while there are async ops, check for finished ones this often
+
+#define ASYNC_OP_QUEUED     0
+#define ASYNC_OP_RUNNING    1
+#define ASYNC_OP_DONE       2
+
+// An operation whose I/O is done by a worker thread.
+// work() runs in the worker and must touch only the op's own members
+// (no FILE_INFO, ACTIVE_TASK, messages etc.);
+// done() runs in the main thread, from do_async_file_op().
+//
+struct ASYNC_FILE_OP {
+    int state;
+    int work_retval;
+    volatile bool cancelled;
+        // the FILE_INFO or ACTIVE_TASK went away while we were working;
+        // stop as soon as possible and clean up
+
+    ASYNC_FILE_OP() {
+        state = ASYNC_OP_QUEUED;
+        work_retval = 0;
+        cancelled = false;
+    }
+    virtual ~ASYNC_FILE_OP(){}
+    virtual int work() = 0;
+    virtual void done() = 0;
+};
 
 // Used to copy a file from project dir to slot dir;
 // when done, start the task again.
 //
-struct ASYNC_COPY {
+struct ASYNC_COPY : public ASYNC_FILE_OP {
     ACTIVE_TASK* atp;
     FILE_INFO* fip;
     FILE* in, *out;
     char to_path[MAXPATHLEN], temp_path[MAXPATHLEN];
+    const char* method;
+        // how the data was copied, for async_file_debug
 
     ASYNC_COPY();
     ~ASYNC_COPY();
@@ -54,7 +87,8 @@ struct ASYNC_COPY {
     int init(
         ACTIVE_TASK*, FILE_INFO*, const char* from_path, const char* _to_path
     );
-    int copy_chunk();
+    int work();
+    void done();
     void error(int);
 };
 
@@ -62,8 +96,9 @@ struct ASYNC_COPY {
 // after it has been downloaded.
 // When done, mark it as present.
 //
-struct ASYNC_VERIFY {
+struct ASYNC_VERIFY : public ASYNC_FILE_OP {
     FILE_INFO* fip;
+    bool gzipped;
     md5_state_t md5_state;
     FILE* in, *out;
     gzFile gzin;
@@ -71,6 +106,7 @@ struct ASYNC_VERIFY {
 
     ASYNC_VERIFY(){
       fip = NULL;
+      gzipped = false;
       in = NULL;
       out = NULL;
       gzin = NULL;
@@ -78,21 +114,22 @@ struct ASYNC_VERIFY {
       safe_strcpy(temp_path, "");
       safe_strcpy(outpath, "");
     };
-    ~ASYNC_VERIFY(){};
+    ~ASYNC_VERIFY();
 
     int init(FILE_INFO*);
-    int verify_chunk();
+    int work();
+    void done();
     void finish();
     void error(int);
 };
 
-extern std::vector<ASYNC_VERIFY*> async_verifies;
-extern std::vector<ASYNC_COPY*> async_copies;
+extern std::vector<ASYNC_FILE_OP*> async_file_ops;
+    // ops that haven't been handled by do_async_file_op() yet
 
 extern void remove_async_copy(ASYNC_COPY*);
 extern void remove_async_verify(ASYNC_VERIFY*);
 inline bool have_async_file_op() {
-    return (async_verifies.size() || async_copies.size());
+    return async_file_ops.size() > 0;
 }
 extern void do_async_file_op();
 
@@ -100,6 +100,7 @@ CLIENT_STATE::CLIENT_STATE()
 #endif
     time_stats.init();
     client_state_dirty = false;
+    last_state_file_write_time = 0;
     old_major_version = 0;
     old_minor_version = 0;
     old_release = 0;
@@ -843,81 +844,57 @@ int CLIENT_STATE::init() {
     return 0;
 }
 
-static void double_to_timeval(double x, timeval& t) {
-    t.tv_sec = (int)x;
-    t.tv_usec = (int)(1000000*(x - (int)x));
-}
+// fires when do_io_or_sleep() should return to poll_slow_events()
+//
+struct SLOW_POLL_TIMER : public EVENT_HANDLER {
+    EVENT_TIMER timer;
+    bool due;
+    SLOW_POLL_TIMER() : timer(this) {
+        due = false;
+    }
+    void handle_timer(EVENT_TIMER*) {
+        due = true;
+    }
+};
 
-FDSET_GROUP curl_fds;
-FDSET_GROUP gui_rpc_fds;
-FDSET_GROUP all_fds;
+static SLOW_POLL_TIMER slow_poll_timer;
 
 // Spend x seconds either doing I/O (if possible) or sleeping.
+// The network descriptors (curl and GUI RPC) are registered
+// persistently in event_loop; handlers run from dispatch().
 //
 void CLIENT_STATE::do_io_or_sleep(double max_time) {
-    int n;
-    struct timeval tv;
     set_now();
-    double end_time = now + max_time;
-    double time_remaining = max_time;
+    slow_poll_timer.due = false;
+    slow_poll_timer.timer.when = dtime() + max_time;
+    event_loop.add_timer(&slow_poll_timer.timer);
 
     while (1) {
-        curl_fds.zero();
-        gui_rpc_fds.zero();
-        http_ops->get_fdset(curl_fds);
-        all_fds = curl_fds;
-        if (!autologin_in_progress) {
-            gui_rpcs.get_fdset(gui_rpc_fds, all_fds);
-        }
+        gui_rpcs.set_events(!autologin_in_progress);
 
         bool have_async = have_async_file_op();
 
-        // prioritize network (including GUI RPC) over async file ops.
-        // if there's a pending asynch file op, do the select with zero timeout;
-        // otherwise do it for the remaining amount of time.
+        // wait until an fd is ready or a timer is due
+        // (curl's, or ours for poll_slow_events()).
+        // Async file ops are done by worker threads;
+        // if there are any, wake up periodically to finish them.
 
-        double_to_timeval(have_async?0:time_remaining, tv);
 #ifdef NEW_CPU_THROTTLE
         client_mutex.unlock();
 #endif
-        if (all_fds.max_fd == -1) {
-            boinc_sleep(time_remaining);
-            n = 0;
-        } else {
-            n = select(
-                all_fds.max_fd+1,
-                &all_fds.read_fds, &all_fds.write_fds, &all_fds.exc_fds,
-                &tv
-            );
-        }
-        //printf("select in %d out %d\n", all_fds.max_fd, n);
+        event_loop.wait(
+            have_async?std::min(max_time, ASYNC_FILE_POLL_PERIOD):max_time
+        );
 #ifdef NEW_CPU_THROTTLE
         client_mutex.lock();
 #endif
-
-        // Note: curl apparently likes to have curl_multi_perform()
-        // (called from net_xfers->got_select())
-        // called pretty often, even if no descriptors are enabled.
-        // So do the "if (n==0) break" AFTER the got_selects().
-
-        http_ops->got_select(all_fds, time_remaining);
-        gui_rpcs.got_select(all_fds);
+        set_now();
+        event_loop.dispatch();
 
         if (have_async) {
-            // do the async file op only if no network activity
-            //
-            if (n == 0) {
-                do_async_file_op();
-            }
-        } else {
-            if (n == 0) {
-                break;
-            }
+            do_async_file_op();
         }
-
-        set_now();
-        if (now > end_time) break;
-        time_remaining = end_time - now;
+        if (slow_poll_timer.due) break;
     }
 }
 
@@ -1211,6 +1188,9 @@ APP* CLIENT_STATE::lookup_app(PROJECT* p, const char* name) {
 }
 
 RESULT* CLIENT_STATE::lookup_result(PROJECT* p, const char* name) {
+    if (name_index.active) {
+        return NAME_INDEX::find(name_index.results, p, name);
+    }
     for (unsigned int i=0; i<results.size(); i++) {
         RESULT* rp = results[i];
         if (rp->project == p && !strcmp(name, rp->name)) return rp;
@@ -1219,6 +1199,9 @@ RESULT* CLIENT_STATE::lookup_result(PROJECT* p, const char* name) {
 }
 
 WORKUNIT* CLIENT_STATE::lookup_workunit(PROJECT* p, const char* name) {
+    if (name_index.active) {
+        return NAME_INDEX::find(name_index.workunits, p, name);
+    }
     for (unsigned int i=0; i<workunits.size(); i++) {
         WORKUNIT* wup = workunits[i];
         if (wup->project == p && !strcmp(name, wup->name)) return wup;
@@ -1241,6 +1224,9 @@ APP_VERSION* CLIENT_STATE::lookup_app_version(
 }
 
 FILE_INFO* CLIENT_STATE::lookup_file_info(PROJECT* p, const char* name) {
+    if (name_index.active) {
+        return NAME_INDEX::find(name_index.file_infos, p, name);
+    }
     for (unsigned int i=0; i<file_infos.size(); i++) {
         FILE_INFO* fip = file_infos[i];
         if (fip->project == p && !strcmp(fip->name, name)) {
@@ -2213,7 +2199,14 @@ int CLIENT_STATE::quit_activities() {
     adjust_rec();
 
     daily_xfer_history.write_file();
-    write_state_file();
+    if (cc_config.binary_state_file) {
+        // write client_state.xml too, so that other versions can use it
+        //
+        write_state_file_xml();
+        write_state_snapshot();
+    } else {
+        write_state_file();
+    }
     gui_rpcs.close();
     abort_cpu_benchmarks();
     time_stats.quit();
@@ -23,6 +23,7 @@
 // This makes it possible to throttle faster than the client's 1-sec poll period
 
 #ifndef _WIN32
+#include <map>
 #include <string>
 #include <vector>
 #include <ctime>
@@ -56,10 +57,41 @@ using std::vector;
 #include "scheduler_op.h"
 #include "time_stats.h"
 
+// maps (project, name) to file infos, workunits and results.
+// Used by the lookup functions while the state file is parsed;
+// otherwise linking tasks to their workunits and files
+// takes time quadratic in the number of tasks.
+//
+typedef std::pair<PROJECT*, std::string> NAME_KEY;
+
+struct NAME_INDEX {
+    bool active;
+    std::map<NAME_KEY, FILE_INFO*> file_infos;
+    std::map<NAME_KEY, WORKUNIT*> workunits;
+    std::map<NAME_KEY, RESULT*> results;
+
+    NAME_INDEX(): active(false) {}
+    void clear() {
+        active = false;
+        file_infos.clear();
+        workunits.clear();
+        results.clear();
+    }
+    template <class T> static T* find(
+        std::map<NAME_KEY, T*>& m, PROJECT* p, const char* name
+    ) {
+        typename std::map<NAME_KEY, T*>::iterator i = m.find(NAME_KEY(p, name));
+        if (i == m.end()) return NULL;
+        return i->second;
+    }
+};
+
 #ifdef SIM
 #include "../sched/edf_sim.h"
 #endif
 
+struct STATE_RECORD_WRITER;     // see cs_statefile.cpp
+
 #define WORK_FETCH_DONT_NEED 0
     // project: suspended, deferred, or no new work (can't ask for more work)
     // overall: not work_fetch_ok (from CPU policy)
@@ -87,6 +119,9 @@ struct CLIENT_STATE {
     vector<RESULT*> results;
         // list of jobs, ordered by increasing arrival time
 
+    EVENT_LOOP event_loop;
+        // network descriptors and timers for do_io_or_sleep().
+        // Declared before the sets that register with it
     PERS_FILE_XFER_SET* pers_file_xfers;
     HTTP_OP_SET* http_ops;
     FILE_XFER_SET* file_xfers;
@@ -223,6 +258,8 @@ struct CLIENT_STATE {
         // so that the Manager can tell the user what the problem is
 
     bool client_state_dirty;
+    double last_state_file_write_time;
+    NAME_INDEX name_index;
     int old_major_version;
     int old_minor_version;
     int old_release;
@@ -310,8 +347,6 @@ struct CLIENT_STATE {
     bool must_enforce_cpu_schedule;
     bool must_schedule_cpus;
     bool must_check_work_fetch;
-    void assign_results_to_projects();
-    RESULT* highest_prio_project_best_result();
     void reset_rec_accounting();
     bool schedule_cpus();
     void make_run_list(vector<RESULT*>&);
@@ -459,8 +494,16 @@ struct CLIENT_STATE {
     void set_client_state_dirty(const char*);
     int parse_state_file();
     int parse_state_file_aux(const char*);
+    void parse_state_item(XML_PARSER&, PROJECT*&);
+    void parse_state_finish();
+    int parse_state_snapshot();
     int write_state(MIOFILE&);
+    int write_state_records(STATE_RECORD_WRITER&);
+    void write_state_misc(MIOFILE&);
     int write_state_file();
+    int write_state_file_xml();
+    int write_state_snapshot();
+    int write_state_journal();
     int write_state_file_if_needed();
     void check_anonymous();
     int parse_app_info(PROJECT*, FILE*);
@@ -573,6 +616,11 @@ extern THREAD throttle_thread;
 #define MEMORY_USAGE_PERIOD     10
     // computer memory usage and check for exclusive apps this often
 
+#define CGROUP_CPU_PERIOD       100000
+    // cpu.max period, usec
+#define CGROUP_LIMITS_PERIOD    10
+    // if using cgroups, update task CPU and memory limits this often
+
 //////// WORK FETCH
 
 #define WORK_FETCH_PERIOD   60
@@ -310,7 +310,7 @@ int FILE_INFO::parse(XML_PARSER& xp) {
         }
         if (xp.match_tag("xml_signature")) {
             retval = copy_element_contents(
-                xp.f->f,
+                *xp.f,
                 "</xml_signature>",
                 xml_signature,
                 sizeof(xml_signature)
@@ -321,7 +321,7 @@ int FILE_INFO::parse(XML_PARSER& xp) {
         }
         if (xp.match_tag("file_signature")) {
             retval = copy_element_contents(
-                xp.f->f,
+                *xp.f,
                 "</file_signature>",
                 file_signature,
                 sizeof(file_signature)
@@ -406,7 +406,7 @@ int FILE_INFO::parse(XML_PARSER& xp) {
         }
         if (xp.match_tag("error_msg")) {
             retval = copy_element_contents(
-                xp.f->f,
+                *xp.f,
                 "</error_msg>", buf2, sizeof(buf2)
             );
             if (retval) return retval;
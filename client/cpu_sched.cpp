@@ -61,6 +61,8 @@
 #include <string>
 #include <cstring>
 #include <list>
+#include <map>
+#include <algorithm>
 #endif
 
 
@@ -321,232 +323,293 @@ static inline bool finished_time_slice(ACTIVE_TASK* atp) {
     return (running_beyond_sched_period && checkpointed);
 }
 
-// Choose a "best" runnable CPU job for each project
+// Job queues used by make_run_list().
 //
-// Values are returned in project->next_runnable_result
-// (skip projects for which this is already non-NULL)
-//
-// Don't choose results with already_selected == true;
-// mark chosen results as already_selected.
-//
-// The preference order:
-// 1. results with active tasks that are running
-// 2. results with active tasks that are preempted (but have a process)
-// 3. results with active tasks that have no process
-// 4. results with no active task
-//
-// TODO: this is called in a loop over NCPUs, which is silly.
-// Should call it once, and have it make an ordered list per project.
-//
-void CLIENT_STATE::assign_results_to_projects() {
-    unsigned int i;
-    RESULT* rp;
-    PROJECT* project;
+// For each resource type, make_run_list() picks jobs
+// - in order of deadline, from projects with deadline misses (EDF_QUEUE)
+// - then from the project with highest scheduling priority (PRIO_QUEUE).
+// Doing each pick by scanning all jobs is O(#jobs) per instance,
+// which is slow on hosts with many CPUs and thousands of jobs.
+// Instead we order the candidates once per pass.
+
+typedef std::map<RESULT*, ACTIVE_TASK*> RESULT_TASK_MAP;
+
+static inline ACTIVE_TASK* lookup_task(RESULT_TASK_MAP& tasks, RESULT* rp) {
+    RESULT_TASK_MAP::iterator i = tasks.find(rp);
+    if (i == tasks.end()) return NULL;
+    return i->second;
+}
 
-    // scan results with an ACTIVE_TASK
+// Jobs of a given type projected to miss their deadline,
+// or from projects with extreme DCF, in the order we'd run them:
+//  - earlier deadline
+//  - already-started job
+//  - less remaining time
+//
+struct EDF_QUEUE {
+    struct ITEM {
+        RESULT* rp;
+        bool started;
+        double remaining;
+        unsigned int order;     // position in results vector
+    };
+    std::vector<ITEM> items;
+    unsigned int next;
+
+    static bool before(const ITEM& a, const ITEM& b) {
+        if (a.rp->report_deadline != b.rp->report_deadline) {
+            return a.rp->report_deadline < b.rp->report_deadline;
+        }
+        if (a.started != b.started) return a.started;
+        if (a.remaining != b.remaining) return a.remaining < b.remaining;
+        return a.order < b.order;
+    }
+
+    // Skip jobs if the project's deadline-miss count is zero.
+    // If the project's DCF is > 90 (and we're not ignoring it)
+    // treat all jobs as deadline misses.
+    // The miss count only decreases during a pass,
+    // so a job we skip never becomes eligible again.
     //
-    for (i=0; i<active_tasks.active_tasks.size(); i++) {
-        ACTIVE_TASK *atp = active_tasks.active_tasks[i];
-        if (!atp->runnable()) continue;
-        rp = atp->result;
-        if (rp->already_selected) continue;
-        if (rp->uses_coprocs()) continue;
-        if (!rp->runnable()) continue;
-        project = rp->project;
-        if (!project->next_runnable_result) {
-            project->next_runnable_result = rp;
-            continue;
-        }
-
-        // see if this task is "better" than the one currently
-        // selected for this project
-        //
-        ACTIVE_TASK *next_atp = lookup_active_task_by_result(
-            project->next_runnable_result
-        );
-
-        if ((next_atp->task_state() == PROCESS_UNINITIALIZED && atp->process_exists())
-            || (next_atp->scheduler_state == CPU_SCHED_PREEMPTED
-            && atp->scheduler_state == CPU_SCHED_SCHEDULED)
-        ) {
-            project->next_runnable_result = atp->result;
+    static inline bool eligible(RESULT* rp, int rsc_type) {
+        PROJECT* p = rp->project;
+        if (p->dont_use_dcf || p->duration_correction_factor < 90.0) {
+            if (p->rsc_pwf[rsc_type].deadlines_missed_copy <= 0) {
+                return false;
+            }
         }
+        return true;
     }
 
-    // Now consider results that don't have an active task
-    //
-    for (i=0; i<results.size(); i++) {
-        rp = results[i];
-        if (rp->already_selected) continue;
-        if (rp->uses_coprocs()) continue;
-        if (lookup_active_task_by_result(rp)) continue;
-        if (!rp->runnable()) continue;
-
-        project = rp->project;
-        if (project->next_runnable_result) continue;
-        project->next_runnable_result = rp;
+    void init(int rsc_type, RESULT_TASK_MAP& tasks) {
+        items.clear();
+        next = 0;
+        for (unsigned int i=0; i<gstate.results.size(); i++) {
+            RESULT* rp = gstate.results[i];
+            if (rp->resource_type() != rsc_type) continue;
+            if (rp->already_selected) continue;
+            if (!rp->runnable()) continue;
+            if (rp->non_cpu_intensive()) continue;
+            if (!eligible(rp, rsc_type)) continue;
+            ITEM item;
+            item.rp = rp;
+            item.started = (lookup_task(tasks, rp) != NULL);
+            item.remaining = rp->estimated_runtime_remaining();
+            item.order = i;
+            items.push_back(item);
+        }
+        std::sort(items.begin(), items.end(), before);
     }
 
-    // mark selected results, so CPU scheduler won't try to consider
-    // a result more than once
+    // return the next job, or NULL if none
     //
-    for (i=0; i<projects.size(); i++) {
-        project = projects[i];
-        if (project->next_runnable_result) {
-            project->next_runnable_result->already_selected = true;
+    RESULT* get(int rsc_type) {
+        while (next < items.size()) {
+            RESULT* rp = items[next++].rp;
+            if (rp->already_selected) continue;
+            if (!eligible(rp, rsc_type)) continue;
+            return rp;
         }
+        return NULL;
     }
-}
+};
 
-// Among projects with a "next runnable result",
-// find the project P with the largest priority,
-// and return its next runnable result
+// Per-project lists of candidate jobs,
+// and a heap of projects ordered by scheduling priority.
+// Picking a job calls adjust_rec_sched(),
+// which changes the priority of that project only;
+// since it was the top of the heap, we pop it
+// and push it back before the next pick.
 //
-RESULT* CLIENT_STATE::highest_prio_project_best_result() {
-    PROJECT *best_project = NULL;
-    double best_prio = 0;
-    bool first = true;
-    unsigned int i;
-
-    for (i=0; i<projects.size(); i++) {
-        PROJECT* p = projects[i];
-        if (!p->next_runnable_result) continue;
-        if (p->non_cpu_intensive) continue;
-        if (first || p->sched_priority > best_prio) {
-            first = false;
-            best_project = p;
-            best_prio = p->sched_priority;
-        }
-    }
-    if (!best_project) return NULL;
-
-    RESULT* rp = best_project->next_runnable_result;
-    best_project->next_runnable_result = 0;
-    return rp;
-}
-
-// Return a job of the given type according to the following criteria
-// (desc priority):
-//  - from project with higher priority
+// For CPU jobs, each project's list is in the order:
+// 1. results with active tasks that are running
+// 2. results with active tasks that are preempted (but have a process)
+// 3. results with active tasks that have no process
+// 4. results with no active task
+// and projects with equal priority are taken in project order.
+//
+// For coproc jobs, each project's list is in the order:
 //  - already-started job
 //  - earlier received_time
-//  - lexicographically earlier name
-//
-// Give priority to already-started jobs because of the following scenario:
-// - client gets several jobs in a sched reply and starts downloading files
-// - a later job finishes downloading and starts
-// - an earlier finishes downloading and preempts
+// and projects with equal priority are ordered by their first job.
 //
-RESULT* first_coproc_result(int rsc_type) {
-    unsigned int i;
-    RESULT* best = NULL;
-    double best_prio=0, prio;
-    for (i=0; i<gstate.results.size(); i++) {
-        RESULT* rp = gstate.results[i];
-        if (rp->resource_type() != rsc_type) continue;
-        if (!rp->runnable()) {
-            //msg_printf(rp->project, MSG_INFO, "not runnable: %s", rp->name);
-            continue;
-        }
-        if (rp->non_cpu_intensive()) continue;
-        if (rp->already_selected) continue;
-        prio = rp->project->sched_priority;
-        if (!best) {
-            best = rp;
-            best_prio = prio;
-            continue;
-        }
-
-        if (prio < best_prio) {
-            continue;
-        }
-        if (prio > best_prio) {
-            best = rp;
-            best_prio = prio;
-            continue;
+struct PRIO_QUEUE {
+    struct JOB {
+        RESULT* rp;
+        int rank;
+        unsigned int order;     // position in results or active task vector
+    };
+    struct PROJECT_JOBS {
+        PROJECT* p;
+        std::vector<JOB> jobs;
+        unsigned int next;
+    };
+    std::vector<PROJECT_JOBS> pjs;
+    std::vector<int> heap;
+    int last;
+        // project we last picked from; not in the heap
+    bool coproc;
+
+    static bool job_before(const JOB& a, const JOB& b) {
+        if (a.rank != b.rank) return a.rank < b.rank;
+        if (a.rp->index != b.rp->index) return a.rp->index < b.rp->index;
+        return a.order < b.order;
+    }
+    static bool rank_before(const JOB& a, const JOB& b) {
+        return a.rank < b.rank;
+    }
+
+    // heap comparison: true if project a is less preferred than b
+    //
+    struct LESS {
+        PRIO_QUEUE* q;
+        LESS(PRIO_QUEUE* _q) : q(_q) {}
+        bool operator()(int a, int b) const {
+            PROJECT_JOBS& pa = q->pjs[a];
+            PROJECT_JOBS& pb = q->pjs[b];
+            if (pa.p->sched_priority != pb.p->sched_priority) {
+                return pa.p->sched_priority < pb.p->sched_priority;
+            }
+            if (q->coproc) {
+                return job_before(pb.jobs[pb.next], pa.jobs[pa.next]);
+            }
+            return a > b;
         }
+    };
 
-        bool bs = !best->not_started;
-        bool rs = !rp->not_started;
-        if (rs && !bs) {
-            best = rp;
-            best_prio = prio;
-            continue;
-        }
-        if (!rs && bs) {
-            continue;
+    // skip jobs that have been selected some other way;
+    // return false if none left
+    //
+    bool skip_selected(PROJECT_JOBS& pj) {
+        while (pj.next < pj.jobs.size()) {
+            if (!pj.jobs[pj.next].rp->already_selected) return true;
+            pj.next++;
         }
+        return false;
+    }
 
-        // else used "arrived first" order
-        //
-        if (rp->index < best->index) {
-            best = rp;
-            best_prio = prio;
+    void add_job(std::map<PROJECT*, int>& slots, RESULT* rp, int rank, unsigned int order) {
+        PROJECT* p = rp->project;
+        int slot;
+        std::map<PROJECT*, int>::iterator i = slots.find(p);
+        if (i == slots.end()) {
+            slot = (int)pjs.size();
+            slots[p] = slot;
+            PROJECT_JOBS pj;
+            pj.p = p;
+            pj.next = 0;
+            pjs.push_back(pj);
+        } else {
+            slot = i->second;
+        }
+        JOB job;
+        job.rp = rp;
+        job.rank = rank;
+        job.order = order;
+        pjs[slot].jobs.push_back(job);
+    }
+
+    void make_heap() {
+        heap.clear();
+        last = -1;
+        for (unsigned int i=0; i<pjs.size(); i++) {
+            PROJECT_JOBS& pj = pjs[i];
+            if (coproc) {
+                std::sort(pj.jobs.begin(), pj.jobs.end(), job_before);
+            } else {
+                std::stable_sort(pj.jobs.begin(), pj.jobs.end(), rank_before);
+            }
+            if (!skip_selected(pj)) continue;
+            heap.push_back(i);
         }
+        std::make_heap(heap.begin(), heap.end(), LESS(this));
     }
-    return best;
-}
 
-// Return earliest-deadline result for given resource type;
-// return only results projected to miss their deadline,
-// or from projects with extreme DCF
-//
-static RESULT* earliest_deadline_result(int rsc_type) {
-    RESULT *best_result = NULL;
-    ACTIVE_TASK* best_atp = NULL;
-    unsigned int i;
-
-    for (i=0; i<gstate.results.size(); i++) {
-        RESULT* rp = gstate.results[i];
-        if (rp->resource_type() != rsc_type) continue;
-        if (rp->already_selected) continue;
-        if (!rp->runnable()) continue;
-        if (rp->non_cpu_intensive()) continue;
-        PROJECT* p = rp->project;
+    void init_cpu(RESULT_TASK_MAP& tasks) {
+        std::map<PROJECT*, int> slots;
+        pjs.clear();
+        coproc = false;
 
-        // Skip this job if the project's deadline-miss count is zero.
-        // If the project's DCF is > 90 (and we're not ignoring it)
-        // treat all jobs as deadline misses
+        // put projects in the heap in project order (for ties)
         //
-        if (p->dont_use_dcf || p->duration_correction_factor < 90.0) {
-            if (p->rsc_pwf[rsc_type].deadlines_missed_copy <= 0) {
-                continue;
+        for (unsigned int i=0; i<gstate.projects.size(); i++) {
+            PROJECT* p = gstate.projects[i];
+            slots[p] = i;
+            PROJECT_JOBS pj;
+            pj.p = p;
+            pj.next = 0;
+            pjs.push_back(pj);
+        }
+        for (unsigned int i=0; i<gstate.active_tasks.active_tasks.size(); i++) {
+            ACTIVE_TASK *atp = gstate.active_tasks.active_tasks[i];
+            if (!atp->runnable()) continue;
+            RESULT* rp = atp->result;
+            if (rp->already_selected) continue;
+            if (rp->uses_coprocs()) continue;
+            if (!rp->runnable()) continue;
+            if (rp->project->non_cpu_intensive) continue;
+            int rank;
+            if (atp->scheduler_state == CPU_SCHED_SCHEDULED) {
+                rank = 0;
+            } else if (atp->process_exists()) {
+                rank = 1;
+            } else {
+                rank = 2;
             }
-        }
-
-        bool new_best = false;
-        if (best_result) {
-            if (rp->report_deadline < best_result->report_deadline) {
-                new_best = true;
+            add_job(slots, rp, rank, i);
+        }
+        for (unsigned int i=0; i<gstate.results.size(); i++) {
+            RESULT* rp = gstate.results[i];
+            if (rp->already_selected) continue;
+            if (rp->uses_coprocs()) continue;
+            if (lookup_task(tasks, rp)) continue;
+            if (!rp->runnable()) continue;
+            if (rp->project->non_cpu_intensive) continue;
+            add_job(slots, rp, 3, i);
+        }
+        make_heap();
+    }
+
+    void init_coproc(int rsc_type) {
+        std::map<PROJECT*, int> slots;
+        pjs.clear();
+        coproc = true;
+        for (unsigned int i=0; i<gstate.results.size(); i++) {
+            RESULT* rp = gstate.results[i];
+            if (rp->resource_type() != rsc_type) continue;
+            if (!rp->runnable()) continue;
+            if (rp->non_cpu_intensive()) continue;
+            if (rp->already_selected) continue;
+            add_job(slots, rp, rp->not_started?1:0, i);
+        }
+        make_heap();
+    }
+
+    // Return the next job to consider, or NULL if none.
+    // Call this only after the previous job has been scheduled
+    // (and its project priority adjusted).
+    //
+    RESULT* get() {
+        LESS less(this);
+        if (last >= 0) {
+            if (skip_selected(pjs[last])) {
+                heap.push_back(last);
+                std::push_heap(heap.begin(), heap.end(), less);
             }
-        } else {
-            new_best = true;
-        }
-        if (new_best) {
-            best_result = rp;
-            best_atp = gstate.lookup_active_task_by_result(rp);
-            continue;
+            last = -1;
         }
-        if (rp->report_deadline > best_result->report_deadline) {
-            continue;
-        }
-
-        // If there's a tie, pick the job with the least remaining time
-        // (but don't pick an unstarted job over one that's started)
-        //
-        ACTIVE_TASK* atp = gstate.lookup_active_task_by_result(rp);
-        if (best_atp && !atp) continue;
-        if (rp->estimated_runtime_remaining() < best_result->estimated_runtime_remaining()
-            || (!best_atp && atp)
-        ) {
-            best_result = rp;
-            best_atp = atp;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), less);
+            int i = heap.back();
+            heap.pop_back();
+            PROJECT_JOBS& pj = pjs[i];
+            if (!skip_selected(pj)) continue;
+            last = i;
+            return pj.jobs[pj.next++].rp;
         }
+        return NULL;
     }
-    if (!best_result) return NULL;
-
-    return best_result;
-}
+};
 
 void CLIENT_STATE::reset_rec_accounting() {
     unsigned int i;
@@ -782,8 +845,27 @@ bool CLIENT_STATE::schedule_cpus() {
     //
     adjust_rec();
 
+    double t0 = dtime();
     make_run_list(run_list);
-    return enforce_run_list(run_list);
+    double t1 = dtime();
+    bool action = enforce_run_list(run_list);
+    double t2 = dtime();
+
+    // scheduling latency statistics
+    //
+    static int npasses = 0;
+    static double total_time = 0, max_time = 0;
+    npasses++;
+    total_time += t2 - t0;
+    if (t2 - t0 > max_time) max_time = t2 - t0;
+    if (log_flags.cpu_sched_timing) {
+        msg_printf(0, MSG_INFO,
+            "[cpu_sched_timing] %.2f ms (make_run_list %.2f ms, enforce %.2f ms) for %d jobs; %d passes, avg %.2f ms, max %.2f ms",
+            (t2-t0)*1000, (t1-t0)*1000, (t2-t1)*1000, (int)results.size(),
+            npasses, total_time*1000/npasses, max_time*1000
+        );
+    }
+    return action;
 }
 
 // Mark a job J as a deadline miss if either
@@ -826,21 +908,25 @@ static void promote_once_ran_edf() {
 }
 
 void add_coproc_jobs(
-    vector<RESULT*>& run_list, int rsc_type, PROC_RESOURCES& proc_rsc
+    vector<RESULT*>& run_list, int rsc_type, PROC_RESOURCES& proc_rsc,
+    RESULT_TASK_MAP& tasks
 ) {
     ACTIVE_TASK* atp;
     RESULT* rp;
+    EDF_QUEUE edf_queue;
+    PRIO_QUEUE prio_queue;
 
 #ifdef SIM
     if (!cpu_sched_rr_only) {
 #endif
     // choose coproc jobs from projects with coproc deadline misses
     //
+    edf_queue.init(rsc_type, tasks);
     while (!proc_rsc.stop_scan_coproc(rsc_type)) {
-        rp = earliest_deadline_result(rsc_type);
+        rp = edf_queue.get(rsc_type);
         if (!rp) break;
         rp->already_selected = true;
-        atp = gstate.lookup_active_task_by_result(rp);
+        atp = lookup_task(tasks, rp);
         if (!proc_rsc.can_schedule(rp, atp)) continue;
         proc_rsc.schedule(rp, atp, true);
         rp->project->rsc_pwf[rsc_type].deadlines_missed_copy--;
@@ -853,11 +939,12 @@ void add_coproc_jobs(
 
     // then coproc jobs in FIFO order
     //
+    prio_queue.init_coproc(rsc_type);
     while (!proc_rsc.stop_scan_coproc(rsc_type)) {
-        rp = first_coproc_result(rsc_type);
+        rp = prio_queue.get();
         if (!rp) break;
         rp->already_selected = true;
-        atp = gstate.lookup_active_task_by_result(rp);
+        atp = lookup_task(tasks, rp);
         if (!proc_rsc.can_schedule(rp, atp)) continue;
         proc_rsc.schedule(rp, atp, false);
         run_list.push_back(rp);
@@ -872,6 +959,9 @@ void CLIENT_STATE::make_run_list(vector<RESULT*>& run_list) {
     unsigned int i;
     PROC_RESOURCES proc_rsc;
     ACTIVE_TASK* atp;
+    RESULT_TASK_MAP tasks;
+    EDF_QUEUE edf_queue;
+    PRIO_QUEUE prio_queue;
 
     if (log_flags.cpu_sched_debug) {
         msg_printf(0, MSG_INFO, "[cpu_sched_debug] schedule_cpus(): start");
@@ -901,7 +991,6 @@ void CLIENT_STATE::make_run_list(vector<RESULT*>& run_list) {
     }
     for (i=0; i<projects.size(); i++) {
         p = projects[i];
-        p->next_runnable_result = NULL;
         for (int j=0; j<coprocs.n_rsc; j++) {
             p->rsc_pwf[j].deadlines_missed_copy = p->rsc_pwf[j].deadlines_missed;
         }
@@ -922,12 +1011,13 @@ void CLIENT_STATE::make_run_list(vector<RESULT*>& run_list) {
             avp->max_working_set_size = w;
         }
         atp->result->not_started = false;
+        tasks[atp->result] = atp;
     }
 
     // first, add GPU jobs
 
     for (int j=1; j<coprocs.n_rsc; j++) {
-        add_coproc_jobs(run_list, j, proc_rsc);
+        add_coproc_jobs(run_list, j, proc_rsc, tasks);
     }
 
     // then add CPU jobs.
@@ -941,11 +1031,12 @@ void CLIENT_STATE::make_run_list(vector<RESULT*>& run_list) {
 #ifdef SIM
     if (!cpu_sched_rr_only) {
 #endif
+    edf_queue.init(RSC_TYPE_CPU, tasks);
     while (!proc_rsc.stop_scan_cpu()) {
-        rp = earliest_deadline_result(RSC_TYPE_CPU);
+        rp = edf_queue.get(RSC_TYPE_CPU);
         if (!rp) break;
         rp->already_selected = true;
-        atp = lookup_active_task_by_result(rp);
+        atp = lookup_task(tasks, rp);
         if (!proc_rsc.can_schedule(rp, atp)) continue;
         proc_rsc.schedule(rp, atp, true);
         rp->project->rsc_pwf[0].deadlines_missed_copy--;
@@ -958,11 +1049,12 @@ void CLIENT_STATE::make_run_list(vector<RESULT*>& run_list) {
 
     // Next, choose CPU jobs from highest priority projects
     //
+    prio_queue.init_cpu(tasks);
     while (!proc_rsc.stop_scan_cpu()) {
-        assign_results_to_projects();
-        rp = highest_prio_project_best_result();
+        rp = prio_queue.get();
         if (!rp) break;
-        atp = lookup_active_task_by_result(rp);
+        rp->already_selected = true;
+        atp = lookup_task(tasks, rp);
         if (!proc_rsc.can_schedule(rp, atp)) continue;
         proc_rsc.schedule(rp, atp, false);
         run_list.push_back(rp);
@@ -1510,6 +1602,11 @@ void CLIENT_STATE::request_schedule_cpus(const char* where) {
         msg_printf(0, MSG_INFO, "[cpu_sched_debug] Request CPU reschedule: %s", where);
     }
     must_schedule_cpus = true;
+
+    // something happened that may affect the simulation;
+    // don't reuse its results
+    //
+    rr_sim_invalidate();
 }
 
 // Find the active task for a given result
@@ -21,7 +21,9 @@
 #else
 #include "config.h"
 #include <cstring>
+#include <ctime>
 #include <errno.h>
+#include <sys/stat.h>
 #endif
 
 #ifdef __APPLE__
@@ -92,11 +94,37 @@ static inline bool arrived_first(RESULT* r0, RESULT* r1) {
     return (r0->name_md5 < r1->name_md5);
 }
 
-// Parse the client_state.xml file
+#ifndef SIM
+// Use the binary state file if there is one
+// and it's not older than client_state.xml;
+// the XML file could have been written by a client
+// not using the binary file.
+//
+static bool use_state_snapshot() {
+    struct stat sbuf, xbuf;
+    if (stat(STATE_SNAPSHOT_NAME, &sbuf)) return false;
+    if (stat(STATE_FILE_NAME, &xbuf)) return true;
+    time_t t = sbuf.st_mtime;
+    if (!stat(STATE_JOURNAL_NAME, &sbuf) && sbuf.st_mtime > t) {
+        t = sbuf.st_mtime;
+    }
+    return t >= xbuf.st_mtime;
+}
+#endif
+
+// Parse the state file:
+// the binary state file if we're using it, else client_state.xml
 //
 int CLIENT_STATE::parse_state_file() {
     const char *fname;
 
+#ifndef SIM
+    if (use_state_snapshot()) {
+        if (!parse_state_snapshot()) return 0;
+        msg_printf(0, MSG_INFO, "Using state file %s", STATE_FILE_NAME);
+    }
+#endif
+
     // Look for a valid state file:
     // First "next", then regular, then "prev"
     //
@@ -124,13 +152,12 @@ int CLIENT_STATE::parse_state_file() {
 int CLIENT_STATE::parse_state_file_aux(const char* fname) {
     PROJECT *project=NULL;
     int retval=0;
-    string stemp;
 
-    FILE* f = fopen(fname, "r");
-    if (!f) return ERR_FOPEN;
     MIOFILE mf;
     XML_PARSER xp(&mf);
-    mf.init_file(f);
+    retval = mf.init_file_buf(fname);
+    if (retval) return retval;
+    name_index.active = true;
     while (!xp.get_tag()) {
         if (xp.match_tag("/client_state")) {
             break;
@@ -138,403 +165,424 @@ int CLIENT_STATE::parse_state_file_aux(const char* fname) {
         if (xp.match_tag("client_state")) {
             continue;
         }
-        if (xp.match_tag("project")) {
-            PROJECT temp_project;
-            retval = temp_project.parse_state(xp);
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR, "Can't parse project in state file");
-            } else {
+        parse_state_item(xp, project);
+    }
+    parse_state_finish();
+    return 0;
+}
+
+// parse one item of the state file.
+// "project" is the project of the preceding <project> element;
+// apps, files, jobs etc. are linked to it.
+//
+void CLIENT_STATE::parse_state_item(XML_PARSER& xp, PROJECT*& project) {
+    int retval;
+    string stemp;
+
+    if (xp.match_tag("project")) {
+        PROJECT temp_project;
+        retval = temp_project.parse_state(xp);
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR, "Can't parse project in state file");
+        } else {
 #ifdef SIM
-                project = new PROJECT;
-                *project = temp_project;
-                projects.push_back(project);
+            project = new PROJECT;
+            *project = temp_project;
+            projects.push_back(project);
 #else
-                project = lookup_project(temp_project.master_url);
-                if (project) {
-                    project->copy_state_fields(temp_project);
-                } else {
-                    msg_printf(&temp_project, MSG_INTERNAL_ERROR,
-                        "Project %s is in state file but no account file found",
-                        temp_project.get_project_name()
-                    );
-                }
-#endif
-            }
-            continue;
-        }
-        if (xp.match_tag("app")) {
-            APP* app = new APP;
-            retval = app->parse(xp);
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Application %s outside project in state file",
-                    app->name
-                );
-                delete app;
-                continue;
-            }
-            if (project->anonymous_platform) {
-                delete app;
-                continue;
-            }
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse application in state file"
-                );
-                delete app;
-                continue;
-            }
-            retval = link_app(project, app);
-            if (retval) {
-                msg_printf(project, MSG_INTERNAL_ERROR,
-                    "Can't handle application %s in state file",
-                    app->name
-                );
-                delete app;
-                continue;
-            }
-            apps.push_back(app);
-            continue;
-        }
-        if (xp.match_tag("file_info") || xp.match_tag("file")) {
-            FILE_INFO* fip = new FILE_INFO;
-            retval = fip->parse(xp);
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "File info outside project in state file"
-                );
-                delete fip;
-                continue;
-            }
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't handle file info in state file"
-                );
-                delete fip;
-                continue;
-            }
-            retval = link_file_info(project, fip);
-            if (project->anonymous_platform && retval == ERR_NOT_UNIQUE) {
-                delete fip;
-                continue;
-            }
-            if (retval) {
-                msg_printf(project, MSG_INTERNAL_ERROR,
-                    "Can't handle file info %s in state file",
-                    fip->name
+            project = lookup_project(temp_project.master_url);
+            if (project) {
+                project->copy_state_fields(temp_project);
+            } else {
+                msg_printf(&temp_project, MSG_INTERNAL_ERROR,
+                    "Project %s is in state file but no account file found",
+                    temp_project.get_project_name()
                 );
-                delete fip;
-                continue;
-            }
-            file_infos.push_back(fip);
-#ifndef SIM
-            // If the file had a failure before,
-            // don't start another file transfer
-            //
-            int failnum;
-            if (fip->had_failure(failnum)) {
-                if (fip->pers_file_xfer) {
-                    delete fip->pers_file_xfer;
-                    fip->pers_file_xfer = NULL;
-                }
-            }
-            if (fip->pers_file_xfer) {
-                retval = fip->pers_file_xfer->init(fip, fip->pers_file_xfer->is_upload);
-                if (retval) {
-                    msg_printf(project, MSG_INTERNAL_ERROR,
-                        "Can't initialize file transfer for %s",
-                        fip->name
-                    );
-                }
-                retval = pers_file_xfers->insert(fip->pers_file_xfer);
-                if (retval) {
-                    msg_printf(project, MSG_INTERNAL_ERROR,
-                        "Can't start persistent file transfer for %s",
-                        fip->name
-                    );
-                }
             }
 #endif
-            continue;
         }
-        if (xp.match_tag("app_version")) {
-            APP_VERSION* avp = new APP_VERSION;
-            retval = avp->parse(xp);
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Application version outside project in state file"
-                );
-                delete avp;
-                continue;
-            }
-            if (project->anonymous_platform) {
-                delete avp;
-                continue;
-            }
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse application version in state file"
-                );
-                delete avp;
-                continue;
-            } 
-            if (strlen(avp->platform) == 0) {
-                safe_strcpy(avp->platform, get_primary_platform());
-            } else {
-                if (!is_supported_platform(avp->platform)) {
-                    // if it's a platform we haven't heard of,
-                    // must be that the user tried out a 64 bit client
-                    // and then reverted to a 32-bit client.
-                    // Let's not throw away the app version and its WUs
-                    //
+        return;
+    }
+    if (xp.match_tag("app")) {
+        APP* app = new APP;
+        retval = app->parse(xp);
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Application %s outside project in state file",
+                app->name
+            );
+            delete app;
+            return;
+        }
+        if (project->anonymous_platform) {
+            delete app;
+            return;
+        }
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse application in state file"
+            );
+            delete app;
+            return;
+        }
+        retval = link_app(project, app);
+        if (retval) {
+            msg_printf(project, MSG_INTERNAL_ERROR,
+                "Can't handle application %s in state file",
+                app->name
+            );
+            delete app;
+            return;
+        }
+        apps.push_back(app);
+        return;
+    }
+    if (xp.match_tag("file_info") || xp.match_tag("file")) {
+        FILE_INFO* fip = new FILE_INFO;
+        retval = fip->parse(xp);
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "File info outside project in state file"
+            );
+            delete fip;
+            return;
+        }
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't handle file info in state file"
+            );
+            delete fip;
+            return;
+        }
+        retval = link_file_info(project, fip);
+        if (project->anonymous_platform && retval == ERR_NOT_UNIQUE) {
+            delete fip;
+            return;
+        }
+        if (retval) {
+            msg_printf(project, MSG_INTERNAL_ERROR,
+                "Can't handle file info %s in state file",
+                fip->name
+            );
+            delete fip;
+            return;
+        }
+        file_infos.push_back(fip);
+        name_index.file_infos[NAME_KEY(project, fip->name)] = fip;
 #ifndef SIM
-                    msg_printf(project, MSG_INTERNAL_ERROR,
-                        "App version has unsupported platform %s; changing to %s",
-                        avp->platform, get_primary_platform()
-                    );
-#endif
-                    safe_strcpy(avp->platform, get_primary_platform());
-                }
-            }
-            if (avp->missing_coproc) {
-                msg_printf(project, MSG_INFO,
-                    "Application uses missing %s GPU",
-                    avp->missing_coproc_name
-                );
-            }
-            retval = link_app_version(project, avp);
-            if (retval) {
-                delete avp;
-                continue;
+        // If the file had a failure before,
+        // don't start another file transfer
+        //
+        int failnum;
+        if (fip->had_failure(failnum)) {
+            if (fip->pers_file_xfer) {
+                delete fip->pers_file_xfer;
+                fip->pers_file_xfer = NULL;
             }
-            app_versions.push_back(avp);
-            continue;
         }
-        if (xp.match_tag("workunit")) {
-            WORKUNIT* wup = new WORKUNIT;
-            retval = wup->parse(xp);
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Workunit outside project in state file"
-                );
-                delete wup;
-                continue;
-            }
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse workunit in state file"
-                );
-                delete wup;
-                continue;
-            }
-            retval = link_workunit(project, wup);
+        if (fip->pers_file_xfer) {
+            retval = fip->pers_file_xfer->init(fip, fip->pers_file_xfer->is_upload);
             if (retval) {
                 msg_printf(project, MSG_INTERNAL_ERROR,
-                    "Can't handle workunit in state file"
-                );
-                delete wup;
-                continue;
-            }
-            workunits.push_back(wup);
-            continue;
-        }
-        if (xp.match_tag("result")) {
-            RESULT* rp = new RESULT;
-            retval = rp->parse_state(xp);
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Task %s outside project in state file",
-                    rp->name
-                );
-                delete rp;
-                continue;
-            }
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse task in state file"
+                    "Can't initialize file transfer for %s",
+                    fip->name
                 );
-                delete rp;
-                continue;
             }
-            retval = link_result(project, rp);
+            retval = pers_file_xfers->insert(fip->pers_file_xfer);
             if (retval) {
                 msg_printf(project, MSG_INTERNAL_ERROR,
-                    "Can't link task %s in state file",
-                    rp->name
-                );
-                delete rp;
-                continue;
-            }
-            // handle transition from old clients which didn't store result.platform;
-            // skip for anon platform
-            if (!project->anonymous_platform) {
-                if (!strlen(rp->platform) || !is_supported_platform(rp->platform)) {
-                    safe_strcpy(rp->platform, get_primary_platform());
-                    rp->version_num = latest_version(rp->wup->app, rp->platform);
-                }
-            }
-            rp->avp = lookup_app_version(
-                rp->wup->app, rp->platform, rp->version_num, rp->plan_class
-            );
-            if (!rp->avp) {
-                msg_printf(project, MSG_INTERNAL_ERROR,
-                    "No application found for task: %s %d %s; discarding",
-                    rp->platform, rp->version_num, rp->plan_class
-                );
-                delete rp;
-                continue;
-            }
-            if (rp->avp->missing_coproc) {
-                msg_printf(project, MSG_INFO,
-                    "Missing coprocessor for task %s", rp->name
-                );
-                rp->coproc_missing = true;
-            }
-            rp->wup->version_num = rp->version_num;
-            results.push_back(rp);
-            continue;
-        }
-        if (xp.match_tag("project_files")) {
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Project files outside project in state file"
+                    "Can't start persistent file transfer for %s",
+                    fip->name
                 );
-                xp.skip_unexpected();
-                continue;
             }
-            parse_project_files(xp, project->project_files);
-            project->link_project_files();
-            continue;
         }
-        if (xp.match_tag("host_info")) {
-#ifdef SIM
-            retval = host_info.parse(xp, false);
-            coprocs = host_info.coprocs;
-            coprocs.bound_counts();
-#else
-            retval = host_info.parse(xp, true);
 #endif
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse host info in state file"
-                );
-            }
-            continue;
-        }
-        if (xp.match_tag("time_stats")) {
-            retval = time_stats.parse(xp);
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse time stats in state file"
-                );
-            }
-            continue;
+        return;
+    }
+    if (xp.match_tag("app_version")) {
+        APP_VERSION* avp = new APP_VERSION;
+        retval = avp->parse(xp);
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Application version outside project in state file"
+            );
+            delete avp;
+            return;
         }
-        if (xp.match_tag("net_stats")) {
-            retval = net_stats.parse(xp);
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse network stats in state file"
-                );
-            }
-            continue;
+        if (project->anonymous_platform) {
+            delete avp;
+            return;
         }
-        if (xp.match_tag("active_task_set")) {
-            retval = active_tasks.parse(xp);
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse active tasks in state file"
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse application version in state file"
+            );
+            delete avp;
+            return;
+        } 
+        if (strlen(avp->platform) == 0) {
+            safe_strcpy(avp->platform, get_primary_platform());
+        } else {
+            if (!is_supported_platform(avp->platform)) {
+                // if it's a platform we haven't heard of,
+                // must be that the user tried out a 64 bit client
+                // and then reverted to a 32-bit client.
+                // Let's not throw away the app version and its WUs
+                //
+#ifndef SIM
+                msg_printf(project, MSG_INTERNAL_ERROR,
+                    "App version has unsupported platform %s; changing to %s",
+                    avp->platform, get_primary_platform()
                 );
+#endif
+                safe_strcpy(avp->platform, get_primary_platform());
             }
-            continue;
         }
-        if (xp.parse_string("platform_name", statefile_platform_name)) {
-            continue;
+        if (avp->missing_coproc) {
+            msg_printf(project, MSG_INFO,
+                "Application uses missing %s GPU",
+                avp->missing_coproc_name
+            );
         }
-        if (xp.parse_string("alt_platform", stemp)) {
-            continue;
+        retval = link_app_version(project, avp);
+        if (retval) {
+            delete avp;
+            return;
         }
-        if (xp.parse_int("user_run_request", retval)) {
-            cpu_run_mode.set(retval, 0);
-            continue;
+        app_versions.push_back(avp);
+        return;
+    }
+    if (xp.match_tag("workunit")) {
+        WORKUNIT* wup = new WORKUNIT;
+        retval = wup->parse(xp);
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Workunit outside project in state file"
+            );
+            delete wup;
+            return;
         }
-        if (xp.parse_int("user_run_prev_request", retval)) {
-            cpu_run_mode.set_prev(retval);
-            continue;
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse workunit in state file"
+            );
+            delete wup;
+            return;
         }
-        if (xp.parse_int("user_gpu_request", retval)) {
-            gpu_run_mode.set(retval, 0);
-            continue;
+        retval = link_workunit(project, wup);
+        if (retval) {
+            msg_printf(project, MSG_INTERNAL_ERROR,
+                "Can't handle workunit in state file"
+            );
+            delete wup;
+            return;
         }
-        if (xp.parse_int("user_gpu_prev_request", retval)) {
-            gpu_run_mode.set_prev(retval);
-            continue;
+        workunits.push_back(wup);
+        name_index.workunits[NAME_KEY(project, wup->name)] = wup;
+        return;
+    }
+    if (xp.match_tag("result")) {
+        RESULT* rp = new RESULT;
+        retval = rp->parse_state(xp);
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Task %s outside project in state file",
+                rp->name
+            );
+            delete rp;
+            return;
         }
-        if (xp.parse_int("user_network_request", retval)) {
-            network_run_mode.set(retval, 0);
-            continue;
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse task in state file"
+            );
+            delete rp;
+            return;
         }
-        if (xp.parse_int("core_client_major_version", old_major_version)) {
-            continue;
+        retval = link_result(project, rp);
+        if (retval) {
+            msg_printf(project, MSG_INTERNAL_ERROR,
+                "Can't link task %s in state file",
+                rp->name
+            );
+            delete rp;
+            return;
         }
-        if (xp.parse_int("core_client_minor_version", old_minor_version)) {
-            continue;
+        // handle transition from old clients which didn't store result.platform;
+        // skip for anon platform
+        if (!project->anonymous_platform) {
+            if (!strlen(rp->platform) || !is_supported_platform(rp->platform)) {
+                safe_strcpy(rp->platform, get_primary_platform());
+                rp->version_num = latest_version(rp->wup->app, rp->platform);
+            }
         }
-        if (xp.parse_int("core_client_release", old_release)) {
-            continue;
+        rp->avp = lookup_app_version(
+            rp->wup->app, rp->platform, rp->version_num, rp->plan_class
+        );
+        if (!rp->avp) {
+            msg_printf(project, MSG_INTERNAL_ERROR,
+                "No application found for task: %s %d %s; discarding",
+                rp->platform, rp->version_num, rp->plan_class
+            );
+            delete rp;
+            return;
         }
-        if (xp.parse_str("language", language, sizeof(language))) {
-            continue;
+        if (rp->avp->missing_coproc) {
+            msg_printf(project, MSG_INFO,
+                "Missing coprocessor for task %s", rp->name
+            );
+            rp->coproc_missing = true;
         }
-        if (xp.match_tag("proxy_info")) {
-            retval = gui_proxy_info.parse(xp);
-            if (retval) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "Can't parse proxy info in state file"
-                );
-            }
-            continue;
+        rp->wup->version_num = rp->version_num;
+        results.push_back(rp);
+        name_index.results[NAME_KEY(project, rp->name)] = rp;
+        return;
+    }
+    if (xp.match_tag("project_files")) {
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Project files outside project in state file"
+            );
+            xp.skip_unexpected();
+            return;
         }
-        if (xp.parse_str("host_venue", main_host_venue, sizeof(main_host_venue))) {
-            continue;
+        parse_project_files(xp, project->project_files);
+        project->link_project_files();
+        return;
+    }
+    if (xp.match_tag("host_info")) {
+#ifdef SIM
+        retval = host_info.parse(xp, false);
+        coprocs = host_info.coprocs;
+        coprocs.bound_counts();
+#else
+        retval = host_info.parse(xp, true);
+#endif
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse host info in state file"
+            );
         }
-        if (xp.parse_double("new_version_check_time", new_version_check_time)) {
-            continue;
+        return;
+    }
+    if (xp.match_tag("time_stats")) {
+        retval = time_stats.parse(xp);
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse time stats in state file"
+            );
         }
-        if (xp.parse_double("all_projects_list_check_time", all_projects_list_check_time)) {
-            continue;
+        return;
+    }
+    if (xp.match_tag("net_stats")) {
+        retval = net_stats.parse(xp);
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse network stats in state file"
+            );
         }
-        if (xp.parse_string("newer_version", newer_version)) {
-            continue;
+        return;
+    }
+    if (xp.match_tag("active_task_set")) {
+        retval = active_tasks.parse(xp);
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse active tasks in state file"
+            );
         }
-        if (xp.parse_string("client_version_check_url", client_version_check_url)) {
-            continue;
+        return;
+    }
+    if (xp.parse_string("platform_name", statefile_platform_name)) {
+        return;
+    }
+    if (xp.parse_string("alt_platform", stemp)) {
+        return;
+    }
+    if (xp.parse_int("user_run_request", retval)) {
+        cpu_run_mode.set(retval, 0);
+        return;
+    }
+    if (xp.parse_int("user_run_prev_request", retval)) {
+        cpu_run_mode.set_prev(retval);
+        return;
+    }
+    if (xp.parse_int("user_gpu_request", retval)) {
+        gpu_run_mode.set(retval, 0);
+        return;
+    }
+    if (xp.parse_int("user_gpu_prev_request", retval)) {
+        gpu_run_mode.set_prev(retval);
+        return;
+    }
+    if (xp.parse_int("user_network_request", retval)) {
+        network_run_mode.set(retval, 0);
+        return;
+    }
+    if (xp.parse_int("core_client_major_version", old_major_version)) {
+        return;
+    }
+    if (xp.parse_int("core_client_minor_version", old_minor_version)) {
+        return;
+    }
+    if (xp.parse_int("core_client_release", old_release)) {
+        return;
+    }
+    if (xp.parse_str("language", language, sizeof(language))) {
+        return;
+    }
+    if (xp.match_tag("proxy_info")) {
+        retval = gui_proxy_info.parse(xp);
+        if (retval) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "Can't parse proxy info in state file"
+            );
         }
+        return;
+    }
+    if (xp.parse_str("host_venue", main_host_venue, sizeof(main_host_venue))) {
+        return;
+    }
+    if (xp.parse_double("new_version_check_time", new_version_check_time)) {
+        return;
+    }
+    if (xp.parse_double("all_projects_list_check_time", all_projects_list_check_time)) {
+        return;
+    }
+    if (xp.parse_string("newer_version", newer_version)) {
+        return;
+    }
+    if (xp.parse_string("client_version_check_url", client_version_check_url)) {
+        return;
+    }
 #ifdef ENABLE_AUTO_UPDATE
-        if (xp.match_tag("auto_update")) {
-            if (!project) {
-                msg_printf(NULL, MSG_INTERNAL_ERROR,
-                    "auto update outside project in state file"
-                );
-                xp.skip_unexpected();
-                continue;
-            }
-            if (!auto_update.parse(xp) && !auto_update.validate_and_link(project)) {
-                auto_update.present = true;
-            }
-            continue;
-        }
-#endif
-        if (log_flags.unparsed_xml) {
-            msg_printf(0, MSG_INFO,
-                "[unparsed_xml] state_file: unrecognized: %s",
-                xp.parsed_tag
+    if (xp.match_tag("auto_update")) {
+        if (!project) {
+            msg_printf(NULL, MSG_INTERNAL_ERROR,
+                "auto update outside project in state file"
             );
+            xp.skip_unexpected();
+            return;
         }
-        xp.skip_unexpected();
+        if (!auto_update.parse(xp) && !auto_update.validate_and_link(project)) {
+            auto_update.present = true;
+        }
+        return;
     }
+#endif
+    if (log_flags.unparsed_xml) {
+        msg_printf(0, MSG_INFO,
+            "[unparsed_xml] state_file: unrecognized: %s",
+            xp.parsed_tag
+        );
+    }
+    xp.skip_unexpected();
+}
+
+// called when all items have been parsed
+//
+void CLIENT_STATE::parse_state_finish() {
+    name_index.clear();
     sort_results();
-    fclose(f);
     
     // if total resource share is zero, set all shares to 1
     //
@@ -553,7 +601,6 @@ int CLIENT_STATE::parse_state_file_aux(const char* fname) {
             }
         }
     }
-    return 0;
 }
 
 // this is called whenever new results are added,
@@ -593,9 +640,20 @@ void CLIENT_STATE::sort_projects_by_name() {
 
 #ifndef SIM
 
-// Write the client_state.xml file
+// Write the state file: client_state.xml,
+// or with <binary_state_file> the changes since the last write
+// (see below)
 //
 int CLIENT_STATE::write_state_file() {
+    if (cc_config.binary_state_file) {
+        return write_state_journal();
+    }
+    return write_state_file_xml();
+}
+
+// Write the client_state.xml file
+//
+int CLIENT_STATE::write_state_file_xml() {
     MFILE mf;
     int retval, ret1, ret2, attempt;
 #ifdef _WIN32
@@ -710,33 +768,98 @@ int CLIENT_STATE::write_state_file() {
         if (attempt < MAX_STATE_FILE_WRITE_ATTEMPTS) continue;
         return ERR_RENAME;
     }
+
+    // if we've stopped using the binary state file, it's now out of date
+    //
+    if (!cc_config.binary_state_file && boinc_file_exists(STATE_SNAPSHOT_NAME)) {
+        boinc_delete_file(STATE_SNAPSHOT_NAME);
+        boinc_delete_file(STATE_JOURNAL_NAME);
+    }
     return 0;
 }
 
-int CLIENT_STATE::write_state(MIOFILE& f) {
+// The state is written as a sequence of records:
+// the host info and time and network stats;
+// for each project, the project, its apps, files, app versions,
+// workunits, results, project files and auto-update;
+// then the active tasks and the client's own fields.
+// A record is the XML of one object,
+// identified by its type and a key (project URL and name).
+// write_state() writes the records to client_state.xml;
+// the binary state file (see below) keeps them as separate records.
+//
+#define STATE_REC_HOST_INFO     1
+#define STATE_REC_TIME_STATS    2
+#define STATE_REC_NET_STATS     3
+#define STATE_REC_PROJECT       4
+#define STATE_REC_APP           5
+#define STATE_REC_FILE_INFO     6
+#define STATE_REC_APP_VERSION   7
+#define STATE_REC_WORKUNIT      8
+#define STATE_REC_RESULT        9
+#define STATE_REC_PROJECT_FILES 10
+#define STATE_REC_AUTO_UPDATE   11
+#define STATE_REC_ACTIVE_TASKS  12
+#define STATE_REC_MISC          13
+#define STATE_REC_NTYPES        14
+    // records are parsed in order of type;
+    // e.g. results are linked to workunits and app versions
+
+struct STATE_RECORD_WRITER {
+    int retval;
+    STATE_RECORD_WRITER(): retval(0) {}
+    virtual ~STATE_RECORD_WRITER() {}
+    virtual MIOFILE& begin(int type, const string& key) = 0;
+        // return the MIOFILE to write the record's XML to
+    virtual void end() = 0;
+        // the record is complete; set retval on error
+};
+
+// writes the records to an XML file, one after the other
+//
+struct XML_STATE_WRITER : STATE_RECORD_WRITER {
+    MIOFILE& f;
+    XML_STATE_WRITER(MIOFILE& _f): f(_f) {}
+    MIOFILE& begin(int, const string&) {
+        return f;
+    }
+    void end() {}
+};
+
+static string state_rec_key(PROJECT* p, const char* name) {
+    string s = p->master_url;
+    if (name) {
+        s += " ";
+        s += name;
+    }
+    return s;
+}
+
+int CLIENT_STATE::write_state_records(STATE_RECORD_WRITER& w) {
     unsigned int i, j;
     int retval;
+    char buf[1024];
 
-#ifdef SIM
-    fprintf(stderr, "simulator shouldn't write state file\n");
-    exit(1);
-#endif
-    f.printf("<client_state>\n");
-    retval = host_info.write(f, true, true);
+    retval = host_info.write(w.begin(STATE_REC_HOST_INFO, ""), true, true);
     if (retval) return retval;
-    retval = time_stats.write(f, false);
+    w.end();
+    retval = time_stats.write(w.begin(STATE_REC_TIME_STATS, ""), false);
     if (retval) return retval;
-    retval = net_stats.write(f);
+    w.end();
+    retval = net_stats.write(w.begin(STATE_REC_NET_STATS, ""));
     if (retval) return retval;
+    w.end();
     for (j=0; j<projects.size(); j++) {
         PROJECT* p = projects[j];
-        retval = p->write_state(f);
+        retval = p->write_state(w.begin(STATE_REC_PROJECT, state_rec_key(p, NULL)));
         if (retval) return retval;
+        w.end();
         for (i=0; i<apps.size(); i++) {
-            if (apps[i]->project == p) {
-                retval = apps[i]->write(f);
-                if (retval) return retval;
-            }
+            APP* app = apps[i];
+            if (app->project != p) continue;
+            retval = app->write(w.begin(STATE_REC_APP, state_rec_key(p, app->name)));
+            if (retval) return retval;
+            w.end();
         }
         for (i=0; i<file_infos.size(); i++) {
             if (file_infos[i]->project != p) continue;
@@ -744,28 +867,69 @@ int CLIENT_STATE::write_state(MIOFILE& f) {
             // don't write file infos for anonymous platform app files
             //
             if (fip->anonymous_platform_file) continue;
-            retval = fip->write(f, false);
+            retval = fip->write(
+                w.begin(STATE_REC_FILE_INFO, state_rec_key(p, fip->name)), false
+            );
             if (retval) return retval;
+            w.end();
         }
         for (i=0; i<app_versions.size(); i++) {
-            if (app_versions[i]->project == p) {
-                app_versions[i]->write(f);
-            }
+            APP_VERSION* avp = app_versions[i];
+            if (avp->project != p) continue;
+            snprintf(buf, sizeof(buf), "%s %s %d %s",
+                avp->app_name, avp->platform, avp->version_num, avp->plan_class
+            );
+            avp->write(w.begin(STATE_REC_APP_VERSION, state_rec_key(p, buf)));
+            w.end();
         }
         for (i=0; i<workunits.size(); i++) {
-            if (workunits[i]->project == p) workunits[i]->write(f, false);
+            WORKUNIT* wup = workunits[i];
+            if (wup->project != p) continue;
+            wup->write(w.begin(STATE_REC_WORKUNIT, state_rec_key(p, wup->name)), false);
+            w.end();
         }
         for (i=0; i<results.size(); i++) {
-            if (results[i]->project == p) results[i]->write(f, false);
+            RESULT* rp = results[i];
+            if (rp->project != p) continue;
+            rp->write(w.begin(STATE_REC_RESULT, state_rec_key(p, rp->name)), false);
+            w.end();
         }
-        p->write_project_files(f);
+        p->write_project_files(w.begin(STATE_REC_PROJECT_FILES, state_rec_key(p, NULL)));
+        w.end();
 #ifdef ENABLE_AUTO_UPDATE
         if (auto_update.present && auto_update.project==p) {
-            auto_update.write(f);
+            auto_update.write(w.begin(STATE_REC_AUTO_UPDATE, state_rec_key(p, NULL)));
+            w.end();
         }
 #endif
     }
-    active_tasks.write(f);
+    active_tasks.write(w.begin(STATE_REC_ACTIVE_TASKS, ""));
+    w.end();
+    write_state_misc(w.begin(STATE_REC_MISC, ""));
+    w.end();
+    return w.retval;
+}
+
+int CLIENT_STATE::write_state(MIOFILE& f) {
+    int retval;
+    XML_STATE_WRITER w(f);
+
+#ifdef SIM
+    fprintf(stderr, "simulator shouldn't write state file\n");
+    exit(1);
+#endif
+    f.printf("<client_state>\n");
+    retval = write_state_records(w);
+    if (retval) return retval;
+    f.printf("</client_state>\n");
+    return 0;
+}
+
+// write the client's own fields
+//
+void CLIENT_STATE::write_state_misc(MIOFILE& f) {
+    unsigned int i;
+
     f.printf(
         "<platform_name>%s</platform_name>\n"
         "<core_client_major_version>%d</core_client_major_version>\n"
@@ -808,20 +972,514 @@ int CLIENT_STATE::write_state(MIOFILE& f) {
     if (strlen(main_host_venue)) {
         f.printf("<host_venue>%s</host_venue>\n", main_host_venue);
     }
-    f.printf("</client_state>\n");
-    return 0;
 }
 
-// Write the client_state.xml file if necessary
-// TODO: write no more often than X seconds
+// Write the client_state.xml file if necessary,
+// but no more often than cc_config.state_file_write_interval seconds
+// (with many tasks the file is large, and writing it takes a while)
 //
 int CLIENT_STATE::write_state_file_if_needed() {
     int retval;
     if (client_state_dirty) {
+        if (now < last_state_file_write_time + cc_config.state_file_write_interval) {
+            return 0;
+        }
         client_state_dirty = false;
+        double t = dtime();
         retval = write_state_file();
+        last_state_file_write_time = now;
         if (retval) return retval;
+        if (log_flags.statefile_debug) {
+            msg_printf(0, MSG_INFO,
+                "[statefile] wrote state file in %.3f sec", dtime() - t
+            );
+        }
+    }
+    return 0;
+}
+
+// The binary state file (cc_config.binary_state_file).
+// client_state.xml is rewritten in full each time the state changes;
+// with thousands of jobs that's slow, though few records change.
+// Instead the state is kept in two files:
+// client_state.bin: a snapshot of all records;
+// client_state.jnl: the changes since the snapshot,
+//     i.e. new or changed records, and deletions.
+// Writing the state appends the changed records to the journal.
+// When the journal gets bigger than the snapshot,
+// a new snapshot is written and the journal is started over.
+// On startup we read the snapshot and replay the journal.
+// client_state.xml is still written on exit.
+//
+// Both files start with a header (magic string and generation);
+// a journal applies only to the snapshot of the same generation.
+// A record is a header, its key, and its data (the XML of the object).
+// A checksum covers all three;
+// the journal is replayed up to the first bad (e.g. torn) record.
+// The files are in native byte order.
+
+#define STATE_SNAPSHOT_MAGIC    "BOINCSS1"
+#define STATE_JOURNAL_MAGIC     "BOINCSJ1"
+
+#define STATE_REC_PUT   1
+#define STATE_REC_DEL   2
+#define STATE_REC_END   3
+    // last record of a snapshot
+
+struct STATE_FILE_HEADER {
+    char magic[8];
+    unsigned int gen;
+};
+
+struct STATE_REC_HEADER {
+    unsigned char op;
+    unsigned char type;
+    unsigned short key_len;
+    unsigned int data_len;
+    unsigned int checksum;
+};
+
+// FNV-1a hash
+//
+static inline unsigned long long state_hash(
+    const void* p, size_t n, unsigned long long h=14695981039346656037ULL
+) {
+    const unsigned char* q = (const unsigned char*)p;
+    for (size_t i=0; i<n; i++) {
+        h ^= q[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static unsigned int state_rec_checksum(
+    STATE_REC_HEADER h, const char* key, const char* data
+) {
+    h.checksum = 0;
+    unsigned long long x = state_hash(&h, sizeof(h));
+    x = state_hash(key, h.key_len, x);
+    x = state_hash(data, h.data_len, x);
+    return (unsigned int)(x ^ (x>>32));
+}
+
+static void write_state_rec(
+    MFILE& mf, int op, int type, const string& key, const char* data, int len
+) {
+    STATE_REC_HEADER h;
+    memset(&h, 0, sizeof(h));
+    h.op = op;
+    h.type = type;
+    h.key_len = (unsigned short)key.size();
+    h.data_len = len;
+    h.checksum = state_rec_checksum(h, key.c_str(), data);
+    mf.write(&h, sizeof(h), 1);
+    mf.write(key.c_str(), 1, key.size());
+    mf.write(data, 1, len);
+}
+
+static void write_state_header(MFILE& mf, const char* magic, unsigned int gen) {
+    STATE_FILE_HEADER h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(h.magic));
+    h.gen = gen;
+    mf.write(&h, sizeof(h), 1);
+}
+
+// what's in the snapshot and journal on disk
+//
+struct STATE_REC_INFO {
+    unsigned long long hash;
+        // hash of the record's data
+    int pass;
+        // the last write in which the record was present
+};
+
+struct STATE_JOURNAL {
+    bool valid;
+        // "records" describes the files on disk;
+        // if not, the next write is a snapshot
+    unsigned int gen;
+    double snapshot_size;
+    double journal_size;
+    int pass;
+    std::map<string, STATE_REC_INFO> records;
+        // key is type (1 char) + record key
+
+    STATE_JOURNAL(): valid(false), gen(0), snapshot_size(0), journal_size(0), pass(0) {}
+};
+
+static STATE_JOURNAL state_journal;
+
+static inline string state_rec_id(int type, const string& key) {
+    return string(1, (char)type) + key;
+}
+
+// base class for writers of binary records:
+// collect the XML of each record in memory
+//
+struct BINARY_STATE_WRITER : STATE_RECORD_WRITER {
+    MFILE& out;
+    MFILE rec;
+    MIOFILE rec_miof;
+    int type;
+    string key;
+
+    BINARY_STATE_WRITER(MFILE& _out): out(_out), type(0) {
+        rec_miof.init_mfile(&rec);
+    }
+    MIOFILE& begin(int _type, const string& _key) {
+        type = _type;
+        key = _key;
+        return rec_miof;
+    }
+    void end() {
+        char* p;
+        int n;
+        rec.get_buf(p, n);
+        record(p?p:"", n);
+        free(p);
+    }
+    virtual void record(const char* data, int len) = 0;
+};
+
+// write all records
+//
+struct SNAPSHOT_WRITER : BINARY_STATE_WRITER {
+    SNAPSHOT_WRITER(MFILE& _out): BINARY_STATE_WRITER(_out) {}
+    void record(const char* data, int len) {
+        write_state_rec(out, STATE_REC_PUT, type, key, data, len);
+        STATE_REC_INFO& ri = state_journal.records[state_rec_id(type, key)];
+        ri.hash = state_hash(data, len);
+        ri.pass = state_journal.pass;
+    }
+};
+
+// write records that are new or have changed since the last write
+//
+struct JOURNAL_WRITER : BINARY_STATE_WRITER {
+    int nchanged;
+    JOURNAL_WRITER(MFILE& _out): BINARY_STATE_WRITER(_out), nchanged(0) {}
+    void record(const char* data, int len) {
+        unsigned long long h = state_hash(data, len);
+        STATE_REC_INFO& ri = state_journal.records[state_rec_id(type, key)];
+        if (!ri.pass || ri.hash != h) {
+            write_state_rec(out, STATE_REC_PUT, type, key, data, len);
+            nchanged++;
+        }
+        ri.hash = h;
+        ri.pass = state_journal.pass;
+    }
+};
+
+// Write a snapshot of the state, and start a new journal
+//
+int CLIENT_STATE::write_state_snapshot() {
+    MFILE mf;
+    int retval, ret2;
+    unsigned int gen;
+
+    if (log_flags.statefile_debug) {
+        msg_printf(0, MSG_INFO, "[statefile] Writing state snapshot");
+    }
+    state_journal.valid = false;
+    state_journal.records.clear();
+    state_journal.pass++;
+
+    // the generation must differ from that of any journal on disk
+    //
+    gen = (unsigned int)time(0);
+    if (gen <= state_journal.gen) gen = state_journal.gen + 1;
+
+    retval = mf.open(STATE_SNAPSHOT_NEXT, "wb");
+    if (retval) {
+        msg_printf(0, MSG_INTERNAL_ERROR,
+            "Can't open %s: %s", STATE_SNAPSHOT_NEXT, boincerror(retval)
+        );
+        return ERR_FOPEN;
+    }
+    write_state_header(mf, STATE_SNAPSHOT_MAGIC, gen);
+    SNAPSHOT_WRITER w(mf);
+    retval = write_state_records(w);
+    write_state_rec(mf, STATE_REC_END, 0, "", "", 0);
+    ret2 = mf.close();
+    if (!retval) retval = ret2;
+    if (!retval) retval = boinc_rename(STATE_SNAPSHOT_NEXT, STATE_SNAPSHOT_NAME);
+    if (retval) {
+        msg_printf(0, MSG_INTERNAL_ERROR,
+            "Couldn't write state snapshot: %s", boincerror(retval)
+        );
+        return retval;
+    }
+    state_journal.gen = gen;
+
+    retval = mf.open(STATE_JOURNAL_NAME, "wb");
+    if (retval) {
+        msg_printf(0, MSG_INTERNAL_ERROR,
+            "Can't open %s: %s", STATE_JOURNAL_NAME, boincerror(retval)
+        );
+        return ERR_FOPEN;
+    }
+    write_state_header(mf, STATE_JOURNAL_MAGIC, gen);
+    retval = mf.close();
+    if (retval) return retval;
+
+    file_size(STATE_SNAPSHOT_NAME, state_journal.snapshot_size);
+    file_size(STATE_JOURNAL_NAME, state_journal.journal_size);
+    state_journal.valid = true;
+    if (log_flags.statefile_debug) {
+        msg_printf(0, MSG_INFO,
+            "[statefile] Wrote state snapshot: %d records, %.0f bytes",
+            (int)state_journal.records.size(), state_journal.snapshot_size
+        );
+    }
+    return 0;
+}
+
+// Append the changes since the last write to the journal.
+// If the journal is bigger than the snapshot,
+// or we don't know what's on disk (e.g. at startup),
+// write a snapshot instead.
+//
+int CLIENT_STATE::write_state_journal() {
+    MFILE mf;
+    int retval, ret2, ndeleted=0;
+
+    if (!state_journal.valid
+        || state_journal.journal_size > state_journal.snapshot_size
+        || !boinc_file_exists(STATE_JOURNAL_NAME)
+    ) {
+        return write_state_snapshot();
+    }
+    retval = mf.open(STATE_JOURNAL_NAME, "ab");
+    if (retval) {
+        msg_printf(0, MSG_INTERNAL_ERROR,
+            "Can't open %s: %s", STATE_JOURNAL_NAME, boincerror(retval)
+        );
+        state_journal.valid = false;
+        return ERR_FOPEN;
+    }
+    state_journal.pass++;
+    JOURNAL_WRITER w(mf);
+    retval = write_state_records(w);
+    if (!retval) {
+        // records that weren't written this time are gone
+        //
+        std::map<string, STATE_REC_INFO>::iterator i = state_journal.records.begin();
+        while (i != state_journal.records.end()) {
+            if (i->second.pass == state_journal.pass) {
+                ++i;
+                continue;
+            }
+            write_state_rec(mf, STATE_REC_DEL, i->first[0], i->first.substr(1), "", 0);
+            state_journal.records.erase(i++);
+            ndeleted++;
+        }
+    }
+    ret2 = mf.close();
+    if (!retval) retval = ret2;
+    if (retval) {
+        msg_printf(0, MSG_INTERNAL_ERROR,
+            "Couldn't write state journal: %s", boincerror(retval)
+        );
+        state_journal.valid = false;
+        return retval;
+    }
+    file_size(STATE_JOURNAL_NAME, state_journal.journal_size);
+    if (log_flags.statefile_debug) {
+        msg_printf(0, MSG_INFO,
+            "[statefile] Journal: %d changed, %d deleted records; %.0f bytes",
+            w.nchanged, ndeleted, state_journal.journal_size
+        );
+    }
+    return 0;
+}
+
+
+// read a binary state file into memory and check its header
+//
+static int read_state_bin(
+    const char* path, const char* magic, char*& buf, size_t& len, unsigned int& gen
+) {
+    STATE_FILE_HEADER h;
+    double size;
+
+    buf = NULL;
+    if (file_size(path, size)) return ERR_FOPEN;
+    if (size < sizeof(h)) return ERR_BAD_FORMAT;
+    FILE* f = boinc_fopen(path, "rb");
+    if (!f) return ERR_FOPEN;
+    len = (size_t)size;
+    buf = (char*)malloc(len);
+    if (!buf) {
+        fclose(f);
+        return ERR_MALLOC;
+    }
+    size_t n = fread(buf, 1, len, f);
+    fclose(f);
+    if (n != len) {
+        free(buf);
+        buf = NULL;
+        return ERR_FREAD;
+    }
+    memcpy(&h, buf, sizeof(h));
+    if (memcmp(h.magic, magic, sizeof(h.magic))) {
+        free(buf);
+        buf = NULL;
+        return ERR_BAD_FORMAT;
+    }
+    gen = h.gen;
+    return 0;
+}
+
+// get the record at buf[pos] and advance pos.
+// Return false if it's incomplete or corrupt.
+//
+static bool get_state_rec(
+    const char* buf, size_t len, size_t& pos,
+    STATE_REC_HEADER& h, const char*& key, const char*& data
+) {
+    if (len - pos < sizeof(h)) return false;
+    memcpy(&h, buf+pos, sizeof(h));
+    if (len - pos - sizeof(h) < (size_t)h.key_len + h.data_len) return false;
+    key = buf + pos + sizeof(h);
+    data = key + h.key_len;
+    if (state_rec_checksum(h, key, data) != h.checksum) return false;
+    switch (h.op) {
+    case STATE_REC_PUT:
+    case STATE_REC_DEL:
+        if (h.type < 1 || h.type >= STATE_REC_NTYPES) return false;
+        break;
+    case STATE_REC_END:
+        break;
+    default:
+        return false;
+    }
+    pos += sizeof(h) + h.key_len + h.data_len;
+    return true;
+}
+
+struct STATE_REC {
+    int type;
+    string key;
+    const char* data;
+    int len;
+    bool deleted;
+};
+
+static void apply_state_rec(
+    vector<STATE_REC>& recs, std::map<string, int>& index,
+    STATE_REC_HEADER& h, const char* key, const char* data
+) {
+    STATE_REC r;
+    r.type = h.type;
+    r.key = string(key, h.key_len);
+    r.data = data;
+    r.len = h.data_len;
+    r.deleted = (h.op == STATE_REC_DEL);
+    string id = state_rec_id(r.type, r.key);
+    std::map<string, int>::iterator i = index.find(id);
+    if (i == index.end()) {
+        if (r.deleted) return;
+        index[id] = (int)recs.size();
+        recs.push_back(r);
+    } else {
+        recs[i->second] = r;
     }
+}
+
+// Read the binary state file (snapshot and journal).
+// Nothing is changed unless the snapshot is complete and intact.
+//
+int CLIENT_STATE::parse_state_snapshot() {
+    char *sbuf, *jbuf;
+    size_t slen, jlen, pos;
+    unsigned int gen, jgen;
+    int retval, njournal=0;
+    bool complete = false;
+    STATE_REC_HEADER h;
+    const char *key, *data;
+    vector<STATE_REC> recs;
+    std::map<string, int> index;
+    unsigned int i;
+
+    retval = read_state_bin(STATE_SNAPSHOT_NAME, STATE_SNAPSHOT_MAGIC, sbuf, slen, gen);
+    if (retval) return retval;
+    pos = sizeof(STATE_FILE_HEADER);
+    while (get_state_rec(sbuf, slen, pos, h, key, data)) {
+        if (h.op == STATE_REC_END) {
+            complete = true;
+            break;
+        }
+        apply_state_rec(recs, index, h, key, data);
+    }
+    if (!complete) {
+        msg_printf(0, MSG_INTERNAL_ERROR,
+            "State snapshot %s is damaged", STATE_SNAPSHOT_NAME
+        );
+        free(sbuf);
+        return ERR_BAD_FORMAT;
+    }
+
+    retval = read_state_bin(STATE_JOURNAL_NAME, STATE_JOURNAL_MAGIC, jbuf, jlen, jgen);
+    if (!retval) {
+        if (jgen == gen) {
+            pos = sizeof(STATE_FILE_HEADER);
+            while (pos < jlen) {
+                if (!get_state_rec(jbuf, jlen, pos, h, key, data)
+                    || h.op == STATE_REC_END
+                ) {
+                    msg_printf(0, MSG_INFO,
+                        "State journal is truncated; using %d changes",
+                        njournal
+                    );
+                    break;
+                }
+                apply_state_rec(recs, index, h, key, data);
+                njournal++;
+            }
+        } else if (log_flags.statefile_debug) {
+            msg_printf(0, MSG_INFO,
+                "[statefile] Ignoring journal of an old snapshot"
+            );
+        }
+    }
+
+    // parse the records in order of type
+    //
+    PROJECT* project;
+    name_index.active = true;
+    for (int type=1; type<STATE_REC_NTYPES; type++) {
+        for (i=0; i<recs.size(); i++) {
+            STATE_REC& r = recs[i];
+            if (r.type != type || r.deleted) continue;
+            project = NULL;
+            if (r.key.size()) {
+                string url = r.key.substr(0, r.key.find(' '));
+                project = lookup_project(url.c_str());
+            }
+            string s(r.data, r.len);
+            MIOFILE mf;
+            XML_PARSER xp(&mf);
+            mf.init_buf_read(s.c_str());
+            while (!xp.get_tag()) {
+                parse_state_item(xp, project);
+            }
+        }
+    }
+    parse_state_finish();
+    if (log_flags.statefile_debug) {
+        msg_printf(0, MSG_INFO,
+            "[statefile] Read state snapshot: %d records, %d from journal",
+            (int)recs.size(), njournal
+        );
+    }
+    free(sbuf);
+    if (jbuf) free(jbuf);
+
+    // the first write will be a new snapshot
+    //
+    state_journal.gen = gen;
+    state_journal.valid = false;
     return 0;
 }
 
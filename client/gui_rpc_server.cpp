@@ -94,12 +94,37 @@ GUI_RPC_CONN::GUI_RPC_CONN(int s) :
 }
 
 GUI_RPC_CONN::~GUI_RPC_CONN() {
+    gstate.event_loop.remove_fd(sock);
     boinc_close_socket(sock);
 }
 
+// our socket is ready; handle a request, or delete the connection
+// if the socket failed.  Note: this may delete the object
+//
+void GUI_RPC_CONN::handle_event(int, int events) {
+    if (events & EVENT_EXC) {
+        gstate.gui_rpcs.remove(this);
+        return;
+    }
+    if (events & EVENT_READ) {
+        int retval = handle_rpc();
+        if (retval) {
+            if (log_flags.gui_rpc_debug) {
+                msg_printf(NULL, MSG_INFO,
+                    "[gui_rpc] handler returned %d, closing socket\n",
+                    retval
+                );
+            }
+            gstate.gui_rpcs.remove(this);
+        }
+    }
+}
+
 GUI_RPC_CONN_SET::GUI_RPC_CONN_SET() {
     remote_hosts_file_exists = false;
     lsock = -1;
+    events_enabled = false;
+    registered_lsock = -1;
     time_of_last_rpc_needing_network = 0;
     safe_strcpy(password,"");
 }
@@ -228,9 +253,23 @@ int GUI_RPC_CONN_SET::get_allowed_hosts() {
 
 int GUI_RPC_CONN_SET::insert(GUI_RPC_CONN* p) {
     gui_rpcs.push_back(p);
+    if (events_enabled) {
+        gstate.event_loop.set_fd(p->sock, EVENT_READ|EVENT_EXC, p);
+    }
     return 0;
 }
 
+void GUI_RPC_CONN_SET::remove(GUI_RPC_CONN* p) {
+    vector<GUI_RPC_CONN*>::iterator iter;
+    for (iter = gui_rpcs.begin(); iter != gui_rpcs.end(); ++iter) {
+        if (*iter == p) {
+            gui_rpcs.erase(iter);
+            break;
+        }
+    }
+    delete p;
+}
+
 int GUI_RPC_CONN_SET::init_unix_domain() {
 #if !defined(_WIN32)
     struct sockaddr_un addr;
@@ -401,26 +440,42 @@ static void show_connect_error(sockaddr_storage& s) {
     count = 0;
 }
 
-void GUI_RPC_CONN_SET::get_fdset(FDSET_GROUP& fg, FDSET_GROUP& all) {
+// Register our sockets with the event loop, or unregister them
+// (we don't handle RPCs while an autologin is in progress).
+// Called on each pass through do_io_or_sleep();
+// does nothing unless something changed
+//
+void GUI_RPC_CONN_SET::set_events(bool enable) {
     unsigned int i;
-    GUI_RPC_CONN* gr;
 
-    if (lsock < 0) return;
-    for (i=0; i<gui_rpcs.size(); i++) {
-        gr = gui_rpcs[i];
-        int s = gr->sock;
-        FD_SET(s, &fg.read_fds);
-        FD_SET(s, &fg.exc_fds);
-        if (s > fg.max_fd) fg.max_fd = s;
-
-        FD_SET(s, &all.read_fds);
-        FD_SET(s, &all.exc_fds);
-        if (s > all.max_fd) all.max_fd = s;
-    }
-    FD_SET(lsock, &fg.read_fds);
-    if (lsock > fg.max_fd) fg.max_fd = lsock;
-    FD_SET(lsock, &all.read_fds);
-    if (lsock > all.max_fd) all.max_fd = lsock;
+    if (!enable) {
+        if (!events_enabled) return;
+        events_enabled = false;
+        if (registered_lsock >= 0) {
+            gstate.event_loop.remove_fd(registered_lsock);
+            registered_lsock = -1;
+        }
+        for (i=0; i<gui_rpcs.size(); i++) {
+            gstate.event_loop.remove_fd(gui_rpcs[i]->sock);
+        }
+        return;
+    }
+    if (!events_enabled) {
+        events_enabled = true;
+        for (i=0; i<gui_rpcs.size(); i++) {
+            GUI_RPC_CONN* gr = gui_rpcs[i];
+            gstate.event_loop.set_fd(gr->sock, EVENT_READ|EVENT_EXC, gr);
+        }
+    }
+    if (lsock != registered_lsock) {
+        if (registered_lsock >= 0) {
+            gstate.event_loop.remove_fd(registered_lsock);
+        }
+        if (lsock >= 0) {
+            gstate.event_loop.set_fd(lsock, EVENT_READ, this);
+        }
+        registered_lsock = lsock;
+    }
 }
 
 bool GUI_RPC_CONN_SET::check_allowed_list(sockaddr_storage& peer_ip) {
@@ -434,17 +489,18 @@ bool GUI_RPC_CONN_SET::check_allowed_list(sockaddr_storage& peer_ip) {
     return false;
 }
 
-void GUI_RPC_CONN_SET::got_select(FDSET_GROUP& fg) {
-    int sock, retval;
-    vector<GUI_RPC_CONN*>::iterator iter;
+// the listening socket is ready; accept a connection
+//
+void GUI_RPC_CONN_SET::handle_event(int, int events) {
+    int sock;
     GUI_RPC_CONN* gr;
 
     if (lsock < 0) return;
 
-    if (FD_ISSET(lsock, &fg.read_fds)) {
+    if (events & EVENT_READ) {
         struct sockaddr_storage addr;
 
-        // For unknown reasons, the FD_ISSET() above succeeds
+        // For unknown reasons, the listening socket becomes readable
         // after a SIGTERM, SIGHUP, SIGINT or SIGQUIT is received,
         // even if there is no data available on the socket.
         // This causes the accept() call to block, preventing the main 
@@ -508,41 +564,6 @@ void GUI_RPC_CONN_SET::got_select(FDSET_GROUP& fg) {
             insert(gr);
         }
     }
-
-    // delete connections with failed sockets
-    //
-    iter = gui_rpcs.begin();
-    while (iter != gui_rpcs.end()) {
-        gr = *iter;
-        if (FD_ISSET(gr->sock, &fg.exc_fds)) {
-            delete gr;
-            iter = gui_rpcs.erase(iter);
-            continue;
-        }
-        ++iter;
-    }
-
-    // handle RPCs on connections with pending requests
-    //
-    iter = gui_rpcs.begin();
-    while (iter != gui_rpcs.end()) {
-        gr = *iter;
-        if (FD_ISSET(gr->sock, &fg.read_fds)) {
-            retval = gr->handle_rpc();
-            if (retval) {
-                if (log_flags.gui_rpc_debug) {
-                    msg_printf(NULL, MSG_INFO,
-                        "[gui_rpc] handler returned %d, closing socket\n",
-                        retval
-                    );
-                }
-                delete gr;
-                iter = gui_rpcs.erase(iter);
-                continue;
-            }
-        }
-        ++iter;
-    }
 }
 
 // called when client is shutting down
@@ -553,6 +574,10 @@ void GUI_RPC_CONN_SET::close() {
             "[gui_rpc] closing GUI RPC listening socket %d\n", lsock
         );
     }
+    if (registered_lsock >= 0) {
+        gstate.event_loop.remove_fd(registered_lsock);
+        registered_lsock = -1;
+    }
     if (lsock >= 0) {
         boinc_close_socket(lsock);
         lsock = -1;
@@ -39,7 +39,7 @@
 
 #define GUI_RPC_REQ_MSG_SIZE    100000
 
-class GUI_RPC_CONN {
+class GUI_RPC_CONN : public EVENT_HANDLER {
 public:
     int sock;
     MIOFILE mfout;
@@ -83,6 +83,7 @@ public:
     }
     GUI_RPC_CONN(int);
     ~GUI_RPC_CONN();
+    void handle_event(int fd, int events);
     int handle_rpc();
     void handle_auth1(MIOFILE&);
     int handle_auth2(char*, MIOFILE&);
@@ -92,7 +93,7 @@ public:
 // 1) if a host-list file is found, accept only from those hosts
 // 2) if a password file file is found, ALSO demand password auth
 
-class GUI_RPC_CONN_SET {
+class GUI_RPC_CONN_SET : public EVENT_HANDLER {
     std::vector<GUI_RPC_CONN*> gui_rpcs;
     std::vector<sockaddr_storage> allowed_remote_ip_addresses;
     int get_allowed_hosts();
@@ -100,6 +101,9 @@ class GUI_RPC_CONN_SET {
     int insert(GUI_RPC_CONN*);
     bool check_allowed_list(sockaddr_storage& ip_addr);
     bool remote_hosts_file_exists;
+    bool events_enabled;
+    int registered_lsock;
+        // lsock as registered in gstate.event_loop, or -1
 public:
     int lsock;
     double time_of_last_rpc_needing_network;
@@ -107,8 +111,9 @@ public:
 
     GUI_RPC_CONN_SET();
     char password[256];
-    void get_fdset(FDSET_GROUP&, FDSET_GROUP&);
-    void got_select(FDSET_GROUP&);
+    void set_events(bool enable);
+    void handle_event(int fd, int events);
+    void remove(GUI_RPC_CONN*);
     int init_tcp(bool last_time);
     int init_unix_domain();
     void close();
@@ -777,7 +777,7 @@ bool HTTP_OP::http_op_done() {
     return (http_op_state == HTTP_STATE_DONE);
 }
 
-HTTP_OP_SET::HTTP_OP_SET() {
+HTTP_OP_SET::HTTP_OP_SET() : curl_timer(this) {
     bytes_up = 0;
     bytes_down = 0;
 }
@@ -907,17 +907,54 @@ void HTTP_OP::setup_proxy_session(bool no_proxy) {
     }
 }
 
+// libcurl callback: start, change or stop watching a socket
+//
+static int curl_socket_cb(
+    CURL*, curl_socket_t s, int what, void* userp, void*
+) {
+    HTTP_OP_SET* hos = (HTTP_OP_SET*)userp;
+    switch (what) {
+    case CURL_POLL_IN:
+        gstate.event_loop.set_fd((int)s, EVENT_READ, hos);
+        break;
+    case CURL_POLL_OUT:
+        gstate.event_loop.set_fd((int)s, EVENT_WRITE, hos);
+        break;
+    case CURL_POLL_INOUT:
+        gstate.event_loop.set_fd((int)s, EVENT_READ|EVENT_WRITE, hos);
+        break;
+    case CURL_POLL_REMOVE:
+        gstate.event_loop.remove_fd((int)s);
+        break;
+    }
+    return 0;
+}
 
-// the file descriptor sets need to be global so libcurl has access always
+// libcurl callback: call curl_multi_socket_action() after timeout_ms,
+// or never if it's -1
 //
-fd_set read_fds, write_fds, error_fds;
+static int curl_timer_cb(CURLM*, long timeout_ms, void* userp) {
+    HTTP_OP_SET* hos = (HTTP_OP_SET*)userp;
+    if (timeout_ms < 0) {
+        hos->curl_timer.when = 0;
+    } else {
+        hos->curl_timer.when = dtime() + timeout_ms/1000.;
+    }
+    return 0;
+}
 
 // call these once at the start of the program and once at the end
 //
 int curl_init() {
     curl_global_init(CURL_GLOBAL_ALL);
     g_curlMulti = curl_multi_init();
-    return (int)(g_curlMulti == NULL);
+    if (!g_curlMulti) return 1;
+    curl_multi_setopt(g_curlMulti, CURLMOPT_SOCKETFUNCTION, curl_socket_cb);
+    curl_multi_setopt(g_curlMulti, CURLMOPT_SOCKETDATA, gstate.http_ops);
+    curl_multi_setopt(g_curlMulti, CURLMOPT_TIMERFUNCTION, curl_timer_cb);
+    curl_multi_setopt(g_curlMulti, CURLMOPT_TIMERDATA, gstate.http_ops);
+    gstate.event_loop.add_timer(&gstate.http_ops->curl_timer);
+    return 0;
 }
 
 int curl_cleanup() {
@@ -962,12 +999,6 @@ void HTTP_OP::close_file() {
     }
 }
 
-void HTTP_OP_SET::get_fdset(FDSET_GROUP& fg) {
-    curl_multi_fdset(
-        g_curlMulti, &fg.read_fds, &fg.write_fds, &fg.exc_fds, &fg.max_fd
-    );
-}
-
 // we have a message for this HTTP_OP.
 // get the response code for this request
 //
@@ -1112,25 +1143,32 @@ void HTTP_OP::handle_messages(CURLMsg *pcurlMsg) {
     }
 }
 
-void HTTP_OP_SET::got_select(FDSET_GROUP&, double timeout) {
+// one of curl's sockets is ready
+//
+void HTTP_OP_SET::handle_event(int fd, int events) {
+    int mask = 0, running;
+    if (events & EVENT_READ) mask |= CURL_CSELECT_IN;
+    if (events & EVENT_WRITE) mask |= CURL_CSELECT_OUT;
+    if (events & EVENT_EXC) mask |= CURL_CSELECT_ERR;
+    curl_multi_socket_action(g_curlMulti, (curl_socket_t)fd, mask, &running);
+    check_messages();
+}
+
+// curl's timeout has expired
+//
+void HTTP_OP_SET::handle_timer(EVENT_TIMER*) {
+    int running;
+    curl_multi_socket_action(g_curlMulti, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_messages();
+}
+
+// read messages from curl that may have come in from socket actions
+//
+void HTTP_OP_SET::check_messages() {
     int iNumMsg;
     HTTP_OP* hop = NULL;
     CURLMsg *pcurlMsg = NULL;
 
-    int iRunning = 0;  // curl flags for max # of fds & # running queries
-    CURLMcode curlMErr;
-
-    // get the data waiting for transfer in or out
-    // use timeout value so that we don't hog CPU in this loop
-    //
-    while (1) {
-        curlMErr = curl_multi_perform(g_curlMulti, &iRunning);
-        if (curlMErr != CURLM_CALL_MULTI_PERFORM) break;
-        if (dtime() - gstate.now > timeout) break;
-    }
-
-    // read messages from curl that may have come in from the above loop
-    //
     while (1) {
         pcurlMsg = curl_multi_info_read(g_curlMulti, &iNumMsg);
         if (!pcurlMsg) break;
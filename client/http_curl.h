@@ -187,7 +187,11 @@ private:
 
 // represents a set of HTTP requests in progress
 
-class HTTP_OP_SET {
+// libcurl tells us (via curl_init()'s callbacks) which sockets to watch
+// and when to time out; these are registered in gstate.event_loop,
+// which calls back here to run curl_multi_socket_action().
+//
+class HTTP_OP_SET : public EVENT_HANDLER {
     std::vector<HTTP_OP*> http_ops;
 public:
     HTTP_OP_SET();
@@ -198,8 +202,11 @@ public:
     double bytes_up, bytes_down;
         // total bytes transferred
 
-    void get_fdset(FDSET_GROUP&);
-    void got_select(FDSET_GROUP&, double);
+    EVENT_TIMER curl_timer;
+        // armed by CURLMOPT_TIMERFUNCTION
+    void handle_event(int fd, int events);
+    void handle_timer(EVENT_TIMER*);
+    void check_messages();
     HTTP_OP* lookup_curl(CURL* pcurl);
         // lookup by easycurl handle
     void cleanup_temp_files();
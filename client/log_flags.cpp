@@ -82,6 +82,7 @@ void LOG_FLAGS::show() {
     show_flag(buf, sizeof(buf), cpu_sched, "cpu_sched");
     show_flag(buf, sizeof(buf), cpu_sched_debug, "cpu_sched_debug");
     show_flag(buf, sizeof(buf), cpu_sched_status, "cpu_sched_status");
+    show_flag(buf, sizeof(buf), cpu_sched_timing, "cpu_sched_timing");
     show_flag(buf, sizeof(buf), dcf_debug, "dcf_debug");
     show_flag(buf, sizeof(buf), file_xfer_debug, "file_xfer_debug");
     show_flag(buf, sizeof(buf), gui_rpc_debug, "gui_rpc_debug");
@@ -184,6 +185,9 @@ void CC_CONFIG::show() {
         }
         fclose(f);
     }
+    if (binary_state_file) {
+        msg_printf(NULL, MSG_INFO, "Config: binary state file");
+    }
     if (disallow_attach) {
         msg_printf(NULL, MSG_INFO, "Config: disallow project attach");
     }
@@ -276,6 +280,9 @@ void CC_CONFIG::show() {
     if (use_all_gpus) {
         msg_printf(NULL, MSG_INFO, "Config: use all coprocessors");
     }
+    if (use_cgroups) {
+        msg_printf(NULL, MSG_INFO, "Config: use cgroups for task control");
+    }
     if (vbox_window) {
         msg_printf(NULL, MSG_INFO,
             "Config: open console window for VirtualBox applications"
@@ -331,6 +338,7 @@ int CC_CONFIG::parse_options_client(XML_PARSER& xp) {
             alt_platforms.push_back(s);
             continue;
         }
+        if (xp.parse_bool("binary_state_file", binary_state_file)) continue;
         if (xp.match_tag("coproc")) {
             COPROC c;
             retval = c.parse(xp);
@@ -445,10 +453,12 @@ int CC_CONFIG::parse_options_client(XML_PARSER& xp) {
         if (xp.parse_bool("simple_gui_only", simple_gui_only)) continue;
         if (xp.parse_bool("skip_cpu_benchmarks", skip_cpu_benchmarks)) continue;
         if (xp.parse_double("start_delay", start_delay)) continue;
+        if (xp.parse_double("state_file_write_interval", state_file_write_interval)) continue;
         if (xp.parse_bool("stderr_head", stderr_head)) continue;
         if (xp.parse_bool("suppress_net_info", suppress_net_info)) continue;
         if (xp.parse_bool("unsigned_apps_ok", unsigned_apps_ok)) continue;
         if (xp.parse_bool("use_all_gpus", use_all_gpus)) continue;
+        if (xp.parse_bool("use_cgroups", use_cgroups)) continue;
         if (xp.parse_bool("use_certs", use_certs)) continue;
         if (xp.parse_bool("use_certs_only", use_certs_only)) continue;
         if (xp.parse_bool("vbox_window", vbox_window)) continue;
@@ -104,7 +104,6 @@ void PROJECT::init() {
     safe_strcpy(code_sign_key, "");
     user_files.clear();
     project_files.clear();
-    next_runnable_result = NULL;
     duration_correction_factor = 1;
     project_files_downloaded_time = 0;
     use_symlinks = false;
@@ -217,7 +216,7 @@ int PROJECT::parse_state(XML_PARSER& xp) {
         if (xp.parse_double("host_create_time", host_create_time)) continue;
         if (xp.match_tag("code_sign_key")) {
             retval = copy_element_contents(
-                xp.f->f,
+                *xp.f,
                 "</code_sign_key>",
                 code_sign_key,
                 sizeof(code_sign_key)
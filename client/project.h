@@ -248,8 +248,6 @@ struct PROJECT : PROJ_AM {
     int n_concurrent;
         // used to enforce APP_CONFIGS::max_concurrent
 
-    struct RESULT *next_runnable_result;
-        // the next result to run for this project
     int nuploading_results;
         // number of results in UPLOADING state
         // Don't start new results if these exceeds 2*ncpus.
@@ -33,9 +33,18 @@
 // Otherwise, there'd be the possibility of computing
 // a nonzero shortfall inappropriately.
 //
+// The simulation is done by both the job scheduler and work fetch,
+// often several times within a few seconds.
+// With large job queues it's expensive, so we keep the outputs
+// of the last simulation, together with a checksum of its inputs;
+// if the inputs haven't changed and the results are recent,
+// we restore them rather than simulating again (see RR_SIM_CACHE).
+//
 
 #include "cpp.h"
 
+#include <cstring>
+
 #ifdef _WIN32
 #include "boinc_win.h"
 #else
@@ -554,9 +563,271 @@ void RR_SIM::simulate() {
     }
 }
 
+// Results of the last simulation, and a checksum of its inputs.
+//
+// The checksum covers the list of jobs and the state of each
+// (whether it's in the simulation, its app version and resource usage,
+// and its deadline), the scheduling-related state of each project,
+// and the host-level parameters (#instances, buffer sizes, availability).
+// Projects interact via scheduling priority,
+// so if any of these change we redo the whole simulation.
+//
+// The remaining work of running jobs is not part of the checksum
+// (it changes constantly); instead we limit the age of reused results
+// to RR_SIM_REUSE_PERIOD.
+//
+#define RR_SIM_REUSE_PERIOD     10
+
+struct RR_SIM_RESULT_OUT {
+    double rrsim_flops_left;
+    double rrsim_finish_delay;
+    double rrsim_flops;
+    bool rrsim_done;
+    bool rr_sim_misses_deadline;
+    bool missed;
+        // missed deadline, whether or not it's too large to run
+};
+
+struct RR_SIM_PROJECT_OUT {
+    int n_runnable_jobs;
+    double rec_temp;
+    double sched_priority;
+    struct {
+        int n_runnable_jobs;
+        double sim_nused;
+        double nused_total;
+        double queue_est;
+        int deadlines_missed;
+    } rsc[MAX_RSC];
+};
+
+struct RR_SIM_RSC_OUT {
+    double shortfall;
+    double nidle_now;
+    double sim_nused;
+    COPROC_INSTANCE_BITMAP sim_used_instances;
+    COPROC_INSTANCE_BITMAP sim_excluded_instances;
+    double saturated_time;
+    double deadline_missed_instances;
+    vector<double> busy_time;
+};
+
+struct RR_SIM_CACHE {
+    bool valid;
+    double time;
+    unsigned long long sig;
+    vector<RR_SIM_RESULT_OUT> results;
+    vector<RR_SIM_PROJECT_OUT> projects;
+    RR_SIM_RSC_OUT rsc[MAX_RSC];
+
+    unsigned long long input_signature();
+    void save(unsigned long long);
+    void restore();
+    bool reusable(unsigned long long s) {
+        if (!valid) return false;
+        if (s != sig) return false;
+        if (gstate.now < time) return false;
+        return (gstate.now - time < RR_SIM_REUSE_PERIOD);
+    }
+    RR_SIM_CACHE() {
+        valid = false;
+        time = 0;
+        sig = 0;
+    }
+};
+
+static RR_SIM_CACHE rr_sim_cache;
+
+static inline void sig_add(unsigned long long& sig, unsigned long long x) {
+    sig ^= x + 0x9e3779b97f4a7c15ULL + (sig<<6) + (sig>>2);
+}
+
+static inline void sig_add(unsigned long long& sig, double x) {
+    unsigned long long u;
+    memcpy(&u, &x, sizeof(u));
+    sig_add(sig, u);
+}
+
+static inline void sig_add(unsigned long long& sig, const void* p) {
+    sig_add(sig, (unsigned long long)(size_t)p);
+}
+
+unsigned long long RR_SIM_CACHE::input_signature() {
+    unsigned long long s = 0;
+
+    sig_add(s, (unsigned long long)gstate.ncpus);
+    sig_add(s, (unsigned long long)coprocs.n_rsc);
+    for (int i=1; i<coprocs.n_rsc; i++) {
+        sig_add(s, (unsigned long long)coprocs.coprocs[i].count);
+    }
+    for (int i=0; i<coprocs.n_rsc; i++) {
+        sig_add(s, (unsigned long long)rsc_work_fetch[i].has_exclusions);
+        sig_add(s, rsc_work_fetch[i].relative_speed);
+    }
+    sig_add(s, gstate.work_buf_min());
+    sig_add(s, gstate.work_buf_total());
+    sig_add(s, gstate.overall_cpu_frac());
+    sig_add(s, gstate.overall_gpu_frac());
+    sig_add(s, gstate.overall_cpu_and_network_frac());
+    sig_add(s, gstate.host_info.p_fpops);
+    sig_add(s, cc_config.rec_half_life);
+
+    for (unsigned int i=0; i<gstate.projects.size(); i++) {
+        PROJECT* p = gstate.projects[i];
+        sig_add(s, p);
+        sig_add(s, p->pwf.rec);
+        sig_add(s, p->resource_share);
+        sig_add(s, (unsigned long long)(
+            (p->non_cpu_intensive?1:0) | (p->suspended_via_gui?2:0)
+        ));
+        for (int j=1; j<coprocs.n_rsc; j++) {
+            sig_add(s, (unsigned long long)p->rsc_pwf[j].ncoprocs_excluded);
+        }
+    }
+
+    for (unsigned int i=0; i<gstate.results.size(); i++) {
+        RESULT* rp = gstate.results[i];
+        sig_add(s, rp);
+        bool included = rp->nearly_runnable()
+            && !rp->some_download_stalled()
+            && !rp->project->non_cpu_intensive;
+        sig_add(s, (unsigned long long)(
+            (included?1:0) | (rp->state() << 1)
+        ));
+        if (!included) continue;
+        sig_add(s, rp->avp);
+        sig_add(s, rp->avp->flops);
+        sig_add(s, rp->avp->avg_ncpus);
+        sig_add(s, rp->avp->gpu_usage.usage);
+        sig_add(s, rp->report_deadline);
+    }
+    return s;
+}
+
+void RR_SIM_CACHE::save(unsigned long long s) {
+    results.resize(gstate.results.size());
+    for (unsigned int i=0; i<gstate.results.size(); i++) {
+        RESULT* rp = gstate.results[i];
+        RR_SIM_RESULT_OUT& r = results[i];
+        r.rrsim_flops_left = rp->rrsim_flops_left;
+        r.rrsim_finish_delay = rp->rrsim_finish_delay;
+        r.rrsim_flops = rp->rrsim_flops;
+        r.rrsim_done = rp->rrsim_done;
+        r.rr_sim_misses_deadline = rp->rr_sim_misses_deadline;
+        r.missed = false;
+        if (rp->rrsim_done) {
+            ACTIVE_TASK* atp = gstate.lookup_active_task_by_result(rp);
+            r.missed = atp && atp->last_deadline_miss_time == gstate.now;
+        }
+    }
+    projects.resize(gstate.projects.size());
+    for (unsigned int i=0; i<gstate.projects.size(); i++) {
+        PROJECT* p = gstate.projects[i];
+        RR_SIM_PROJECT_OUT& po = projects[i];
+        po.n_runnable_jobs = p->pwf.n_runnable_jobs;
+        po.rec_temp = p->pwf.rec_temp;
+        po.sched_priority = p->sched_priority;
+        for (int j=0; j<coprocs.n_rsc; j++) {
+            RSC_PROJECT_WORK_FETCH& rpwf = p->rsc_pwf[j];
+            po.rsc[j].n_runnable_jobs = rpwf.n_runnable_jobs;
+            po.rsc[j].sim_nused = rpwf.sim_nused;
+            po.rsc[j].nused_total = rpwf.nused_total;
+            po.rsc[j].queue_est = rpwf.queue_est;
+            po.rsc[j].deadlines_missed = rpwf.deadlines_missed;
+        }
+    }
+    for (int i=0; i<coprocs.n_rsc; i++) {
+        RSC_WORK_FETCH& rwf = rsc_work_fetch[i];
+        RR_SIM_RSC_OUT& ro = rsc[i];
+        ro.shortfall = rwf.shortfall;
+        ro.nidle_now = rwf.nidle_now;
+        ro.sim_nused = rwf.sim_nused;
+        ro.sim_used_instances = rwf.sim_used_instances;
+        ro.sim_excluded_instances = rwf.sim_excluded_instances;
+        ro.saturated_time = rwf.saturated_time;
+        ro.deadline_missed_instances = rwf.deadline_missed_instances;
+        ro.busy_time = rwf.busy_time_estimator.busy_time;
+    }
+    sig = s;
+    time = gstate.now;
+    valid = true;
+}
+
+// Restore the outputs of the last simulation.
+// The job and project lists are the same as then
+// (otherwise the checksum would differ).
+// Times are relative to now, so results are shifted to the present.
+//
+void RR_SIM_CACHE::restore() {
+    for (unsigned int i=0; i<gstate.results.size(); i++) {
+        RESULT* rp = gstate.results[i];
+        RR_SIM_RESULT_OUT& r = results[i];
+        rp->rrsim_flops_left = r.rrsim_flops_left;
+        rp->rrsim_finish_delay = r.rrsim_finish_delay;
+        rp->rrsim_flops = r.rrsim_flops;
+        rp->rrsim_done = r.rrsim_done;
+        rp->rr_sim_misses_deadline = r.rr_sim_misses_deadline;
+        if (r.missed) {
+            ACTIVE_TASK* atp = gstate.lookup_active_task_by_result(rp);
+            if (atp) atp->last_deadline_miss_time = gstate.now;
+        }
+    }
+    for (unsigned int i=0; i<gstate.projects.size(); i++) {
+        PROJECT* p = gstate.projects[i];
+        RR_SIM_PROJECT_OUT& po = projects[i];
+        p->pwf.n_runnable_jobs = po.n_runnable_jobs;
+        p->pwf.rec_temp = po.rec_temp;
+        p->sched_priority = po.sched_priority;
+        for (int j=0; j<coprocs.n_rsc; j++) {
+            RSC_PROJECT_WORK_FETCH& rpwf = p->rsc_pwf[j];
+            rpwf.n_runnable_jobs = po.rsc[j].n_runnable_jobs;
+            rpwf.sim_nused = po.rsc[j].sim_nused;
+            rpwf.nused_total = po.rsc[j].nused_total;
+            rpwf.queue_est = po.rsc[j].queue_est;
+            rpwf.deadlines_missed = po.rsc[j].deadlines_missed;
+        }
+    }
+    for (int i=0; i<coprocs.n_rsc; i++) {
+        RSC_WORK_FETCH& rwf = rsc_work_fetch[i];
+        RR_SIM_RSC_OUT& ro = rsc[i];
+        rwf.shortfall = ro.shortfall;
+        rwf.nidle_now = ro.nidle_now;
+        rwf.sim_nused = ro.sim_nused;
+        rwf.sim_used_instances = ro.sim_used_instances;
+        rwf.sim_excluded_instances = ro.sim_excluded_instances;
+        rwf.saturated_time = ro.saturated_time;
+        if (rwf.saturated_time) {
+            rwf.saturated_time -= gstate.now - time;
+            if (rwf.saturated_time < 0) rwf.saturated_time = 0;
+        }
+        rwf.deadline_missed_instances = ro.deadline_missed_instances;
+        rwf.busy_time_estimator.busy_time = ro.busy_time;
+    }
+}
+
+// discard saved results, e.g. because of a change
+// not covered by the input checksum
+//
+void rr_sim_invalidate() {
+    rr_sim_cache.valid = false;
+}
+
 void rr_simulation() {
+    unsigned long long sig = rr_sim_cache.input_signature();
+    if (rr_sim_cache.reusable(sig)) {
+        if (log_flags.rr_simulation) {
+            msg_printf(0, MSG_INFO,
+                "[rr_sim] inputs unchanged; using results from %.2f sec ago",
+                gstate.now - rr_sim_cache.time
+            );
+        }
+        work_fetch.rr_init();
+        rr_sim_cache.restore();
+        return;
+    }
     RR_SIM rr_sim;
     rr_sim.simulate();
+    rr_sim_cache.save(sig);
 }
 
 // Compute the number of idle instances of each resource
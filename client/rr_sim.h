@@ -19,6 +19,7 @@
 #define BOINC_RR_SIM_H
 
 extern void rr_simulation();
+extern void rr_sim_invalidate();
 extern void print_deadline_misses();
 extern void get_nidle();
 extern bool any_resource_idle();
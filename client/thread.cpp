@@ -63,3 +63,27 @@ void THREAD_LOCK::unlock() {
     pthread_mutex_unlock(&mutex);
 #endif
 }
+
+THREAD_COND::THREAD_COND() {
+#ifdef _WIN32
+    InitializeConditionVariable(&cond);
+#else
+    pthread_cond_init(&cond, NULL);
+#endif
+}
+
+void THREAD_COND::wait(THREAD_LOCK& tl) {
+#ifdef _WIN32
+    SleepConditionVariableCS(&cond, &tl.mutex, INFINITE);
+#else
+    pthread_cond_wait(&cond, &tl.mutex);
+#endif
+}
+
+void THREAD_COND::signal() {
+#ifdef _WIN32
+    WakeConditionVariable(&cond);
+#else
+    pthread_cond_signal(&cond);
+#endif
+}
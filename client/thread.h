@@ -46,4 +46,18 @@ struct THREAD_LOCK {
     THREAD_LOCK();
 };
 
+// condition variable; wait() must be called with the lock held
+//
+struct THREAD_COND {
+#ifdef _WIN32
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+    void wait(THREAD_LOCK&);
+    void signal();
+
+    THREAD_COND();
+};
+
 #endif
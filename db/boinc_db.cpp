@@ -645,6 +645,57 @@ void DB_HOST::db_parse(MYSQL_ROW &r) {
     gpu_active_frac = atof(r[i++]);
 }
 
+void DB_HOST::db_parse_stmt(DB_STMT& s) {
+    int i=0;
+    clear();
+    id = s.get_int(i++);
+    create_time = s.get_int(i++);
+    userid = s.get_int(i++);
+    rpc_seqno = s.get_int(i++);
+    rpc_time = s.get_int(i++);
+    total_credit = s.get_double(i++);
+    expavg_credit = s.get_double(i++);
+    expavg_time = s.get_double(i++);
+    timezone = s.get_int(i++);
+    s.get_str(i++, domain_name, sizeof(domain_name));
+    s.get_str(i++, serialnum, sizeof(serialnum));
+    s.get_str(i++, last_ip_addr, sizeof(last_ip_addr));
+    nsame_ip_addr = s.get_int(i++);
+    on_frac = s.get_double(i++);
+    connected_frac = s.get_double(i++);
+    active_frac = s.get_double(i++);
+    cpu_efficiency = s.get_double(i++);
+    duration_correction_factor = s.get_double(i++);
+    p_ncpus = s.get_int(i++);
+    s.get_str(i++, p_vendor, sizeof(p_vendor));
+    s.get_str(i++, p_model, sizeof(p_model));
+    p_fpops = s.get_double(i++);
+    p_iops = s.get_double(i++);
+    p_membw = s.get_double(i++);
+    s.get_str(i++, os_name, sizeof(os_name));
+    s.get_str(i++, os_version, sizeof(os_version));
+    m_nbytes = s.get_double(i++);
+    m_cache = s.get_double(i++);
+    m_swap = s.get_double(i++);
+    d_total = s.get_double(i++);
+    d_free = s.get_double(i++);
+    d_boinc_used_total = s.get_double(i++);
+    d_boinc_used_project = s.get_double(i++);
+    d_boinc_max = s.get_double(i++);
+    n_bwup = s.get_double(i++);
+    n_bwdown = s.get_double(i++);
+    credit_per_cpu_sec = s.get_double(i++);
+    s.get_str(i++, venue, sizeof(venue));
+    nresults_today = s.get_int(i++);
+    avg_turnaround = s.get_double(i++);
+    s.get_str(i++, host_cpid, sizeof(host_cpid));
+    s.get_str(i++, external_ip_addr, sizeof(external_ip_addr));
+    _max_results_day = s.get_int(i++);
+    _error_rate = s.get_double(i++);
+    s.get_str(i++, product_name, sizeof(product_name));
+    gpu_active_frac = s.get_double(i++);
+}
+
 int DB_HOST::update_diff_validator(HOST& h) {
     char buf[BLOB_SIZE], updates[BLOB_SIZE], query[BLOB_SIZE];
     strcpy(updates, "");
@@ -1067,6 +1118,51 @@ void DB_WORKUNIT::db_parse(MYSQL_ROW &r) {
     app_version_num = atoi(r[i++]);
 }
 
+// parse workunit columns of a prepared statement, starting at column i
+//
+static void parse_workunit_stmt(WORKUNIT& wu, DB_STMT& s, int i) {
+    wu.id = s.get_int(i++);
+    wu.create_time = s.get_int(i++);
+    wu.appid = s.get_int(i++);
+    s.get_str(i++, wu.name, sizeof(wu.name));
+    s.get_str(i++, wu.xml_doc, sizeof(wu.xml_doc));
+    wu.batch = s.get_int(i++);
+    wu.rsc_fpops_est = s.get_double(i++);
+    wu.rsc_fpops_bound = s.get_double(i++);
+    wu.rsc_memory_bound = s.get_double(i++);
+    wu.rsc_disk_bound = s.get_double(i++);
+    wu.need_validate = s.get_int(i++);
+    wu.canonical_resultid = s.get_int(i++);
+    wu.canonical_credit = s.get_double(i++);
+    wu.transition_time = s.get_int(i++);
+    wu.delay_bound = s.get_int(i++);
+    wu.error_mask = s.get_int(i++);
+    wu.file_delete_state = s.get_int(i++);
+    wu.assimilate_state = s.get_int(i++);
+    wu.hr_class = s.get_int(i++);
+    wu.opaque = s.get_double(i++);
+    wu.min_quorum = s.get_int(i++);
+    wu.target_nresults = s.get_int(i++);
+    wu.max_error_results = s.get_int(i++);
+    wu.max_total_results = s.get_int(i++);
+    wu.max_success_results = s.get_int(i++);
+    s.get_str(i++, wu.result_template_file, sizeof(wu.result_template_file));
+    wu.priority = s.get_int(i++);
+    s.get_str(i++, wu.mod_time, sizeof(wu.mod_time));
+    wu.rsc_bandwidth_bound = s.get_double(i++);
+    wu.fileset_id = s.get_int(i++);
+    wu.app_version_id = s.get_int(i++);
+    wu.transitioner_flags = s.get_int(i++);
+    wu.size_class = s.get_int(i++);
+    s.get_str(i++, wu.keywords, sizeof(wu.keywords));
+    wu.app_version_num = s.get_int(i++);
+}
+
+void DB_WORKUNIT::db_parse_stmt(DB_STMT& s) {
+    clear();
+    parse_workunit_stmt(*this, s, 0);
+}
+
 void DB_CREDITED_JOB::db_print(char* buf){
     sprintf(buf,
         "userid=%lu, workunitid=%lu",
@@ -1151,6 +1247,77 @@ void DB_RESULT::db_print_values(char* buf){
     UNESCAPE(stderr_out);
 }
 
+// update an entire record.
+// The scheduler and transitioner do this a lot,
+// so use a prepared statement if requested
+//
+int DB_RESULT::update() {
+    int retval;
+
+    if (db->use_prepared) {
+        DB_STMT* s = db->get_stmt(
+            "update result set create_time=?, workunitid=?, "
+            "server_state=?, outcome=?, client_state=?, "
+            "hostid=?, userid=?, "
+            "report_deadline=?, sent_time=?, received_time=?, "
+            "name=?, cpu_time=?, "
+            "xml_doc_in=?, xml_doc_out=?, stderr_out=?, "
+            "batch=?, file_delete_state=?, validate_state=?, "
+            "claimed_credit=?, granted_credit=?, opaque=?, random=?, "
+            "app_version_num=?, appid=?, exit_status=?, teamid=?, "
+            "priority=?, elapsed_time=?, flops_estimate=?, "
+            "app_version_id=?, runtime_outlier=?, size_class=?, "
+            "peak_working_set_size=?, peak_swap_size=?, peak_disk_usage=? "
+            "where id=?"
+        );
+        if (s) {
+            s->param_int(create_time);
+            s->param_int(workunitid);
+            s->param_int(server_state);
+            s->param_int(outcome);
+            s->param_int(client_state);
+            s->param_int(hostid);
+            s->param_int(userid);
+            s->param_int(report_deadline);
+            s->param_int(sent_time);
+            s->param_int(received_time);
+            s->param_str(name);
+            s->param_double(cpu_time);
+            s->param_str(xml_doc_in);
+            s->param_str(xml_doc_out);
+            s->param_str(stderr_out);
+            s->param_int(batch);
+            s->param_int(file_delete_state);
+            s->param_int(validate_state);
+            s->param_double(claimed_credit);
+            s->param_double(granted_credit);
+            s->param_double(opaque);
+            s->param_int(random);
+            s->param_int(app_version_num);
+            s->param_int(appid);
+            s->param_int(exit_status);
+            s->param_int(teamid);
+            s->param_int(priority);
+            s->param_double(elapsed_time);
+            s->param_double(flops_estimate);
+            s->param_int(app_version_id);
+            s->param_int(runtime_outlier?1:0);
+            s->param_int(size_class);
+            s->param_double(peak_working_set_size);
+            s->param_double(peak_swap_size);
+            s->param_double(peak_disk_usage);
+            s->param_int(id);
+            retval = s->execute();
+            if (!retval) {
+                if (s->affected_rows() != 1) return ERR_DB_NOT_FOUND;
+                return 0;
+            }
+            db->drop_stmt(s);
+        }
+    }
+    return DB_BASE::update();
+}
+
 // called from scheduler when dispatch this result.
 // The "... and server_state=%d" is a safeguard against
 // the case where another scheduler tries to send this result at the same time
@@ -1159,6 +1326,29 @@ int DB_RESULT::mark_as_sent(int old_server_state, int report_grace_period) {
     char query[MAX_QUERY_LEN];
     int retval;
 
+    if (db->use_prepared) {
+        DB_STMT* s = db->get_stmt(
+            "update result set server_state=?, hostid=?, userid=?, sent_time=?, report_deadline=?, flops_estimate=?, app_version_id=? where id=? and server_state=?"
+        );
+        if (s) {
+            s->param_int(server_state);
+            s->param_int(hostid);
+            s->param_int(userid);
+            s->param_int(sent_time);
+            s->param_int(report_deadline + report_grace_period);
+            s->param_double(flops_estimate);
+            s->param_int(app_version_id);
+            s->param_int(id);
+            s->param_int(old_server_state);
+            retval = s->execute();
+            if (!retval) {
+                if (s->affected_rows() != 1) return ERR_DB_NOT_FOUND;
+                return 0;
+            }
+            db->drop_stmt(s);
+        }
+    }
+
     sprintf(query,
         "update result set server_state=%d, hostid=%lu, userid=%lu, sent_time=%d, report_deadline=%d, flops_estimate=%.15e, app_version_id=%ld  where id=%lu and server_state=%d",
         server_state,
@@ -1219,6 +1409,48 @@ void DB_RESULT::db_parse(MYSQL_ROW &r) {
     peak_disk_usage = atof(r[i++]);
 }
 
+void DB_RESULT::db_parse_stmt(DB_STMT& s) {
+    int i=0;
+    clear();
+    id = s.get_int(i++);
+    create_time = s.get_int(i++);
+    workunitid = s.get_int(i++);
+    server_state = s.get_int(i++);
+    outcome = s.get_int(i++);
+    client_state = s.get_int(i++);
+    hostid = s.get_int(i++);
+    userid = s.get_int(i++);
+    report_deadline = s.get_int(i++);
+    sent_time = s.get_int(i++);
+    received_time = s.get_int(i++);
+    s.get_str(i++, name, sizeof(name));
+    cpu_time = s.get_double(i++);
+    s.get_str(i++, xml_doc_in, sizeof(xml_doc_in));
+    s.get_str(i++, xml_doc_out, sizeof(xml_doc_out));
+    s.get_str(i++, stderr_out, sizeof(stderr_out));
+    batch = s.get_int(i++);
+    file_delete_state = s.get_int(i++);
+    validate_state = s.get_int(i++);
+    claimed_credit = s.get_double(i++);
+    granted_credit = s.get_double(i++);
+    opaque = s.get_double(i++);
+    random = s.get_int(i++);
+    app_version_num = s.get_int(i++);
+    appid = s.get_int(i++);
+    exit_status = s.get_int(i++);
+    teamid = s.get_int(i++);
+    priority = s.get_int(i++);
+    s.get_str(i++, mod_time, sizeof(mod_time));
+    elapsed_time = s.get_double(i++);
+    flops_estimate = s.get_double(i++);
+    app_version_id = s.get_int(i++);
+    runtime_outlier = (s.get_int(i++) != 0);
+    size_class = s.get_int(i++);
+    peak_working_set_size = s.get_double(i++);
+    peak_swap_size = s.get_double(i++);
+    peak_disk_usage = s.get_double(i++);
+}
+
 // faster version.
 // return unsent count up to a max of "count_max"
 //
@@ -2084,6 +2316,16 @@ void WORK_ITEM::parse(MYSQL_ROW& r) {
     wu.app_version_num = atoi(r[i++]);
 }
 
+void WORK_ITEM::parse_stmt(DB_STMT& s) {
+    int i=0;
+    memset(this, 0, sizeof(WORK_ITEM));
+    res_id = s.get_int(i++);
+    res_priority = s.get_int(i++);
+    res_server_state = s.get_int(i++);
+    res_report_deadline = s.get_double(i++);
+    parse_workunit_stmt(wu, s, i);
+}
+
 int DB_WORK_ITEM::enumerate(
     int limit, const char* select_clause, const char* order_clause
 ) {
@@ -2109,12 +2351,41 @@ int DB_WORK_ITEM::enumerate(
             order_clause,
             limit
         );
-        retval = db->do_query(query);
-        if (retval) return mysql_errno(db->mysql);
-        cursor.rp = mysql_store_result(db->mysql);
-        if (!cursor.rp) return mysql_errno(db->mysql);
+
+        // the feeder repeats the same few queries,
+        // so prepare them if requested
+        //
+        cursor.stmt = NULL;
+        if (db->use_prepared) {
+            cursor.stmt = db->get_stmt(query);
+            if (cursor.stmt && cursor.stmt->execute()) {
+                db->drop_stmt(cursor.stmt);
+                cursor.stmt = NULL;
+            }
+        }
+        if (!cursor.stmt) {
+            retval = db->do_query(query);
+            if (retval) return mysql_errno(db->mysql);
+            cursor.rp = mysql_store_result(db->mysql);
+            if (!cursor.rp) return mysql_errno(db->mysql);
+        }
         cursor.active = true;
     }
+    if (cursor.stmt) {
+        retval = cursor.stmt->fetch();
+        if (retval) {
+            cursor.stmt->free_result();
+            cursor.active = false;
+            if (retval != ERR_DB_NOT_FOUND) {
+                db->drop_stmt(cursor.stmt);
+                retval = ERR_DB_CONN_LOST;
+            }
+            cursor.stmt = NULL;
+            return retval;
+        }
+        parse_stmt(*cursor.stmt);
+        return 0;
+    }
     row = mysql_fetch_row(cursor.rp);
     if (!row) {
         mysql_free_result(cursor.rp);
@@ -2334,6 +2605,41 @@ int DB_SCHED_RESULT_ITEM_SET::update_result(SCHED_RESULT_ITEM& ri) {
     char query[MAX_QUERY_LEN];
     int retval;
 
+    if (db->use_prepared) {
+        DB_STMT* s = db->get_stmt(
+            "UPDATE result SET hostid=?, received_time=?, client_state=?, "
+            "cpu_time=?, exit_status=?, app_version_num=?, server_state=?, "
+            "outcome=?, stderr_out=?, xml_doc_out=?, validate_state=?, "
+            "teamid=?, elapsed_time=?, peak_working_set_size=?, "
+            "peak_swap_size=?, peak_disk_usage=? WHERE id=?"
+        );
+        if (s) {
+            s->param_int(ri.hostid);
+            s->param_int(ri.received_time);
+            s->param_int(ri.client_state);
+            s->param_double(ri.cpu_time);
+            s->param_int(ri.exit_status);
+            s->param_int(ri.app_version_num);
+            s->param_int(ri.server_state);
+            s->param_int(ri.outcome);
+            s->param_str(ri.stderr_out);
+            s->param_str(ri.xml_doc_out);
+            s->param_int(ri.validate_state);
+            s->param_int(ri.teamid);
+            s->param_double(ri.elapsed_time);
+            s->param_double(ri.peak_working_set_size);
+            s->param_double(ri.peak_swap_size);
+            s->param_double(ri.peak_disk_usage);
+            s->param_int(ri.id);
+            retval = s->execute();
+            if (!retval) {
+                if (s->affected_rows() != 1) return ERR_DB_NOT_FOUND;
+                return 0;
+            }
+            db->drop_stmt(s);
+        }
+    }
+
     ESCAPE(ri.xml_doc_out);
     ESCAPE(ri.stderr_out);
     sprintf(query,
@@ -2381,6 +2687,110 @@ int DB_SCHED_RESULT_ITEM_SET::update_result(SCHED_RESULT_ITEM& ri) {
     return retval;
 }
 
+// the columns set by update_result(), in the order used below
+//
+static const char* sched_result_item_columns[] = {
+    "hostid", "received_time", "client_state", "cpu_time", "exit_status",
+    "app_version_num", "server_state", "outcome", "stderr_out",
+    "xml_doc_out", "validate_state", "teamid", "elapsed_time",
+    "peak_working_set_size", "peak_swap_size", "peak_disk_usage"
+};
+#define NSCHED_RESULT_ITEM_COLUMNS \
+    (int)(sizeof(sched_result_item_columns)/sizeof(char*))
+
+// max length of a query generated by update_results().
+// A query always includes at least one result.
+//
+#define UPDATE_RESULTS_MAX_QUERY_LEN    (4*MAX_QUERY_LEN)
+
+// Do the work of update_result() for many results at once, with queries
+// "UPDATE result SET col=CASE id WHEN id1 THEN val1 ... END, ...
+// WHERE id in (id1, ...)".
+// If a query fails, or it matches fewer rows than it has results
+// (e.g. a result was deleted after we looked it up),
+// fall back to update_result() for its results,
+// so that each result gets its own error code.
+//
+int DB_SCHED_RESULT_ITEM_SET::update_results(std::vector<int>& retvals) {
+    std::vector<std::string> cols(NSCHED_RESULT_ITEM_COLUMNS);
+    std::string ids, query;
+    std::vector<unsigned int> batch;
+    char buf[256];
+    unsigned int i, j;
+    int k, retval;
+    size_t len = 0;
+
+    retvals.assign(results.size(), 0);
+    for (i=0; i<=results.size(); i++) {
+        if (i < results.size()) {
+            SCHED_RESULT_ITEM& ri = results[i];
+            if (ri.id == 0) continue;
+
+            // add this result's values to each column's CASE expression
+            //
+            ESCAPE(ri.xml_doc_out);
+            ESCAPE(ri.stderr_out);
+            sprintf(buf, " WHEN %lu THEN ", ri.id);
+            for (k=0; k<NSCHED_RESULT_ITEM_COLUMNS; k++) {
+                cols[k] += buf;
+            }
+            sprintf(buf, "%lu", ri.hostid); cols[0] += buf;
+            sprintf(buf, "%d", ri.received_time); cols[1] += buf;
+            sprintf(buf, "%d", ri.client_state); cols[2] += buf;
+            sprintf(buf, "%.15e", ri.cpu_time); cols[3] += buf;
+            sprintf(buf, "%d", ri.exit_status); cols[4] += buf;
+            sprintf(buf, "%d", ri.app_version_num); cols[5] += buf;
+            sprintf(buf, "%d", ri.server_state); cols[6] += buf;
+            sprintf(buf, "%d", ri.outcome); cols[7] += buf;
+            cols[8] += "'"; cols[8] += ri.stderr_out; cols[8] += "'";
+            cols[9] += "'"; cols[9] += ri.xml_doc_out; cols[9] += "'";
+            sprintf(buf, "%d", ri.validate_state); cols[10] += buf;
+            sprintf(buf, "%lu", ri.teamid); cols[11] += buf;
+            sprintf(buf, "%.15e", ri.elapsed_time); cols[12] += buf;
+            sprintf(buf, "%.0f", ri.peak_working_set_size); cols[13] += buf;
+            sprintf(buf, "%.0f", ri.peak_swap_size); cols[14] += buf;
+            sprintf(buf, "%.0f", ri.peak_disk_usage); cols[15] += buf;
+            UNESCAPE(ri.xml_doc_out);
+            UNESCAPE(ri.stderr_out);
+
+            sprintf(buf, "%s%lu", ids.empty()?"":",", ri.id);
+            ids += buf;
+            batch.push_back(i);
+            len = ids.size();
+            for (k=0; k<NSCHED_RESULT_ITEM_COLUMNS; k++) {
+                len += cols[k].size();
+            }
+            if (len < UPDATE_RESULTS_MAX_QUERY_LEN) continue;
+        }
+        if (batch.empty()) continue;
+
+        // flush the batch
+        //
+        query = "UPDATE result SET ";
+        for (k=0; k<NSCHED_RESULT_ITEM_COLUMNS; k++) {
+            if (k) query += ", ";
+            query += sched_result_item_columns[k];
+            query += "=CASE id";
+            query += cols[k];
+            query += " END";
+            cols[k].clear();
+        }
+        query += " WHERE id in (" + ids + ")";
+        ids.clear();
+
+        // CLIENT_FOUND_ROWS is set, so affected_rows() is the # matched
+        //
+        retval = db->do_query(query.c_str());
+        if (retval || db->affected_rows() != (int)batch.size()) {
+            for (j=0; j<batch.size(); j++) {
+                retvals[batch[j]] = update_result(results[batch[j]]);
+            }
+        }
+        batch.clear();
+    }
+    return 0;
+}
+
 // set transition times of workunits -
 // but only those corresponding to updated results
 // (i.e. those that passed "sanity checks")
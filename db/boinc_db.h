@@ -188,6 +188,7 @@ public:
     int fpops_stddev(double& stddev);
     void db_print(char*);
     void db_parse(MYSQL_ROW &row);
+    void db_parse_stmt(DB_STMT&);
     void operator=(HOST& r) {HOST::operator=(r);}
 };
 
@@ -205,9 +206,12 @@ public:
     DB_RESULT(DB_CONN* p=0);
     DB_ID_TYPE get_id();
     int mark_as_sent(int old_server_state, int report_grace_period);
+    int update();
+        // uses a prepared statement if db->use_prepared
     void db_print(char*);
     void db_print_values(char*);
     void db_parse(MYSQL_ROW &row);
+    void db_parse_stmt(DB_STMT&);
     void operator=(RESULT& r) {RESULT::operator=(r);}
     int get_unsent_counts(APP&, int* unsent, int count_max);
     int make_unsent(
@@ -222,6 +226,7 @@ public:
     void db_print(char*);
     void db_print_values(char*);
     void db_parse(MYSQL_ROW &row);
+    void db_parse_stmt(DB_STMT&);
     void operator=(WORKUNIT& w) {WORKUNIT::operator=(w);}
 };
 
@@ -309,6 +314,7 @@ struct WORK_ITEM {
     double res_report_deadline;
     WORKUNIT wu;
     void parse(MYSQL_ROW& row);
+    void parse_stmt(DB_STMT&);
 };
 
 class DB_WORK_ITEM : public WORK_ITEM, public DB_BASE_SPECIAL {
@@ -400,6 +406,10 @@ public:
     int lookup_result(char* result_name, SCHED_RESULT_ITEM** result);
 
     int update_result(SCHED_RESULT_ITEM& result);
+    int update_results(std::vector<int>& retvals);
+        // update all results with nonzero ID,
+        // using a few multi-row queries instead of one per result.
+        // retvals[i] is the outcome for results[i]
     int update_workunits();
 };
 
@@ -19,6 +19,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <ctime>
 #include <mysql.h>
 
 #include "error_numbers.h"
@@ -35,11 +36,16 @@ bool g_print_queries = false;
 
 DB_CONN::DB_CONN() {
     mysql = 0;
+    use_prepared = false;
 }
 
 int DB_CONN::open(
     char* db_name, char* db_host, char* db_user, char* dbpassword
 ) {
+    // statements prepared on a previous connection can't be used
+    //
+    free_stmts();
+
     mysql = mysql_init(0);
     if (!mysql) return ERR_DB_CANT_INIT;
 
@@ -98,9 +104,307 @@ int DB_CONN::open(
 }
 
 void DB_CONN::close() {
+    free_stmts();
     if (mysql) mysql_close(mysql);
 }
 
+////////// PREPARED STATEMENTS //////////
+
+#define MAX_STMTS           100
+    // max # of prepared statements per connection
+#define MAX_STMT_COLUMN     262144
+    // initial buffer size limit for a string column;
+    // the largest DB struct fields (e.g. APP_VERSION::xml_doc) are this long.
+    // Longer values are fetched in full by fetch()
+#define STMT_RETRY_PERIOD   600
+    // if a query couldn't be prepared, try again after this long
+
+DB_STMT::DB_STMT() {
+    stmt = NULL;
+    nparams = 0;
+}
+
+DB_STMT::~DB_STMT() {
+    if (stmt) mysql_stmt_close(stmt);
+}
+
+int DB_STMT::prepare(MYSQL* mysql, const char* query) {
+    stmt = mysql_stmt_init(mysql);
+    if (!stmt) return ERR_DB_CANT_INIT;
+    if (mysql_stmt_prepare(stmt, query, strlen(query))) {
+        return mysql_stmt_errno(stmt);
+    }
+
+    // parameters are bound in execute(); allocate their buffers now
+    // so that param_*() don't reallocate
+    //
+    int n = mysql_stmt_param_count(stmt);
+    params.resize(n);
+    param_vals.resize(n);
+    param_lengths.resize(n);
+    if (n) {
+        memset(&params[0], 0, n*sizeof(MYSQL_BIND));
+    }
+
+    // updates have no result columns
+    //
+    MYSQL_RES* md = mysql_stmt_result_metadata(stmt);
+    if (!md) return 0;
+    int ncols = mysql_num_fields(md);
+    MYSQL_FIELD* fields = mysql_fetch_fields(md);
+
+    bind.resize(ncols);
+    vals.resize(ncols);
+    bufs.resize(ncols);
+    lengths.resize(ncols);
+    nulls.resize(ncols);
+    row.resize(ncols);
+    memset(&bind[0], 0, ncols*sizeof(MYSQL_BIND));
+    for (int i=0; i<ncols; i++) {
+        MYSQL_BIND& b = bind[i];
+        b.length = &lengths[i];
+        b.is_null = &nulls[i];
+        switch (fields[i].type) {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_LONGLONG:
+            b.buffer_type = MYSQL_TYPE_LONGLONG;
+            b.buffer = &vals[i].i;
+            b.is_unsigned = (fields[i].flags & UNSIGNED_FLAG) != 0;
+            bufs[i].resize(32);     // for get_row()
+            break;
+        case MYSQL_TYPE_FLOAT:
+        case MYSQL_TYPE_DOUBLE:
+            b.buffer_type = MYSQL_TYPE_DOUBLE;
+            b.buffer = &vals[i].d;
+            bufs[i].resize(32);
+            break;
+        default: {
+            unsigned long len = fields[i].length;
+            if (len < 64) len = 64;
+            if (len > MAX_STMT_COLUMN) len = MAX_STMT_COLUMN;
+            bufs[i].resize(len+1);
+            b.buffer_type = MYSQL_TYPE_STRING;
+            b.buffer = &bufs[i][0];
+            b.buffer_length = len;
+            }
+        }
+    }
+    mysql_free_result(md);
+    if (mysql_stmt_bind_result(stmt, &bind[0])) {
+        return mysql_stmt_errno(stmt);
+    }
+    return 0;
+}
+
+void DB_STMT::param_int(long long x) {
+    if (nparams >= params.size()) return;
+    param_vals[nparams].i = x;
+    params[nparams].buffer_type = MYSQL_TYPE_LONGLONG;
+    params[nparams].buffer = &param_vals[nparams].i;
+    nparams++;
+}
+
+void DB_STMT::param_double(double x) {
+    if (nparams >= params.size()) return;
+    param_vals[nparams].d = x;
+    params[nparams].buffer_type = MYSQL_TYPE_DOUBLE;
+    params[nparams].buffer = &param_vals[nparams].d;
+    nparams++;
+}
+
+void DB_STMT::param_str(const char* p) {
+    if (nparams >= params.size()) return;
+    param_lengths[nparams] = strlen(p);
+    params[nparams].buffer_type = MYSQL_TYPE_STRING;
+    params[nparams].buffer = (void*)p;
+    params[nparams].buffer_length = param_lengths[nparams];
+    params[nparams].length = &param_lengths[nparams];
+    nparams++;
+}
+
+int DB_STMT::execute() {
+    unsigned int n = nparams;
+    nparams = 0;
+    if (params.size()) {
+        if (n != params.size()) return ERR_INVALID_PARAM;
+        if (mysql_stmt_bind_param(stmt, &params[0])) {
+            return mysql_stmt_errno(stmt);
+        }
+    }
+    if (mysql_stmt_execute(stmt)) {
+        return mysql_stmt_errno(stmt);
+    }
+    if (bind.size() && mysql_stmt_store_result(stmt)) {
+        return mysql_stmt_errno(stmt);
+    }
+    return 0;
+}
+
+int DB_STMT::affected_rows() {
+    return (int)mysql_stmt_affected_rows(stmt);
+}
+
+int DB_STMT::fetch() {
+    int retval = mysql_stmt_fetch(stmt);
+    if (retval == MYSQL_NO_DATA) return ERR_DB_NOT_FOUND;
+    if (retval && retval != MYSQL_DATA_TRUNCATED) {
+        return mysql_stmt_errno(stmt);
+    }
+    bool rebind = false;
+    retval = 0;
+    for (unsigned int i=0; i<bind.size(); i++) {
+        if (nulls[i] || bind[i].buffer_type != MYSQL_TYPE_STRING) continue;
+        unsigned long n = lengths[i];
+        if (n > bind[i].buffer_length) {
+            // the value didn't fit; grow the buffer and get all of it
+            //
+            bufs[i].resize(n+1);
+            bind[i].buffer = &bufs[i][0];
+            bind[i].buffer_length = n;
+            rebind = true;
+            if (mysql_stmt_fetch_column(stmt, &bind[i], i, 0)) {
+                retval = mysql_stmt_errno(stmt);
+                break;
+            }
+        }
+        bufs[i][n] = 0;
+    }
+
+    // the statement still points at the old buffers; bind the new ones
+    //
+    if (rebind && mysql_stmt_bind_result(stmt, &bind[0])) {
+        if (!retval) retval = mysql_stmt_errno(stmt);
+    }
+    return retval;
+}
+
+void DB_STMT::free_result() {
+    mysql_stmt_free_result(stmt);
+}
+
+long long DB_STMT::get_int(int col) {
+    if (nulls[col]) return 0;
+    switch (bind[col].buffer_type) {
+    case MYSQL_TYPE_LONGLONG: return vals[col].i;
+    case MYSQL_TYPE_DOUBLE: return (long long)vals[col].d;
+    default: return atoll(&bufs[col][0]);
+    }
+}
+
+double DB_STMT::get_double(int col) {
+    if (nulls[col]) return 0;
+    switch (bind[col].buffer_type) {
+    case MYSQL_TYPE_LONGLONG: return (double)vals[col].i;
+    case MYSQL_TYPE_DOUBLE: return vals[col].d;
+    default: return atof(&bufs[col][0]);
+    }
+}
+
+void DB_STMT::get_str(int col, char* p, int len) {
+    char* q = col_str(col);
+    strlcpy(p, q?q:"", len);
+}
+
+// the value of a column as a string (NULL if null)
+//
+char* DB_STMT::col_str(int col) {
+    if (nulls[col]) return NULL;
+    char* p = &bufs[col][0];
+    int len = (int)bufs[col].size();
+    switch (bind[col].buffer_type) {
+    case MYSQL_TYPE_LONGLONG:
+        if (bind[col].is_unsigned) {
+            snprintf(p, len, "%llu", (unsigned long long)vals[col].i);
+        } else {
+            snprintf(p, len, "%lld", vals[col].i);
+        }
+        break;
+    case MYSQL_TYPE_DOUBLE:
+        snprintf(p, len, "%.17g", vals[col].d);
+        break;
+    default:
+        break;
+    }
+    return p;
+}
+
+// convert the row to strings, for code that uses db_parse()
+//
+void DB_STMT::get_row(MYSQL_ROW& r) {
+    for (unsigned int i=0; i<bind.size(); i++) {
+        row[i] = col_str(i);
+    }
+    r = &row[0];
+}
+
+// return a prepared statement for the query, or NULL
+// if we can't prepare it (in which case do a regular query)
+//
+DB_STMT* DB_CONN::get_stmt(const char* query) {
+    std::map<std::string, DB_STMT*>::iterator i = stmts.find(query);
+    if (i != stmts.end()) return i->second;
+    if (stmts.size() >= MAX_STMTS) return NULL;
+    std::map<std::string, double>::iterator j = stmt_fail_time.find(query);
+    if (j != stmt_fail_time.end()) {
+        if (time(0) < j->second + STMT_RETRY_PERIOD) return NULL;
+        stmt_fail_time.erase(j);
+    }
+
+    if (g_print_queries) {
+#ifdef _USING_FCGI_
+        log_messages.printf(MSG_NORMAL, "prepare: %s\n", query);
+#else
+        fprintf(stderr, "prepare: %s\n", query);
+#endif
+    }
+    DB_STMT* s = new DB_STMT;
+    int retval = s->prepare(mysql, query);
+    if (retval) {
+#ifdef _USING_FCGI_
+        log_messages.printf(MSG_CRITICAL,
+            "Database error: can't prepare statement: %s\nquery=%s\n",
+            s->stmt?mysql_stmt_error(s->stmt):"", query
+        );
+#else
+        fprintf(stderr,
+            "Database error: can't prepare statement: %s\nquery=%s\n",
+            s->stmt?mysql_stmt_error(s->stmt):"", query
+        );
+#endif
+        delete s;
+        stmt_fail_time[query] = time(0);
+        return NULL;
+    }
+    stmts[query] = s;
+    return s;
+}
+
+void DB_CONN::free_stmts() {
+    std::map<std::string, DB_STMT*>::iterator i;
+    for (i=stmts.begin(); i!=stmts.end(); i++) {
+        delete i->second;
+    }
+    stmts.clear();
+    stmt_fail_time.clear();
+}
+
+// discard a statement after an error (e.g. the connection was reset).
+// It will be prepared again next time.
+//
+void DB_CONN::drop_stmt(DB_STMT* s) {
+    std::map<std::string, DB_STMT*>::iterator i;
+    for (i=stmts.begin(); i!=stmts.end(); i++) {
+        if (i->second == s) {
+            stmts.erase(i);
+            break;
+        }
+    }
+    delete s;
+}
+
 int DB_CONN::set_isolation_level(ISOLATION_LEVEL level) {
     const char* level_str;
     char query[256];
@@ -196,6 +500,14 @@ DB_ID_TYPE DB_BASE::get_id() { return 0;}
 void DB_BASE::db_print(char*) {}
 void DB_BASE::db_parse(MYSQL_ROW&) {}
 
+// tables with many columns override this to use the binary values
+//
+void DB_BASE::db_parse_stmt(DB_STMT& s) {
+    MYSQL_ROW row;
+    s.get_row(row);
+    db_parse(row);
+}
+
 int DB_BASE::insert() {
     char vals[MAX_QUERY_LEN*2], query[MAX_QUERY_LEN*2];
     db_print(vals);
@@ -221,6 +533,22 @@ int DB_BASE::lookup_id(DB_ID_TYPE id) {
     MYSQL_ROW row;
     MYSQL_RES* rp;
 
+    if (db->use_prepared) {
+        sprintf(query, "select * from %s where id=?", table_name);
+        DB_STMT* s = db->get_stmt(query);
+        if (s) {
+            s->param_int(id);
+            retval = s->execute();
+            if (!retval) {
+                retval = s->fetch();
+                if (!retval) db_parse_stmt(*s);
+                s->free_result();
+                if (!retval || retval == ERR_DB_NOT_FOUND) return retval;
+            }
+            db->drop_stmt(s);
+        }
+    }
+
     sprintf(query, "select * from %s where id=%lu", table_name, id);
 
     retval = db->do_query(query);
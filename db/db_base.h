@@ -19,7 +19,9 @@
 #define _DB_BASE_
 
 #include <cstdlib>
+#include <map>
 #include <string>
+#include <vector>
 #include <mysql.h>
 
 extern bool g_print_queries;
@@ -43,13 +45,68 @@ inline double safe_atof(const char* s) {
     return atof(s);
 }
 
+typedef long DB_ID_TYPE;
+
 #define MAX_QUERY_LEN 262144
     // TODO: use string for queries, get rid of this
 
+// a server-side prepared statement.
+// Numeric result columns are bound to integer or double buffers,
+// so rows can be parsed without converting from text
+// (see db_parse_stmt()); other columns are bound to string buffers.
+// Parameters are bound, in order, with param_int() etc.
+//
+union DB_STMT_VALUE {
+    long long i;
+    double d;
+};
+
+struct DB_STMT {
+    MYSQL_STMT* stmt;
+
+    // result columns
+    std::vector<MYSQL_BIND> bind;
+    std::vector<DB_STMT_VALUE> vals;
+    std::vector<std::vector<char> > bufs;
+    std::vector<unsigned long> lengths;
+    std::vector<my_bool> nulls;
+    std::vector<char*> row;
+
+    // parameters
+    std::vector<MYSQL_BIND> params;
+    std::vector<DB_STMT_VALUE> param_vals;
+    std::vector<unsigned long> param_lengths;
+    unsigned int nparams;
+        // # of parameters bound for the next execute()
+
+    DB_STMT();
+    ~DB_STMT();
+    int prepare(MYSQL*, const char* query);
+    void param_int(long long);
+    void param_double(double);
+    void param_str(const char*);
+        // the string must not change until execute()
+    int execute();
+    int affected_rows();
+    int fetch();
+        // returns ERR_DB_NOT_FOUND if no more rows
+    void free_result();
+
+    // values of the current row
+    long long get_int(int col);
+    double get_double(int col);
+    void get_str(int col, char* p, int len);
+    void get_row(MYSQL_ROW&);
+        // as strings, for db_parse()
+    char* col_str(int col);
+};
+
 struct CURSOR {
     bool active;
     MYSQL_RES *rp;
-    CURSOR() { active = false; rp = NULL; }
+    DB_STMT* stmt;
+        // if nonzero, the enumeration uses this rather than rp
+    CURSOR() { active = false; rp = NULL; stmt = NULL; }
 };
 
 enum ISOLATION_LEVEL {
@@ -59,8 +116,6 @@ enum ISOLATION_LEVEL {
     SERIALIZABLE
 };
 
-typedef long DB_ID_TYPE;
-
 // represents a connection to a database
 //
 class DB_CONN {
@@ -79,8 +134,20 @@ public:
     int rollback_transaction();
     int commit_transaction();
     int get_double(const char* query, double&);
+    DB_STMT* get_stmt(const char* query);
+    void drop_stmt(DB_STMT*);
+    void free_stmts();
 
     MYSQL* mysql;
+    bool use_prepared;
+        // use prepared statements for lookup_id(), result updates
+        // and the feeder's enumeration.
+        // Set by programs that do many of these.
+    std::map<std::string, DB_STMT*> stmts;
+        // prepared statements, keyed by query
+    std::map<std::string, double> stmt_fail_time;
+        // queries that couldn't be prepared, and when;
+        // we try again after a while (e.g. after a reconnect)
 };
 
 // Base for derived classes that can access the DB
@@ -115,6 +182,8 @@ public:
     virtual DB_ID_TYPE get_id();
     virtual void db_print(char*);
     virtual void db_parse(MYSQL_ROW&);
+    virtual void db_parse_stmt(DB_STMT&);
+        // parse the current row of a "select *" prepared statement
 };
 
 // Base for derived classes that can get special-purpose data,
@@ -23,6 +23,13 @@
 #include "config.h"
 #include <cstring>
 #include <string>
+#include <climits>
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #endif
 
 #include "error_numbers.h"
@@ -115,6 +122,7 @@ void APP_INIT_DATA::copy(const APP_INIT_DATA& a) {
         project_preferences = NULL;
     }
     vbox_window                 = a.vbox_window;
+    shmem_version               = a.shmem_version;
     app_files                   = a.app_files;
 }
 
@@ -204,7 +212,8 @@ int write_init_data_file(FILE* f, APP_INIT_DATA& ai) {
         "<rsc_memory_bound>%f</rsc_memory_bound>\n"
         "<rsc_disk_bound>%f</rsc_disk_bound>\n"
         "<computation_deadline>%f</computation_deadline>\n"
-        "<vbox_window>%d</vbox_window>\n",
+        "<vbox_window>%d</vbox_window>\n"
+        "<shmem_version>%d</shmem_version>\n",
         ai.slot,
         ai.client_pid,
         ai.wu_cpu_time,
@@ -229,7 +238,8 @@ int write_init_data_file(FILE* f, APP_INIT_DATA& ai) {
         ai.rsc_memory_bound,
         ai.rsc_disk_bound,
         ai.computation_deadline,
-        ai.vbox_window
+        ai.vbox_window,
+        ai.shmem_version
     );
     MIOFILE mf;
     mf.init_file(f);
@@ -297,6 +307,7 @@ void APP_INIT_DATA::clear() {
     memset(&shmem_seg_name, 0, sizeof(shmem_seg_name));
     wu_cpu_time = 0;
     vbox_window = false;
+    shmem_version = 0;
 }
 
 int parse_init_data_file(FILE* f, APP_INIT_DATA& ai) {
@@ -403,6 +414,7 @@ int parse_init_data_file(FILE* f, APP_INIT_DATA& ai) {
         if (xp.parse_double("fraction_done_start", ai.fraction_done_start)) continue;
         if (xp.parse_double("fraction_done_end", ai.fraction_done_end)) continue;
         if (xp.parse_bool("vbox_window", ai.vbox_window)) continue;
+        if (xp.parse_int("shmem_version", ai.shmem_version)) continue;
         xp.skip_unexpected(false, "parse_init_data_file");
     }
     fprintf(stderr, "%s: parse_init_data_file: no end tag\n",
@@ -435,6 +447,57 @@ void MSG_CHANNEL::send_msg_overwrite(const char* msg) {
 
 void APP_CLIENT_SHM::reset_msgs() {
     memset(shm, 0, sizeof(SHARED_MEM));
+    shm->rings.version = SHMEM_VERSION;
+}
+
+void shmem_barrier() {
+#ifdef _MSC_VER
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+// The futex is in shared memory, so don't use the _PRIVATE variants.
+// Elsewhere, just sleep; the receiver polls.
+//
+void shmem_wait(volatile unsigned int* p, unsigned int val, double timeout) {
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = (time_t)timeout;
+    ts.tv_nsec = (long)((timeout - ts.tv_sec)*1e9);
+    syscall(SYS_futex, p, FUTEX_WAIT, val, &ts, NULL, 0);
+#else
+    if (*p == val) boinc_sleep(timeout);
+#endif
+}
+
+void shmem_wake(volatile unsigned int* p) {
+#ifdef __linux__
+    syscall(SYS_futex, p, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)p;
+#endif
+}
+
+bool MSG_RING::send_msg(const char* msg) {
+    unsigned int h = head;
+    if (h - tail >= MSG_RING_SIZE) return false;
+    strlcpy(recs[h%MSG_RING_SIZE].buf, msg, MSG_CHANNEL_SIZE);
+    shmem_barrier();
+    head = h+1;
+    shmem_wake(&head);
+    return true;
+}
+
+bool MSG_RING::get_msg(char* msg) {
+    unsigned int t = tail;
+    if (head == t) return false;
+    shmem_barrier();
+    strlcpy(msg, recs[t%MSG_RING_SIZE].buf, MSG_CHANNEL_SIZE);
+    shmem_barrier();
+    tail = t+1;
+    return true;
 }
 
 // Resolve virtual name (in slot dir) to physical path (in project dir).
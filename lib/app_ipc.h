@@ -23,6 +23,8 @@
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <cstddef>
+#include <stdint.h>
 
 #include "filesys.h"
 #include "hostinfo.h"
@@ -65,6 +67,127 @@ struct MSG_CHANNEL {
                             // write message, overwriting any msg already there
 };
 
+// Version 2 of the shared-memory layout adds lock-free rings
+// after the original channels (which stay where they were,
+// so that old apps work with new clients and vice versa).
+// The client announces it in init_data.xml (<shmem_version>);
+// an app that understands it sets rings.app_version after attaching,
+// and from then on both sides use the rings for
+// process control, heartbeats and status.
+// Graphics and trickle messages still use the channels.
+//
+#define SHMEM_VERSION   2
+
+extern void shmem_barrier();
+extern void shmem_wait(volatile unsigned int* p, unsigned int val, double timeout);
+    // sleep until *p != val or timeout (a futex on Linux)
+extern void shmem_wake(volatile unsigned int* p);
+
+// A single-producer, single-consumer ring of fixed-size records.
+// head is written only by the sender and tail only by the receiver,
+// so no locks are needed.  put() fails if the ring is full.
+//
+template <class T, int N> struct SHMEM_RING {
+    volatile unsigned int head;     // # of records put
+    volatile unsigned int tail;     // # of records gotten
+    T recs[N];
+
+    bool put(const T& r) {
+        unsigned int h = head;
+        if (h - tail >= (unsigned int)N) return false;
+        recs[h%N] = r;
+        shmem_barrier();
+        head = h+1;
+        return true;
+    }
+    bool get(T& r) {
+        unsigned int t = tail;
+        if (head == t) return false;
+        shmem_barrier();
+        r = recs[t%N];
+        shmem_barrier();
+        tail = t+1;
+        return true;
+    }
+    bool has_msg() {
+        return head != tail;
+    }
+    void wait(double timeout) {
+        // receiver: sleep until there's something to get, or timeout
+        unsigned int h = head;
+        if (h != tail) return;
+        shmem_wait(&head, h, timeout);
+    }
+};
+
+struct SHMEM_MSG {
+    char buf[MSG_CHANNEL_SIZE];
+};
+
+#define MSG_RING_SIZE   8
+
+// a ring of text messages; send_msg() wakes up the receiver
+//
+struct MSG_RING : public SHMEM_RING<SHMEM_MSG, MSG_RING_SIZE> {
+    bool send_msg(const char*);
+    bool get_msg(char*);
+};
+
+// The ring records are shared between a client and an app
+// that may have been built for different ABIs
+// (e.g. a 32-bit app run by a 64-bit client),
+// so they use fixed-size fields and are padded to a multiple of 8 bytes;
+// that way doubles are at the same offsets whatever their alignment.
+
+// sent every second, replacing <heartbeat/><wss>...
+//
+struct HEARTBEAT_REC {
+    double wss;                 // app's current working set size
+    double max_wss;             // max working set size
+    int32_t network_suspended;
+    int32_t pad;
+};
+
+// replaces the <current_cpu_time>... status message
+//
+struct APP_STATUS_REC {
+    double current_cpu_time;
+    double checkpoint_cpu_time;
+    double fraction_done;       // -1 if not known yet
+    double bytes_sent;
+    double bytes_received;
+    int32_t want_network;
+    int32_t other_pid;          // 0 if none
+};
+
+struct SHMEM_RINGS {
+    int32_t version;
+        // SHMEM_VERSION; set by the client
+    int32_t app_version;
+        // set by the app if it uses the rings; 0 for old apps
+    MSG_RING process_control_request;
+        // core->app
+    SHMEM_RING<HEARTBEAT_REC, 4> heartbeat;
+        // core->app
+    SHMEM_RING<APP_STATUS_REC, 8> app_status;
+        // app->core
+};
+
+static_assert(sizeof(HEARTBEAT_REC) == 24, "HEARTBEAT_REC layout");
+static_assert(sizeof(APP_STATUS_REC) == 48, "APP_STATUS_REC layout");
+static_assert(offsetof(SHMEM_RINGS, process_control_request) == 8,
+    "SHMEM_RINGS layout"
+);
+static_assert(offsetof(SHMEM_RINGS, heartbeat) == 8 + 8 + MSG_RING_SIZE*MSG_CHANNEL_SIZE,
+    "SHMEM_RINGS layout"
+);
+static_assert(offsetof(SHMEM_RINGS, app_status) == 8 + 8 + MSG_RING_SIZE*MSG_CHANNEL_SIZE + 8 + 4*24,
+    "SHMEM_RINGS layout"
+);
+static_assert(sizeof(SHMEM_RINGS) == 8 + 8 + MSG_RING_SIZE*MSG_CHANNEL_SIZE + 8 + 4*24 + 8 + 8*48,
+    "SHMEM_RINGS layout"
+);
+
 struct SHARED_MEM {
     MSG_CHANNEL process_control_request;
         // core->app
@@ -98,8 +221,14 @@ struct SHARED_MEM {
     MSG_CHANNEL trickle_down;
         // core->app
         // <have_new_trickle_down/>
+    SHMEM_RINGS rings;
+        // version 2; old clients' segments end before this
 };
 
+static_assert(offsetof(SHARED_MEM, rings) == 8*MSG_CHANNEL_SIZE,
+    "SHARED_MEM layout"
+);
+
 // MSG_QUEUE provides a queuing mechanism for shared-mem messages
 // (which don't have one otherwise)
 //
@@ -108,8 +237,10 @@ struct MSG_QUEUE {
     char name[256];
 	double last_block;	// last time we found message channel full
 	void init(char*);
-    void msg_queue_send(const char*, MSG_CHANNEL& channel);
-    void msg_queue_poll(MSG_CHANNEL& channel);
+    void msg_queue_send(const char*, MSG_CHANNEL& channel, MSG_RING* ring=NULL);
+    void msg_queue_poll(MSG_CHANNEL& channel, MSG_RING* ring=NULL);
+        // if ring is given (the app uses the version 2 layout)
+        // send through it rather than the channel
 	int msg_queue_purge(const char*);
 	bool timeout(double);
 };
@@ -211,6 +342,7 @@ struct APP_INIT_DATA {
     //
     double checkpoint_period;     // recommended checkpoint period
     SHMEM_SEG_NAME shmem_seg_name;
+    int shmem_version;          // shared-mem layout the client created; 0 if old
     double wu_cpu_time;       // cpu time from previous episodes
 
     APP_INIT_DATA();
@@ -75,6 +75,7 @@ int LOG_FLAGS::parse(XML_PARSER& xp) {
         if (xp.parse_bool("cpu_sched", cpu_sched)) continue;
         if (xp.parse_bool("cpu_sched_debug", cpu_sched_debug)) continue;
         if (xp.parse_bool("cpu_sched_status", cpu_sched_status)) continue;
+        if (xp.parse_bool("cpu_sched_timing", cpu_sched_timing)) continue;
         if (xp.parse_bool("dcf_debug", dcf_debug)) continue;
         if (xp.parse_bool("disk_usage_debug", disk_usage_debug)) continue;
         if (xp.parse_bool("file_xfer_debug", file_xfer_debug)) continue;
@@ -125,6 +126,7 @@ int LOG_FLAGS::write(MIOFILE& out) {
         "        <cpu_sched>%d</cpu_sched>\n"
         "        <cpu_sched_debug>%d</cpu_sched_debug>\n"
         "        <cpu_sched_status>%d</cpu_sched_status>\n"
+        "        <cpu_sched_timing>%d</cpu_sched_timing>\n"
         "        <dcf_debug>%d</dcf_debug>\n"
         "        <disk_usage_debug>%d</disk_usage_debug>\n"
         "        <file_xfer_debug>%d</file_xfer_debug>\n"
@@ -168,6 +170,7 @@ int LOG_FLAGS::write(MIOFILE& out) {
         cpu_sched ? 1 : 0,
         cpu_sched_debug ? 1 : 0,
         cpu_sched_status ? 1 : 0,
+        cpu_sched_timing ? 1 : 0,
         dcf_debug ? 1 : 0,
         disk_usage_debug ? 1 : 0,
         file_xfer_debug ? 1 : 0,
@@ -210,6 +213,7 @@ void CC_CONFIG::defaults() {
     allow_multiple_clients = false;
     allow_remote_gui_rpc = false;
     alt_platforms.clear();
+    binary_state_file = false;
     config_coprocs.clear();
     disallow_attach = false;
     dont_check_file_sizes = false;
@@ -260,10 +264,12 @@ void CC_CONFIG::defaults() {
     simple_gui_only = false;
     skip_cpu_benchmarks = false;
     start_delay = 0;
+    state_file_write_interval = 0;
     stderr_head = false;
     suppress_net_info = false;
     unsigned_apps_ok = false;
     use_all_gpus = false;
+    use_cgroups = false;
     use_certs = false;
     use_certs_only = false;
     vbox_window = false;
@@ -326,6 +332,7 @@ int CC_CONFIG::parse_options(XML_PARSER& xp) {
             alt_platforms.push_back(s);
             continue;
         }
+        if (xp.parse_bool("binary_state_file", binary_state_file)) continue;
         if (xp.match_tag("coproc")) {
             COPROC c;
             retval = c.parse(xp);
@@ -422,10 +429,12 @@ int CC_CONFIG::parse_options(XML_PARSER& xp) {
         if (xp.parse_bool("simple_gui_only", simple_gui_only)) continue;
         if (xp.parse_bool("skip_cpu_benchmarks", skip_cpu_benchmarks)) continue;
         if (xp.parse_double("start_delay", start_delay)) continue;
+        if (xp.parse_double("state_file_write_interval", state_file_write_interval)) continue;
         if (xp.parse_bool("stderr_head", stderr_head)) continue;
         if (xp.parse_bool("suppress_net_info", suppress_net_info)) continue;
         if (xp.parse_bool("unsigned_apps_ok", unsigned_apps_ok)) continue;
         if (xp.parse_bool("use_all_gpus", use_all_gpus)) continue;
+        if (xp.parse_bool("use_cgroups", use_cgroups)) continue;
         if (xp.parse_bool("use_certs", use_certs)) continue;
         if (xp.parse_bool("use_certs_only", use_certs_only)) continue;
         if (xp.parse_bool("vbox_window", vbox_window)) continue;
@@ -514,6 +523,11 @@ int CC_CONFIG::write(MIOFILE& out, LOG_FLAGS& log_flags) {
         );
     }
 
+    out.printf(
+        "        <binary_state_file>%d</binary_state_file>\n",
+        binary_state_file ? 1 : 0
+    );
+
     for (int k=1; k<config_coprocs.n_rsc; k++) {
         if (!config_coprocs.coprocs[k].specified_in_config) continue;
         out.printf(
@@ -658,10 +672,12 @@ int CC_CONFIG::write(MIOFILE& out, LOG_FLAGS& log_flags) {
         "        <skip_cpu_benchmarks>%d</skip_cpu_benchmarks>\n"
         "        <simple_gui_only>%d</simple_gui_only>\n"
         "        <start_delay>%f</start_delay>\n"
+        "        <state_file_write_interval>%f</state_file_write_interval>\n"
         "        <stderr_head>%d</stderr_head>\n"
         "        <suppress_net_info>%d</suppress_net_info>\n"
         "        <unsigned_apps_ok>%d</unsigned_apps_ok>\n"
         "        <use_all_gpus>%d</use_all_gpus>\n"
+        "        <use_cgroups>%d</use_cgroups>\n"
         "        <use_certs>%d</use_certs>\n"
         "        <use_certs_only>%d</use_certs_only>\n"
         "        <vbox_window>%d</vbox_window>\n",
@@ -672,10 +688,12 @@ int CC_CONFIG::write(MIOFILE& out, LOG_FLAGS& log_flags) {
         skip_cpu_benchmarks,
         simple_gui_only,
         start_delay,
+        state_file_write_interval,
         stderr_head,
         suppress_net_info,
         unsigned_apps_ok,
         use_all_gpus,
+        use_cgroups,
         use_certs,
         use_certs_only,
         vbox_window
@@ -73,6 +73,8 @@ struct LOG_FLAGS {
         // explain scheduler decisions
     bool cpu_sched_status;
         // show what's running
+    bool cpu_sched_timing;
+        // show how long each CPU scheduling pass takes
     bool dcf_debug;
         // show changes to duration correction factors
     bool disk_usage_debug;
@@ -146,6 +148,10 @@ struct CC_CONFIG {
     bool allow_multiple_clients;
     bool allow_remote_gui_rpc;
     std::vector<std::string> alt_platforms;
+    bool binary_state_file;
+        // keep the client state in a binary snapshot
+        // plus a journal of changed records (client_state.bin/.jnl);
+        // client_state.xml is written on exit
     COPROCS config_coprocs;
     bool disallow_attach;
     bool dont_check_file_sizes;
@@ -190,10 +196,15 @@ struct CC_CONFIG {
     bool skip_cpu_benchmarks;
     bool simple_gui_only;
     double start_delay;
+    double state_file_write_interval;
+        // write client_state.xml at most this often (seconds)
     bool stderr_head;
     bool suppress_net_info;
     bool unsigned_apps_ok;
     bool use_all_gpus;
+    bool use_cgroups;
+        // Linux: put each task in its own cgroup (v2), and use it
+        // for CPU throttling, memory limits, and suspension
     bool use_certs;
     bool use_certs_only;
         // overrides use_certs
@@ -24,6 +24,7 @@
 #include <string>
 #include <cstring>
 #include <cstdarg>
+#include <cstdlib>
 #endif
 
 #include "error_numbers.h"
@@ -39,9 +40,11 @@ MIOFILE::MIOFILE() {
     len = 0;
     f = 0;
     buf = 0;
+    file_buf = 0;
 }
 
 MIOFILE::~MIOFILE() {
+    if (file_buf) free(file_buf);
 }
 
 void MIOFILE::init_mfile(MFILE* _mf) {
@@ -56,6 +59,32 @@ void MIOFILE::init_buf_read(const char* _buf) {
     buf = _buf;
 }
 
+#ifndef _USING_FCGI_
+int MIOFILE::init_file_buf(const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (!in) return ERR_FOPEN;
+    fseek(in, 0, SEEK_END);
+    long n = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    if (n < 0) {
+        fclose(in);
+        return ERR_FREAD;
+    }
+    char* p = (char*)malloc(n+1);
+    if (!p) {
+        fclose(in);
+        return ERR_MALLOC;
+    }
+    size_t m = fread(p, 1, n, in);
+    fclose(in);
+    p[m] = 0;
+    if (file_buf) free(file_buf);
+    file_buf = p;
+    buf = p;
+    return 0;
+}
+#endif
+
 void MIOFILE::init_buf_write(char* _buf, int _len) {
     wbuf = _buf;
     len = _len;
@@ -130,36 +159,46 @@ int MIOFILE::_ungetc(int c) {
     return c;
 }
 
-// copy from a file to static buffer
+// copy input up to but not including end tag, to a buffer
 //
 int copy_element_contents(MIOFILE& in, const char* end_tag, char* p, int len) {
-    char buf[256];
-    int n;
-
-    strlcpy(p, "", len);
-    while (in.fgets(buf, 256)) {
-        if (strstr(buf, end_tag)) {
-            return 0;
-        }
-        n = (int)strlen(buf);
-        if (n >= len-1) return ERR_XML_PARSE;
-        strlcat(p, buf, len);
-        len -= n;
+    string buf;
+    int retval = copy_element_contents(in, end_tag, buf);
+    if (retval) return retval;
+    if ((int)buf.size() > len-1) {
+        return ERR_BUFFER_OVERFLOW;
     }
-    return ERR_XML_PARSE;
+    strlcpy(p, buf.c_str(), len);
+    return 0;
 }
 
+// same, to a string
+//
 int copy_element_contents(MIOFILE& in, const char* end_tag, string& str) {
-    char buf[256];
+    size_t end_tag_len = strlen(end_tag);
+    size_t n = 0;
 
     str = "";
-    while (in.fgets(buf, 256)) {
-        if (strstr(buf, end_tag)) {
+    const char* p = in.in_buf();
+    if (p) {
+        const char* q = strstr(p, end_tag);
+        if (!q) return ERR_XML_PARSE;
+        str.assign(p, q-p);
+        in.set_in_buf(q+end_tag_len);
+        return 0;
+    }
+    while (1) {
+        int c = in._getc();
+        if (c == EOF) break;
+        str += (char)c;
+        n++;
+        if (n < end_tag_len) {
+            continue;
+        }
+        if (!strcmp(str.c_str() + n - end_tag_len, end_tag)) {
+            str.erase(n-end_tag_len, end_tag_len);
             return 0;
         }
-        str += buf;
     }
-    fprintf(stderr, "copy_element_contents(): no end tag\n");
     return ERR_XML_PARSE;
 }
-
@@ -38,6 +38,9 @@
 //  init_file(): input comes from the FILE* that you specify
 //  init_buf(): input comes from the buffer you specify.
 //   This string is not modified.
+//  init_file_buf(): the file is read into memory, and input comes from there.
+//   Use this for big files (e.g. the client state file);
+//   XML_PARSER has faster code paths for memory buffers.
 //
 // Why is this here?  Because on Windows (9x, maybe all)
 // you can't do fdopen() on a socket.
@@ -47,6 +50,7 @@ class MIOFILE {
     char* wbuf;
     int len;
     const char* buf;
+    char* file_buf;     // buffer allocated by init_file_buf()
 public:
     FILE* f;
 
@@ -59,6 +63,9 @@ public:
     void init_file(FCGI_FILE *);
 #endif
     void init_buf_read(const char*);
+#ifndef _USING_FCGI_
+    int init_file_buf(const char* path);
+#endif
     void init_buf_write(char*, int len);
     int printf(const char* format, ...);
     char* fgets(char*, int);
@@ -70,6 +77,16 @@ public:
         }
         return (*buf)?(*buf++):EOF;
     }
+
+    // if input is from a memory buffer, return the current position
+    // (so that the caller can scan it directly); else NULL
+    //
+    inline const char* in_buf() {
+        return f?NULL:buf;
+    }
+    inline void set_in_buf(const char* p) {
+        buf = p;
+    }
 };
 
 extern int copy_element_contents(MIOFILE& in, const char* end_tag, char* p, int len);
@@ -37,6 +37,14 @@
 #include <errno.h>
 #endif
 
+#include <cmath>
+#include <algorithm>
+#ifdef __linux__
+#include <stdint.h>
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
+
 #ifdef _MSC_VER
 #define snprintf _snprintf
 #endif
@@ -355,3 +363,220 @@ int boinc_get_port(bool is_remote, int& port) {
     boinc_close_socket(sock);
     return 0;
 }
+
+EVENT_LOOP::EVENT_LOOP() {
+    next_serial = 0;
+    epoll_fd = -1;
+    initialized = false;
+}
+
+EVENT_LOOP::~EVENT_LOOP() {
+#ifdef USE_EPOLL
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+#endif
+}
+
+// Create the epoll set.
+// If this fails we use select(), as on other platforms
+//
+void EVENT_LOOP::init() {
+    initialized = true;
+#ifdef USE_EPOLL
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+#ifdef USE_EPOLL
+static void epoll_set_event(
+    epoll_event& ev, int fd, int events, unsigned int serial
+) {
+    memset(&ev, 0, sizeof(ev));
+    if (events & EVENT_READ) ev.events |= EPOLLIN;
+    if (events & EVENT_WRITE) ev.events |= EPOLLOUT;
+    if (events & EVENT_EXC) ev.events |= EPOLLPRI;
+    ev.data.u64 = (((uint64_t)serial)<<32) | (uint32_t)fd;
+}
+#endif
+
+int EVENT_LOOP::set_fd(int fd, int events, EVENT_HANDLER* handler) {
+    if (!events) {
+        remove_fd(fd);
+        return 0;
+    }
+    if (!initialized) init();
+    std::map<int, EVENT_FD>::iterator i = fds.find(fd);
+    bool existed = (i != fds.end());
+    EVENT_FD& e = fds[fd];
+    if (!existed || e.handler != handler) {
+        e.serial = next_serial++;
+    }
+    e.fd = fd;
+    e.events = events;
+    e.handler = handler;
+#ifdef USE_EPOLL
+    if (epoll_fd >= 0) {
+        epoll_event ev;
+        epoll_set_event(ev, fd, events, e.serial);
+        int retval = epoll_ctl(
+            epoll_fd, existed?EPOLL_CTL_MOD:EPOLL_CTL_ADD, fd, &ev
+        );
+        if (retval && errno == ENOENT) {
+            // the old descriptor was closed without being removed,
+            // and this is a new one with the same number
+            //
+            retval = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        } else if (retval && errno == EEXIST) {
+            retval = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        if (retval) {
+            fds.erase(fd);
+            return ERR_SELECT;
+        }
+    }
+#endif
+    return 0;
+}
+
+void EVENT_LOOP::remove_fd(int fd) {
+    if (!fds.erase(fd)) return;
+#ifdef USE_EPOLL
+    if (epoll_fd >= 0) {
+        // fails harmlessly if the descriptor is already closed
+        //
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+    }
+#endif
+}
+
+void EVENT_LOOP::add_timer(EVENT_TIMER* t) {
+    if (std::find(timers.begin(), timers.end(), t) == timers.end()) {
+        timers.push_back(t);
+    }
+}
+
+void EVENT_LOOP::remove_timer(EVENT_TIMER* t) {
+    std::vector<EVENT_TIMER*>::iterator i =
+        std::find(timers.begin(), timers.end(), t);
+    if (i != timers.end()) {
+        timers.erase(i);
+    }
+}
+
+int EVENT_LOOP::wait_select(double timeout) {
+    FDSET_GROUP fg;
+    std::map<int, EVENT_FD>::iterator i;
+
+    fg.zero();
+    for (i=fds.begin(); i!=fds.end(); ++i) {
+        EVENT_FD& e = i->second;
+#ifndef _WIN32
+        if (e.fd >= FD_SETSIZE) continue;
+#endif
+        if (e.events & EVENT_READ) FD_SET(e.fd, &fg.read_fds);
+        if (e.events & EVENT_WRITE) FD_SET(e.fd, &fg.write_fds);
+        if (e.events & EVENT_EXC) FD_SET(e.fd, &fg.exc_fds);
+        if (e.fd > fg.max_fd) fg.max_fd = e.fd;
+    }
+    if (fg.max_fd == -1) {
+        boinc_sleep(timeout);
+        return 0;
+    }
+    timeval tv;
+    tv.tv_sec = (int)timeout;
+    tv.tv_usec = (int)(1000000*(timeout - (int)timeout));
+    int n = select(
+        fg.max_fd+1, &fg.read_fds, &fg.write_fds, &fg.exc_fds, &tv
+    );
+    if (n <= 0) return 0;
+    for (i=fds.begin(); i!=fds.end(); ++i) {
+        EVENT_FD e = i->second;
+#ifndef _WIN32
+        if (e.fd >= FD_SETSIZE) continue;
+#endif
+        e.events = 0;
+        if (FD_ISSET(e.fd, &fg.read_fds)) e.events |= EVENT_READ;
+        if (FD_ISSET(e.fd, &fg.write_fds)) e.events |= EVENT_WRITE;
+        if (FD_ISSET(e.fd, &fg.exc_fds)) e.events |= EVENT_EXC;
+        if (e.events) ready.push_back(e);
+    }
+    return (int)ready.size();
+}
+
+int EVENT_LOOP::wait(double timeout) {
+    if (!initialized) init();
+    ready.clear();
+    double now = dtime();
+    for (unsigned int i=0; i<timers.size(); i++) {
+        EVENT_TIMER* t = timers[i];
+        if (t->when && t->when - now < timeout) {
+            timeout = t->when - now;
+        }
+    }
+    if (timeout < 0) timeout = 0;
+#ifdef USE_EPOLL
+    if (epoll_fd >= 0) {
+        epoll_event evs[256];
+        int n = epoll_wait(epoll_fd, evs, 256, (int)ceil(timeout*1000));
+        for (int j=0; j<n; j++) {
+            EVENT_FD e;
+            e.fd = (int)(evs[j].data.u64 & 0xffffffff);
+            e.serial = (unsigned int)(evs[j].data.u64 >> 32);
+            e.handler = NULL;
+            e.events = 0;
+            int ee = evs[j].events;
+            if (ee & EPOLLIN) e.events |= EVENT_READ;
+            if (ee & EPOLLOUT) e.events |= EVENT_WRITE;
+            if (ee & EPOLLPRI) e.events |= EVENT_EXC;
+            // report hangups and errors as select() does:
+            // the socket is readable (read() returns 0 or the error)
+            // and, on error, writable (e.g. a failed connect)
+            //
+            if (ee & (EPOLLHUP|EPOLLERR)) e.events |= EVENT_READ;
+            if (ee & EPOLLERR) e.events |= EVENT_WRITE;
+            ready.push_back(e);
+        }
+        return (int)ready.size();
+    }
+#endif
+    return wait_select(timeout);
+}
+
+void EVENT_LOOP::dispatch() {
+    // a handler may remove descriptors (its own or others),
+    // so look each one up again before calling its handler
+    //
+    for (unsigned int i=0; i<ready.size(); i++) {
+        EVENT_FD& r = ready[i];
+        std::map<int, EVENT_FD>::iterator j = fds.find(r.fd);
+        if (j == fds.end()) continue;
+        EVENT_FD& e = j->second;
+        if (e.serial != r.serial) continue;
+        int events = r.events & (e.events|EVENT_EXC);
+        if (!events) continue;
+        e.handler->handle_event(r.fd, events);
+    }
+    ready.clear();
+
+    // likewise timer handlers may add or remove timers
+    //
+    double now = dtime();
+    std::vector<EVENT_TIMER*> due;
+    for (unsigned int i=0; i<timers.size(); i++) {
+        EVENT_TIMER* t = timers[i];
+        if (t->when && t->when <= now) {
+            due.push_back(t);
+        }
+    }
+    for (unsigned int i=0; i<due.size(); i++) {
+        EVENT_TIMER* t = due[i];
+        if (std::find(timers.begin(), timers.end(), t) == timers.end()) {
+            continue;
+        }
+        t->when = 0;
+        t->handler->handle_timer(t);
+    }
+}
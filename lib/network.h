@@ -19,6 +19,8 @@
 #define BOINC_NETWORK_H
 
 #include <string.h>
+#include <map>
+#include <vector>
 #ifdef _WIN32
 #include "boinc_win.h"
 // WxWidgets can't deal with modern network code (winsock2.h)
@@ -44,6 +46,81 @@ struct FDSET_GROUP {
     }
 };
 
+// An event loop over a persistent set of descriptors.
+// Unlike FDSET_GROUP, descriptors are registered once
+// (and changed or removed when needed)
+// rather than being collected from every subsystem on each wakeup.
+// Uses epoll on Linux, select() elsewhere.
+//
+#define EVENT_READ      1
+#define EVENT_WRITE     2
+#define EVENT_EXC       4
+
+struct EVENT_TIMER;
+
+struct EVENT_HANDLER {
+    virtual void handle_event(int /*fd*/, int /*events*/) {}
+        // the descriptor is ready; events is a mask of EVENT_*
+    virtual void handle_timer(EVENT_TIMER*) {}
+    virtual ~EVENT_HANDLER() {}
+};
+
+struct EVENT_TIMER {
+    double when;
+        // dtime() at which to fire; 0 if not armed.
+        // Disarmed when it fires
+    EVENT_HANDLER* handler;
+    EVENT_TIMER(EVENT_HANDLER* h=NULL) {
+        when = 0;
+        handler = h;
+    }
+};
+
+struct EVENT_FD {
+    int fd;
+    int events;
+    unsigned int serial;
+        // distinguishes a reused descriptor number
+        // from the one it replaced
+    EVENT_HANDLER* handler;
+};
+
+class EVENT_LOOP {
+    std::map<int, EVENT_FD> fds;
+    std::vector<EVENT_TIMER*> timers;
+    std::vector<EVENT_FD> ready;
+        // descriptors returned by the last wait(), with ready events
+    unsigned int next_serial;
+    int epoll_fd;
+    bool initialized;
+    void init();
+    int wait_select(double timeout);
+public:
+    EVENT_LOOP();
+    ~EVENT_LOOP();
+    int set_fd(int fd, int events, EVENT_HANDLER*);
+        // add a descriptor, or change its events or handler.
+        // events=0 removes it, like remove_fd()
+    void remove_fd(int fd);
+        // OK to call during dispatch(), or for unknown descriptors
+    void add_timer(EVENT_TIMER*);
+    void remove_timer(EVENT_TIMER*);
+    int wait(double timeout);
+        // wait until a descriptor is ready,
+        // the earliest armed timer is due, or timeout secs have passed.
+        // Returns the number of ready descriptors.
+        // Doesn't call any handlers, so it can be done without locks
+    void dispatch();
+        // call handlers for descriptors found by wait(),
+        // then for timers that are due
+    bool using_epoll() {
+        return epoll_fd >= 0;
+    }
+    size_t nfds() {
+        return fds.size();
+    }
+};
+
 extern bool is_localhost(sockaddr_storage& s);
 extern bool same_ip_addr(sockaddr_storage& s1, sockaddr_storage& s2);
 extern int resolve_hostname(const char* hostname, sockaddr_storage& ip_addr);
@@ -391,8 +391,9 @@ void xml_unescape(string& in) {
 }
 
 void xml_unescape(char* buf) {
-    char* out = buf;
-    char* in = buf;
+    char* in = strchr(buf, '&');
+    if (!in) return;        // the usual case
+    char* out = in;
     char* p;
     while (*in) {
         if (*in != '&') {       // avoid strncmp's if possible
@@ -591,6 +592,29 @@ bool XML_PARSER::parse_string(const char* start_tag, string& str) {
         return true;
     }
     if (strcmp(parsed_tag, start_tag)) return false;
+
+    // if input is in memory, and the string is followed by the end tag,
+    // copy it directly rather than going through a big temp buffer
+    //
+    const char* p = f->in_buf();
+    if (p) {
+        const char* q = strchr(p, '<');
+        size_t n = strlen(start_tag);
+        if (q && q[1] == '/' && !strncmp(q+2, start_tag, n) && q[n+2] == '>'
+            && q-p < MAX_XML_STRING
+        ) {
+            while (p < q && isascii(*p) && isspace(*p)) p++;
+            const char* e = q;
+            while (e > p && isascii(e[-1]) && isspace(e[-1])) e--;
+            str.assign(p, e-p);
+            if (str.find('&') != string::npos) {
+                xml_unescape(str);
+            }
+            f->set_in_buf(q+n+3);
+            return true;
+        }
+    }
+
     char *buf=(char *)malloc(MAX_XML_STRING);
     if (buf) {
         flag = parse_str_aux(start_tag, buf, MAX_XML_STRING);
@@ -59,6 +59,19 @@ struct XML_PARSER {
     //
     inline int copy_until_tag(char* buf, int len) {
         int c;
+        const char* p = f->in_buf();
+        if (p) {
+            // memory buffer: find the < with strchr(), which is fast
+            //
+            const char* q = strchr(p, '<');
+            if (!q) return XML_PARSE_EOF;
+            int n = (int)(q-p);
+            if (n >= len) return XML_PARSE_OVERFLOW;
+            memcpy(buf, p, n);
+            buf[n] = 0;
+            f->set_in_buf(q);
+            return XML_PARSE_DATA;
+        }
         while (1) {
             c = f->_getc();
             if (!c || c == EOF) return XML_PARSE_EOF;
@@ -114,6 +127,17 @@ struct XML_PARSER {
     //
     inline bool scan_nonws(int& first_char) {
         int c;
+        const char* p = f->in_buf();
+        if (p) {
+            while (isascii(*p) && isspace(*p)) p++;
+            if (!*p) {
+                f->set_in_buf(p);
+                return true;
+            }
+            first_char = *p;
+            f->set_in_buf(p+1);
+            return false;
+        }
         while (1) {
             c = f->_getc();
             if (!c || c == EOF) return true;
@@ -172,6 +196,21 @@ struct XML_PARSER {
         bool found_space = false;
         int tag_len = _tag_len;
 
+        // memory buffer: handle the common case (no attributes,
+        // not a comment or CDATA) without going char by char
+        //
+        const char* p = f->in_buf();
+        if (p && *p != '!') {
+            size_t n = strcspn(p, "> \t\r\n");
+            if (p[n] == '>' && (int)n < _tag_len) {
+                memcpy(buf, p, n);
+                buf[n] = 0;
+                if (attr_buf) *attr_buf = 0;
+                f->set_in_buf(p+n+1);
+                return XML_PARSE_TAG;
+            }
+        }
+
         for (int i=0; ; i++) {
             c = f->_getc();
             if (!c || c == EOF) return XML_PARSE_EOF;
@@ -227,6 +266,19 @@ struct XML_PARSER {
     inline int element_contents(const char* end_tag, char* buf, int buflen) {
         int n=0;
         int retval=0;
+        int end_len = (int)strlen(end_tag);
+        const char* p = f->in_buf();
+        if (p) {
+            const char* q = strstr(p, end_tag);
+            if (!q) return ERR_XML_PARSE;
+            n = (int)(q-p);
+            if (n+end_len >= buflen) return ERR_XML_PARSE;
+            memcpy(buf, p, n);
+            buf[n] = 0;
+            f->set_in_buf(q+end_len);
+            strip_whitespace(buf);
+            return 0;
+        }
         while (1) {
             if (n == buflen-1) {
                 retval = ERR_XML_PARSE;
@@ -239,9 +291,13 @@ struct XML_PARSER {
             }
             buf[n++] = (char)c;
             buf[n] = 0;
-            char* p = strstr(buf, end_tag);
-            if (p) {
-                *p = 0;
+
+            // the end tag can only be at the end of what we've read
+            //
+            if (c == '>' && n >= end_len
+                && !strcmp(buf+n-end_len, end_tag)
+            ) {
+                buf[n-end_len] = 0;
                 break;
             }
         }
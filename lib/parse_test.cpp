@@ -6,6 +6,7 @@
 using std::string;
 
 #include "parse.h"
+#include "util.h"
 
 void parse(FILE* f) {
     bool flag;
@@ -50,7 +51,60 @@ void parse(FILE* f) {
     printf("unexpected EOF\n");
 }
 
-int main() {
+// scan all the tags and text in a file, and return the number of tags
+//
+int scan_all(XML_PARSER& xp) {
+    int ntags = 0;
+    while (!xp.get_tag()) {
+        if (xp.is_tag) ntags++;
+    }
+    return ntags;
+}
+
+// time the parser on a real file (e.g. client_state.xml or sched_request),
+// reading it with stdio and from memory
+//
+void bench(const char* path, int niters) {
+    int ntags=0, n;
+    double t;
+
+    t = dtime();
+    for (int i=0; i<niters; i++) {
+        FILE* f = fopen(path, "r");
+        if (!f) {
+            fprintf(stderr, "can't open %s\n", path);
+            exit(1);
+        }
+        MIOFILE mf;
+        XML_PARSER xp(&mf);
+        mf.init_file(f);
+        ntags = scan_all(xp);
+        fclose(f);
+    }
+    printf("FILE:   %d tags, %f sec/parse\n", ntags, (dtime()-t)/niters);
+
+    t = dtime();
+    for (int i=0; i<niters; i++) {
+        MIOFILE mf;
+        XML_PARSER xp(&mf);
+        if (mf.init_file_buf(path)) {
+            fprintf(stderr, "can't read %s\n", path);
+            exit(1);
+        }
+        n = scan_all(xp);
+    }
+    printf("memory: %d tags, %f sec/parse\n", n, (dtime()-t)/niters);
+    if (n != ntags) {
+        printf("tag counts differ\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && !strcmp(argv[1], "--bench")) {
+        bench(argv[2], argc>3?atoi(argv[3]):100);
+        return 0;
+    }
     FILE* f = fopen("foo.xml", "r");
     if (!f) {
         fprintf(stderr, "no file\n");
@@ -59,7 +113,8 @@ int main() {
     parse(f);
 }
 
-/* try it with something like:
+/* try it with something like the following,
+or do "parse_test --bench client_state.xml [niters]"
 
 <?xml version="1.0" encoding="ISO-8859-1" ?>
 <blah>
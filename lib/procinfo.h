@@ -82,4 +82,16 @@ extern void procinfo_non_boinc(PROCINFO&, PROC_MAP&);
 extern double process_tree_cpu_time(int pid);
     // get the CPU time of the given process and its descendants
 
+#ifdef __linux__
+extern bool procinfo_children_supported();
+    // whether procinfo_setup_pids() can be used
+
+extern int procinfo_setup_pids(PROC_MAP&, std::vector<int>& pids);
+    // like procinfo_setup(), but only the given processes
+    // and their descendants
+
+extern int procinfo_system_cpu(double& busy, double& nice);
+    // total non-idle and nice CPU time of all processes
+#endif
+
 #endif
@@ -166,17 +166,61 @@ int PROC_STAT::parse(char* buf) {
     return 1;
 }
 
+#if !(defined(HAVE_PROCFS_H) && defined(HAVE__PROC_SELF_PSINFO))
+// get info for one process from /proc/PID/stat
+//
+static int proc_stat_info(const char* pid_str, int self_pid, PROCINFO& p) {
+    char pidpath[MAXPATHLEN];
+    char buf[1024];
+    PROC_STAT ps;
+    FILE* fd;
+    int retval;
+
+    snprintf(pidpath, sizeof(pidpath), "/proc/%s/stat", pid_str);
+    fd = fopen(pidpath, "r");
+    if (!fd) return ERR_FOPEN;
+    if (fgets(buf, sizeof(buf), fd) == NULL) {
+        retval = ERR_NULL;
+    } else {
+        retval = ps.parse(buf);
+    }
+    fclose(fd);
+
+    if (retval) {
+        // ps.parse() returns an error if the executable name contains ).
+        // In that case skip this process.
+        //
+        return retval;
+    }
+    p.clear();
+    p.id = ps.pid;
+    p.parentid = ps.ppid;
+    p.swap_size = ps.vsize;
+    // rss = pages, need bytes
+    // assumes page size = 4k
+    p.working_set_size = ps.rss * (float)getpagesize();
+    // page faults: I/O + non I/O
+    p.page_fault_count = ps.majflt + ps.minflt;
+    // times are in jiffies, need seconds
+    // assumes 100 jiffies per second
+    p.user_time = ps.utime / 100.;
+    p.kernel_time = ps.stime / 100.;
+    strlcpy(p.command, ps.comm, sizeof(p.command));
+    p.is_boinc_app = (p.id == self_pid || strcasestr(p.command, "boinc"));
+    p.is_low_priority = (ps.priority == 39);
+        // Internally Linux stores the process priority as nice + 20
+        // as -ve values are error codes. Thus this generally gives
+        // a process priority range of 39..0
+    return 0;
+}
+#endif
+
 // build table of all processes in system
 //
 int procinfo_setup(PROC_MAP& pm) {
     DIR *dir;
     dirent *piddir;
-    FILE* fd;
-    PROC_STAT ps;
-    char pidpath[MAXPATHLEN];
-    char buf[1024];
     int pid = getpid();
-    int retval;
 
     dir = opendir("/proc");
     if (!dir) {
@@ -190,6 +234,8 @@ int procinfo_setup(PROC_MAP& pm) {
         if (!isdigit(piddir->d_name[0])) continue;
 
 #if defined(HAVE_PROCFS_H) && defined(HAVE__PROC_SELF_PSINFO)  // solaris
+        FILE* fd;
+        char pidpath[MAXPATHLEN];
         psinfo_t psinfo;
         sprintf(pidpath, "/proc/%s/psinfo", piddir->d_name);
         fd = fopen(pidpath, "r");
@@ -220,42 +266,8 @@ int procinfo_setup(PROC_MAP& pm) {
         p.is_boinc_app = (p.id == pid || strcasestr(p.command, "boinc"));
         pm.insert(std::pair(p.id, p));
 #else  // linux
-        sprintf(pidpath, "/proc/%s/stat", piddir->d_name);
-        fd = fopen(pidpath, "r");
-        if (!fd) continue;
-        if (fgets(buf, sizeof(buf), fd) == NULL) {
-            retval = ERR_NULL;
-        } else {
-            retval = ps.parse(buf);
-        }
-        fclose(fd);
-
-        if (retval) {
-            // ps.parse() returns an error if the executable name contains ).
-            // In that case skip this process.
-            //
-            continue;
-        }
         PROCINFO p;
-        p.clear();
-        p.id = ps.pid;
-        p.parentid = ps.ppid;
-        p.swap_size = ps.vsize;
-        // rss = pages, need bytes
-        // assumes page size = 4k
-        p.working_set_size = ps.rss * (float)getpagesize();
-        // page faults: I/O + non I/O
-        p.page_fault_count = ps.majflt + ps.minflt;
-        // times are in jiffies, need seconds
-        // assumes 100 jiffies per second
-        p.user_time = ps.utime / 100.;
-        p.kernel_time = ps.stime / 100.;
-        strlcpy(p.command, ps.comm, sizeof(p.command));
-        p.is_boinc_app = (p.id == pid || strcasestr(p.command, "boinc"));
-        p.is_low_priority = (ps.priority == 39);
-            // Internally Linux stores the process priority as nice + 20
-            // as -ve values are error codes. Thus this generally gives
-            // a process priority range of 39..0
+        if (proc_stat_info(piddir->d_name, pid, p)) continue;
         pm.insert(std::pair<int, PROCINFO>(p.id, p));
 #endif
     }
@@ -263,3 +275,95 @@ int procinfo_setup(PROC_MAP& pm) {
     find_children(pm);
     return 0;
 }
+
+#ifdef __linux__
+// The following let the client get info on its tasks
+// without reading /proc/PID/stat for every process in the system,
+// which is expensive on hosts with thousands of processes.
+
+// Linux 3.5+ lists the children of each thread in
+// /proc/PID/task/TID/children (if CONFIG_PROC_CHILDREN is set)
+//
+bool procinfo_children_supported() {
+    static int supported = -1;
+    if (supported < 0) {
+        char path[MAXPATHLEN];
+        int pid = getpid();
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/children", pid, pid);
+        supported = (access(path, R_OK) == 0)?1:0;
+    }
+    return supported != 0;
+}
+
+// add a process and its descendants to the map
+//
+static void add_proc_tree(PROC_MAP& pm, int pid, int self_pid) {
+    char path[MAXPATHLEN], buf[64];
+    PROCINFO p;
+
+    if (pm.find(pid) != pm.end()) return;
+    snprintf(buf, sizeof(buf), "%d", pid);
+    if (proc_stat_info(buf, self_pid, p)) return;
+    pm.insert(std::pair<int, PROCINFO>(p.id, p));
+
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    vector<int> children;
+    while (1) {
+        dirent* tdir = readdir(dir);
+        if (!tdir) break;
+        if (!isdigit(tdir->d_name[0])) continue;
+        snprintf(path, sizeof(path), "/proc/%d/task/%s/children", pid, tdir->d_name);
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        int child;
+        while (fscanf(f, "%d", &child) == 1) {
+            children.push_back(child);
+        }
+        fclose(f);
+    }
+    closedir(dir);
+    for (unsigned int i=0; i<children.size(); i++) {
+        add_proc_tree(pm, children[i], self_pid);
+    }
+}
+
+// build table of the given processes and their descendants
+//
+int procinfo_setup_pids(PROC_MAP& pm, vector<int>& pids) {
+    int self_pid = getpid();
+    for (unsigned int i=0; i<pids.size(); i++) {
+        add_proc_tree(pm, pids[i], self_pid);
+    }
+    find_children(pm);
+    return 0;
+}
+
+// get total CPU time (all processes) from the first line of /proc/stat:
+// cpu user nice system idle iowait irq softirq ...
+// "nice" is the user time of processes with positive nice values
+// (such as BOINC apps).
+//
+int procinfo_system_cpu(double& busy, double& nice) {
+    unsigned long long user, nic, sys, idle, iowait, irq, softirq;
+    char buf[256];
+
+    FILE* f = fopen("/proc/stat", "r");
+    if (!f) return ERR_FOPEN;
+    char* p = fgets(buf, sizeof(buf), f);
+    fclose(f);
+    if (!p) return ERR_NULL;
+    int n = sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu",
+        &user, &nic, &sys, &idle, &iowait, &irq, &softirq
+    );
+    if (n != 7) return ERR_XML_PARSE;
+
+    // times are in jiffies, need seconds
+    // assumes 100 jiffies per second (as above)
+    //
+    busy = (user + nic + sys + irq + softirq) / 100.;
+    nice = nic / 100.;
+    return 0;
+}
+#endif
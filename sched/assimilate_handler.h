@@ -36,3 +36,11 @@ extern int assimilate_handler(
 
 extern int assimilate_handler_init(int argc, char** argv);
 extern void assimilate_handler_usage();
+
+// If the assimilator is run with --nthreads N,
+// assimilate_handler() is called from N threads at once,
+// so it must be thread-safe.
+// If it uses the DB, it must use this thread's connection, e.g.
+//    DB_RESULT result(assimilate_handler_db());
+//
+extern DB_CONN* assimilate_handler_db();
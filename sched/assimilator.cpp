@@ -22,9 +22,12 @@
 #include "config.h"
 #include <cstring>
 #include <cstdlib>
+#include <csignal>
 #include <unistd.h>
 #include <ctime>
+#include <deque>
 #include <vector>
+#include <pthread.h>
 
 #include "boinc_db.h"
 #include "parse.h"
@@ -40,6 +43,7 @@
 #include "assimilate_handler.h"
 
 using std::vector;
+using std::deque;
 
 #define LOCKFILE "assimilator.out"
 #define PIDFILE  "assimilator.pid"
@@ -49,6 +53,7 @@ bool update_db = true;
 int wu_id_modulus=0, wu_id_remainder=0;
 int sleep_interval = SLEEP_INTERVAL;
 int one_pass_N_WU=0;
+int nthreads=0;
 
 void usage(char* name) {
     fprintf(stderr,
@@ -66,6 +71,7 @@ void usage(char* name) {
         "    [--one_pass_N_WU N]   Process at most N jobs\n"
         "    [-d | --debug_level N]       Set verbosity level (1 to 4)\n"
         "    [--dont_update_db]    Don't update BOINC DB (for testing)\n"
+        "    [--nthreads N]        Run N handlers at once (handler must be thread-safe)\n"
         "    [-h | --help]                 Show this\n"
         "    [-v | --version]      Show version information\n"
         "\n",
@@ -74,6 +80,256 @@ void usage(char* name) {
     assimilate_handler_usage();
 }
 
+// statistics, logged after a SIGUSR1
+//
+struct ASSIMILATOR_STATS {
+    double start_time;
+    int nassimilated;
+    int ndeferred;
+    double handler_time;    // total time in assimilate_handler()
+    double handler_time_max;
+    double latency;         // total time from enumeration to DB update
+    double latency_max;
+};
+
+static ASSIMILATOR_STATS stats;
+static volatile sig_atomic_t stats_requested = 0;
+
+////////// pooled mode (--nthreads N) //////////
+//
+// The main thread enumerates WUs and their results,
+// and queues them for N worker threads,
+// which call assimilate_handler().
+// At most 2*N WUs are in progress at once.
+// The main thread updates assimilate_state in the order the WUs
+// were enumerated, so if we exit (e.g. on a handler error)
+// the WUs that are marked as done are a prefix of the enumeration.
+//
+// Each worker has its own DB connection;
+// a handler that uses the DB gets it with assimilate_handler_db().
+
+struct ASSIMILATE_ITEM {
+    DB_WORKUNIT wu;
+    vector<RESULT> results;
+    RESULT canonical_result;
+    double enum_time;       // when we enumerated the WU
+    double handler_time;
+    int retval;
+    bool done;
+};
+
+static deque<ASSIMILATE_ITEM*> work_queue;
+    // items not yet started by a worker
+static deque<ASSIMILATE_ITEM*> in_progress;
+    // items not yet finished by the main thread, in enumeration order
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+static __thread DB_CONN* thread_db = NULL;
+static int nworkers_started = 0;
+    // workers that have tried to open their DB connection
+static int worker_db_retval = 0;
+
+DB_CONN* assimilate_handler_db() {
+    return thread_db ? thread_db : &boinc_db;
+}
+
+static void* worker_thread(void*) {
+    thread_db = new DB_CONN;
+    int retval = thread_db->open(
+        config.db_name, config.db_host, config.db_user, config.db_passwd
+    );
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "worker can't open DB: %s\n", boincerror(retval)
+        );
+        delete thread_db;
+        thread_db = NULL;
+    }
+
+    // tell the main thread (see start_workers())
+    //
+    pthread_mutex_lock(&queue_mutex);
+    nworkers_started++;
+    if (retval) worker_db_retval = retval;
+    pthread_cond_broadcast(&done_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    if (retval) return NULL;
+
+    while (1) {
+        pthread_mutex_lock(&queue_mutex);
+        while (work_queue.empty()) {
+            pthread_cond_wait(&work_cond, &queue_mutex);
+        }
+        ASSIMILATE_ITEM* item = work_queue.front();
+        work_queue.pop_front();
+        pthread_mutex_unlock(&queue_mutex);
+
+        double t = dtime();
+        item->retval = assimilate_handler(
+            item->wu, item->results, item->canonical_result
+        );
+        item->handler_time = dtime() - t;
+
+        pthread_mutex_lock(&queue_mutex);
+        item->done = true;
+        pthread_cond_broadcast(&done_cond);
+        pthread_mutex_unlock(&queue_mutex);
+    }
+    return NULL;
+}
+
+static void start_workers() {
+    for (int i=0; i<nthreads; i++) {
+        pthread_t t;
+        int retval = pthread_create(&t, NULL, worker_thread, NULL);
+        if (retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "can't create worker thread: %d\n", retval
+            );
+            exit(1);
+        }
+    }
+
+    // wait until the workers have opened their DB connections;
+    // if any couldn't, exit before assimilating anything
+    //
+    pthread_mutex_lock(&queue_mutex);
+    while (nworkers_started < nthreads) {
+        pthread_cond_wait(&done_cond, &queue_mutex);
+    }
+    int retval = worker_db_retval;
+    pthread_mutex_unlock(&queue_mutex);
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "handler threads can't open DB; exiting\n"
+        );
+        exit(1);
+    }
+}
+
+// record the result of the handler for a WU
+//
+static void finish_wu(
+    DB_WORKUNIT& wu, int retval, double handler_time, double enum_time
+) {
+    char buf[256];
+
+    if (retval && retval != DEFER_ASSIMILATION) {
+        log_messages.printf(MSG_CRITICAL,
+            "[%s] handler error: %s; exiting\n", wu.name, boincerror(retval)
+        );
+        exit(retval);
+    }
+
+    if (update_db) {
+        // Defer assimilation until next result is returned
+        int assimilate_state = ASSIMILATE_DONE;
+        if (retval == DEFER_ASSIMILATION) {
+            assimilate_state = ASSIMILATE_INIT;
+        }
+        sprintf(
+            buf, "assimilate_state=%d, transition_time=%d",
+            assimilate_state, (int)time(0)
+        );
+        int retval2 = wu.update_field(buf);
+        if (retval2) {
+            log_messages.printf(MSG_CRITICAL,
+                "[%s] update failed: %s\n", wu.name, boincerror(retval2)
+            );
+            exit(1);
+        }
+    }
+
+    double latency = dtime() - enum_time;
+    if (retval == DEFER_ASSIMILATION) {
+        stats.ndeferred++;
+    } else {
+        stats.nassimilated++;
+    }
+    stats.handler_time += handler_time;
+    if (handler_time > stats.handler_time_max) {
+        stats.handler_time_max = handler_time;
+    }
+    stats.latency += latency;
+    if (latency > stats.latency_max) {
+        stats.latency_max = latency;
+    }
+}
+
+// finish in-progress items, in order, as long as they're done.
+// If there are max_in_progress or more, wait until there are fewer.
+//
+static void finish_items(size_t max_in_progress) {
+    while (1) {
+        pthread_mutex_lock(&queue_mutex);
+        if (in_progress.empty()) {
+            pthread_mutex_unlock(&queue_mutex);
+            return;
+        }
+        ASSIMILATE_ITEM* item = in_progress.front();
+        if (!item->done) {
+            if (in_progress.size() < max_in_progress) {
+                pthread_mutex_unlock(&queue_mutex);
+                return;
+            }
+            while (!item->done) {
+                pthread_cond_wait(&done_cond, &queue_mutex);
+            }
+        }
+        in_progress.pop_front();
+        pthread_mutex_unlock(&queue_mutex);
+
+        finish_wu(item->wu, item->retval, item->handler_time, item->enum_time);
+        delete item;
+    }
+}
+
+static void queue_item(ASSIMILATE_ITEM* item) {
+    finish_items(2*nthreads);
+    pthread_mutex_lock(&queue_mutex);
+    work_queue.push_back(item);
+    in_progress.push_back(item);
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+static void stats_signal_handler(int) {
+    stats_requested = 1;
+}
+
+// if SIGUSR1 was caught, log statistics.
+// Called from the main thread
+//
+static void check_show_stats() {
+    if (!stats_requested) return;
+    stats_requested = 0;
+    double dt = dtime() - stats.start_time;
+    int n = stats.nassimilated + stats.ndeferred;
+    log_messages.printf(MSG_NORMAL,
+        "assimilator stats: %.0f sec, %d assimilated, %d deferred (%.2f/sec)\n",
+        dt, stats.nassimilated, stats.ndeferred, dt>0?n/dt:0.
+    );
+    if (n) {
+        log_messages.printf(MSG_NORMAL,
+            "   handler time: avg %.3f max %.3f; latency: avg %.3f max %.3f sec\n",
+            stats.handler_time/n, stats.handler_time_max,
+            stats.latency/n, stats.latency_max
+        );
+    }
+    if (nthreads) {
+        pthread_mutex_lock(&queue_mutex);
+        int nin_progress = (int)in_progress.size();
+        int nwaiting = (int)work_queue.size();
+        pthread_mutex_unlock(&queue_mutex);
+        log_messages.printf(MSG_NORMAL,
+            "   %d threads; %d WUs in progress, %d waiting for a thread\n",
+            nthreads, nin_progress, nwaiting
+        );
+    }
+}
+
 // assimilate all WUs that need it
 // return nonzero (true) if did anything
 //
@@ -111,6 +367,7 @@ bool do_pass(APP& app) {
             break;
         }
         vector<RESULT> results;     // must be inside while()!
+        double enum_time = dtime();
 
         // for testing purposes, pretend we did nothing
         //
@@ -157,36 +414,27 @@ bool do_pass(APP& app) {
             wu.update_field(buf);
         }
 
-        retval = assimilate_handler(wu, results, canonical_result);
-        if (retval && retval != DEFER_ASSIMILATION) {
-            log_messages.printf(MSG_CRITICAL,
-                "[%s] handler error: %s; exiting\n", wu.name, boincerror(retval)
-            );
-            exit(retval);
-        }
-
-        if (update_db) {
-            // Defer assimilation until next result is returned
-            int assimilate_state = ASSIMILATE_DONE;
-            if (retval == DEFER_ASSIMILATION) {
-                assimilate_state = ASSIMILATE_INIT;
-            }
-            sprintf(
-                buf, "assimilate_state=%d, transition_time=%d",
-                assimilate_state, (int)time(0)
-            );
-            retval = wu.update_field(buf);
-            if (retval) {
-                log_messages.printf(MSG_CRITICAL,
-                    "[%s] update failed: %s\n", wu.name, boincerror(retval)
-                );
-                exit(1);
-            }
+        if (nthreads) {
+            ASSIMILATE_ITEM* item = new ASSIMILATE_ITEM;
+            item->wu = wu;
+            item->results = results;
+            item->canonical_result = canonical_result;
+            item->enum_time = enum_time;
+            item->done = false;
+            queue_item(item);
+        } else {
+            double t = dtime();
+            retval = assimilate_handler(wu, results, canonical_result);
+            finish_wu(wu, retval, dtime()-t, enum_time);
         }
 
         num_assimilated++;
+        check_show_stats();
 
     }
+    if (nthreads) {
+        finish_items(1);
+    }
 
     if (did_something) {
         boinc_db.commit_transaction();
@@ -256,6 +504,12 @@ int main(int argc, char** argv) {
             // your assimilator over and over again without affecting
             // your project.
             update_db = false;
+        } else if (is_arg(argv[i], "nthreads")) {
+            if (!argv[++i]) {
+                missing_argument(argv[0], argv[--i]);
+                exit(1);
+            }
+            nthreads = atoi(argv[i]);
         } else if (is_arg(argv[i], "mod")) {
             if (!argv[++i]) {
                 missing_argument(argv[0], argv[--i]);
@@ -318,6 +572,14 @@ int main(int argc, char** argv) {
     log_messages.printf(MSG_NORMAL, "Starting assimilator handler\n");
 
     install_stop_signal_handler();
+    stats.start_time = dtime();
+    signal(SIGUSR1, stats_signal_handler);
+    if (nthreads) {
+        log_messages.printf(MSG_NORMAL,
+            "Using %d handler threads\n", nthreads
+        );
+        start_workers();
+    }
     // coverity[loop_top] - infinite loop is intended
     do {
         if (!do_pass(app)) {
@@ -325,6 +587,7 @@ int main(int argc, char** argv) {
                 daemon_sleep(sleep_interval);
             }
         }
+        check_show_stats();
         check_stop_daemons();
     } while (!one_pass);
 }
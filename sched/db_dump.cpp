@@ -24,6 +24,22 @@
 //    as described in the default db_dump_spec.xml that is created for you.
 // 2) should scrap this and replace it with a 100 line PHP script.
 //    I'll get to this someday.
+//
+// Incremental mode (--incremental):
+// a full dump records its start time in a state file (STATE_FILENAME).
+// Later runs write, for each enumeration, a single delta file
+// (the enumeration's filename + "_delta") containing only rows
+// created or given credit since the last full dump
+// (for hosts, also rows that have done an RPC since then),
+// and link the full-dump files from the previous output
+// into the new one.
+// So the full files plus the delta files describe the current state;
+// rows in the delta files supersede those with the same ID.
+// A full dump is done if there's no state file,
+// or the last one is older than --full_interval days.
+//
+// --nworkers N runs the enumerations in N child processes,
+// each with its own DB connection.
 
 #include "config.h"
 #include <cstdio>
@@ -32,6 +48,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <string>
 #include <vector>
 
@@ -53,6 +70,8 @@ using std::string;
 using std::vector;
 
 #define LOCKFILE "db_dump.out"
+#define STATE_FILENAME "db_dump_state"
+#define DELTA_SUFFIX "_delta"
 
 #define COMPRESSION_NONE    0
 #define COMPRESSION_GZIP    1
@@ -78,6 +97,8 @@ const char* tag_name[NUM_TABLES] = {"users", "teams", "hosts", "users_deleted",
 int nusers, nhosts, nteams, nusers_deleted, nhosts_deleted;
 double total_credit;
 bool have_badges = false;
+double delta_since = 0;
+    // if nonzero, write only rows changed since this time
 
 struct OUTPUT {
     int recs_per_file;
@@ -718,12 +739,23 @@ int tables_file(char* dir) {
     if (config.credit_by_app) {
         fprintf(zf.f, "    <credit_by_app/>\n");
     }
-    if (nusers) fprintf(zf.f, "    <nusers_total>%d</nusers_total>\n", nusers);
-    if (nteams) fprintf(zf.f, "    <nteams_total>%d</nteams_total>\n", nteams);
-    if (nhosts) fprintf(zf.f, "    <nhosts_total>%d</nhosts_total>\n", nhosts);
-    if (nusers_deleted) fprintf(zf.f, "    <nusers_deleted_total>%d</nusers_deleted_total>\n", nusers_deleted);
-    if (nhosts_deleted) fprintf(zf.f, "    <nhosts_deleted_total>%d</nhosts_deleted_total>\n", nhosts_deleted);
-    if (total_credit) fprintf(zf.f, "    <total_credit>%lf</total_credit>\n", total_credit);
+    if (delta_since) {
+        // counts are of the rows in the delta files
+        //
+        fprintf(zf.f, "    <delta_since>%d</delta_since>\n", (int)delta_since);
+        if (nusers) fprintf(zf.f, "    <nusers_delta>%d</nusers_delta>\n", nusers);
+        if (nteams) fprintf(zf.f, "    <nteams_delta>%d</nteams_delta>\n", nteams);
+        if (nhosts) fprintf(zf.f, "    <nhosts_delta>%d</nhosts_delta>\n", nhosts);
+        if (nusers_deleted) fprintf(zf.f, "    <nusers_deleted_delta>%d</nusers_deleted_delta>\n", nusers_deleted);
+        if (nhosts_deleted) fprintf(zf.f, "    <nhosts_deleted_delta>%d</nhosts_deleted_delta>\n", nhosts_deleted);
+    } else {
+        if (nusers) fprintf(zf.f, "    <nusers_total>%d</nusers_total>\n", nusers);
+        if (nteams) fprintf(zf.f, "    <nteams_total>%d</nteams_total>\n", nteams);
+        if (nhosts) fprintf(zf.f, "    <nhosts_total>%d</nhosts_total>\n", nhosts);
+        if (nusers_deleted) fprintf(zf.f, "    <nusers_deleted_total>%d</nusers_deleted_total>\n", nusers_deleted);
+        if (nhosts_deleted) fprintf(zf.f, "    <nhosts_deleted_total>%d</nhosts_deleted_total>\n", nhosts_deleted);
+        if (total_credit) fprintf(zf.f, "    <total_credit>%lf</total_credit>\n", total_credit);
+    }
     print_apps(zf.f);
     print_badges(zf.f);
     zf.close();
@@ -738,14 +770,17 @@ int ENUMERATION::make_it_happen(char* output_dir) {
     DB_TEAM team;
     DB_HOST host;
     DB_HOST_DELETED host_deleted;
-    char clause[256];
+    char clause[512], where[256];
     char path[MAXPATHLEN];
 
     sprintf(path, "%s/%s", output_dir, filename);
+    if (delta_since) {
+        strcat(path, DELTA_SUFFIX);
+    }
 
     for (i=0; i<outputs.size(); i++) {
         OUTPUT& out = outputs[i];
-        if (out.recs_per_file) {
+        if (out.recs_per_file && !delta_since) {
             out.nzfile = new NUMBERED_ZFILE(
                 tag_name[table], out.compression, path, out.recs_per_file
             );
@@ -754,18 +789,34 @@ int ENUMERATION::make_it_happen(char* output_dir) {
             out.zfile->open(path);
         }
     }
+    strcpy(where, "where total_credit > 0");
+    if (delta_since) {
+        char buf[256];
+        if (table == TABLE_HOST) {
+            sprintf(buf,
+                " and (expavg_time > %f or create_time > %d or rpc_time > %d)",
+                delta_since, (int)delta_since, (int)delta_since
+            );
+        } else {
+            sprintf(buf,
+                " and (expavg_time > %f or create_time > %d)",
+                delta_since, (int)delta_since
+            );
+        }
+        strcat(where, buf);
+    }
     switch(sort) {
     case SORT_NONE:
-        strcpy(clause, "where total_credit > 0");
+        strcpy(clause, where);
         break;
     case SORT_ID:
-        strcpy(clause, "where total_credit > 0 order by id");
+        sprintf(clause, "%s order by id", where);
         break;
     case SORT_TOTAL_CREDIT:
-        strcpy(clause, "where total_credit > 0 order by total_credit desc");
+        sprintf(clause, "%s order by total_credit desc", where);
         break;
     case SORT_EXPAVG_CREDIT:
-        strcpy(clause, "where total_credit > 0 order by expavg_credit desc");
+        sprintf(clause, "%s order by expavg_credit desc", where);
         break;
     }
     switch(table) {
@@ -779,7 +830,7 @@ int ENUMERATION::make_it_happen(char* output_dir) {
             total_credit += user.total_credit;
             for (i=0; i<outputs.size(); i++) {
                 OUTPUT& out = outputs[i];
-                if (sort == SORT_ID && out.recs_per_file) {
+                if (sort == SORT_ID && out.nzfile) {
                     out.nzfile->set_id(n++);
                 }
                 if (out.zfile) {
@@ -799,12 +850,19 @@ int ENUMERATION::make_it_happen(char* output_dir) {
     case TABLE_USER_DELETED:
         n = 0;
         while (1) {
-            retval = user_deleted.enumerate("order by userid");
+            if (delta_since) {
+                sprintf(clause,
+                    "where create_time > %f order by userid", delta_since
+                );
+            } else {
+                strcpy(clause, "order by userid");
+            }
+            retval = user_deleted.enumerate(clause);
             if (retval) break;
             nusers_deleted++;
             for (i=0; i<outputs.size(); i++) {
                 OUTPUT& out = outputs[i];
-                if (sort == SORT_ID && out.recs_per_file) {
+                if (sort == SORT_ID && out.nzfile) {
                     out.nzfile->set_id(n++);
                 }
                 if (out.zfile) {
@@ -831,7 +889,7 @@ int ENUMERATION::make_it_happen(char* output_dir) {
             nhosts++;
             for (i=0; i<outputs.size(); i++) {
                 OUTPUT& out = outputs[i];
-                if (sort == SORT_ID && out.recs_per_file) {
+                if (sort == SORT_ID && out.nzfile) {
                     out.nzfile->set_id(n++);
                 }
                 if (out.zfile) {
@@ -851,12 +909,19 @@ int ENUMERATION::make_it_happen(char* output_dir) {
     case TABLE_HOST_DELETED:
         n = 0;
         while(1) {
-            retval = host_deleted.enumerate("order by hostid");
+            if (delta_since) {
+                sprintf(clause,
+                    "where create_time > %f order by hostid", delta_since
+                );
+            } else {
+                strcpy(clause, "order by hostid");
+            }
+            retval = host_deleted.enumerate(clause);
             if (retval) break;
             nhosts_deleted++;
             for (i=0; i<outputs.size(); i++) {
                 OUTPUT& out = outputs[i];
-                if (sort == SORT_ID && out.recs_per_file) {
+                if (sort == SORT_ID && out.nzfile) {
                     out.nzfile->set_id(n++);
                 }
                 if (out.zfile) {
@@ -881,7 +946,7 @@ int ENUMERATION::make_it_happen(char* output_dir) {
             nteams++;
             for (i=0; i<outputs.size(); i++) {
                 OUTPUT& out = outputs[i];
-                if (sort == SORT_ID && out.recs_per_file) {
+                if (sort == SORT_ID && out.nzfile) {
                     out.nzfile->set_id(n++);
                 }
                 if (out.zfile) {
@@ -913,6 +978,154 @@ int ENUMERATION::make_it_happen(char* output_dir) {
     return 0;
 }
 
+void open_db(char* db_host, int retry_period) {
+    int retval;
+
+    while ((retval = boinc_db.open(
+        config.replica_db_name,
+        db_host?db_host:config.replica_db_host,
+        config.replica_db_user,
+        config.replica_db_passwd
+    ))) {
+        log_messages.printf(MSG_CRITICAL, "Can't open DB: %d\n", retval);
+        if (retry_period == 0) exit(1);
+	boinc_sleep(retry_period);
+    }
+    retval = boinc_db.set_isolation_level(READ_UNCOMMITTED);
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "boinc_db.set_isolation_level: %s; %s\n",
+            boincerror(retval), boinc_db.error_string()
+        );
+    }
+}
+
+// Run the enumerations in nworkers child processes,
+// each with its own DB connection.
+// Each child writes its row counts to a file in the output dir;
+// add them up for the tables file.
+//
+void run_enumerations_parallel(
+    DUMP_SPEC& spec, int nworkers, char* db_host, int retry_period
+) {
+    vector<int> pids;
+    char path[MAXPATHLEN];
+    unsigned int j;
+    int k, status;
+
+    for (k=0; k<nworkers; k++) {
+        fflush(stdout);
+        fflush(stderr);
+        int pid = fork();
+        if (pid < 0) {
+            log_messages.printf(MSG_CRITICAL, "fork() failed: %d\n", errno);
+            exit(1);
+        }
+        if (pid == 0) {
+            log_messages.pid = getpid();
+            open_db(db_host, retry_period);
+            for (j=k; j<spec.enumerations.size(); j+=nworkers) {
+                spec.enumerations[j].make_it_happen(spec.output_dir);
+            }
+            sprintf(path, "%s/.counts_%d", spec.output_dir, k);
+            FILE* f = fopen(path, "w");
+            if (!f) exit(ERR_FOPEN);
+            fprintf(f, "%d %d %d %d %d %f\n",
+                nusers, nteams, nhosts, nusers_deleted, nhosts_deleted,
+                total_credit
+            );
+            fclose(f);
+            exit(0);
+        }
+        pids.push_back(pid);
+    }
+    bool failed = false;
+    for (k=0; k<nworkers; k++) {
+        waitpid(pids[k], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            log_messages.printf(MSG_CRITICAL,
+                "worker %d (PID %d) failed: status %d\n", k, pids[k], status
+            );
+            failed = true;
+        }
+    }
+    if (failed) exit(1);
+
+    for (k=0; k<nworkers; k++) {
+        int nu, nt, nh, nud, nhd;
+        double tc;
+        sprintf(path, "%s/.counts_%d", spec.output_dir, k);
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        if (fscanf(f, "%d %d %d %d %d %lf", &nu, &nt, &nh, &nud, &nhd, &tc) == 6) {
+            nusers += nu;
+            nteams += nt;
+            nhosts += nh;
+            nusers_deleted += nud;
+            nhosts_deleted += nhd;
+            total_credit += tc;
+        }
+        fclose(f);
+        unlink(path);
+    }
+}
+
+// return the start time of the last full dump, or zero if none
+//
+double read_state_file() {
+    double t = 0;
+    FILE* f = fopen(config.project_path(STATE_FILENAME), "r");
+    if (!f) return 0;
+    if (fscanf(f, "%lf", &t) != 1) t = 0;
+    fclose(f);
+    return t;
+}
+
+void write_state_file(double t) {
+    char path[MAXPATHLEN], tmp_path[MAXPATHLEN];
+    safe_strcpy(path, config.project_path(STATE_FILENAME));
+    sprintf(tmp_path, "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) {
+        log_messages.printf(MSG_CRITICAL, "Can't write %s\n", tmp_path);
+        return;
+    }
+    fprintf(f, "%f\n", t);
+    fclose(f);
+    rename(tmp_path, path);
+}
+
+// In incremental mode, link the full-dump files of the enumerations
+// from the previous output directory into the new one
+//
+void link_full_files(DUMP_SPEC& spec) {
+    DirScanner dir(spec.final_output_dir);
+    string name;
+    char old_path[MAXPATHLEN], new_path[MAXPATHLEN];
+    unsigned int j;
+
+    while (dir.scan(name)) {
+        if (strstr(name.c_str(), DELTA_SUFFIX)) continue;
+        bool found = false;
+        for (j=0; j<spec.enumerations.size(); j++) {
+            const char* fn = spec.enumerations[j].filename;
+            if (!strncmp(name.c_str(), fn, strlen(fn))) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) continue;
+        sprintf(old_path, "%s/%s", spec.final_output_dir, name.c_str());
+        sprintf(new_path, "%s/%s", spec.output_dir, name.c_str());
+        if (link(old_path, new_path) && boinc_copy(old_path, new_path)) {
+            log_messages.printf(MSG_CRITICAL,
+                "Can't link or copy %s to %s\n", old_path, new_path
+            );
+            exit(1);
+        }
+    }
+}
+
 void usage(char* name) {
     fprintf(stderr,
         "This program generates XML files containing project statistics.\n"
@@ -924,6 +1137,9 @@ void usage(char* name) {
         "    [-d N | --debug_level]        Set verbosity level (1 to 4)\n"
         "    [--db_host H]                 Use the DB server on host H\n"
         "    [--retry_period H]            When can't connect to DB, retry after N sec instead of terminating\n"
+        "    [--incremental]               Write only rows changed since the last full dump\n"
+        "    [--full_interval D]           In incremental mode, do a full dump every D days (default 7)\n"
+        "    [--nworkers N]                Run the enumerations in N processes\n"
         "    [-h | --help]                 Show this\n"
         "    [-v | --version]              Show version information\n",
         name
@@ -937,6 +1153,10 @@ int main(int argc, char** argv) {
     char spec_filename[256], buf[256];
     FILE_LOCK file_lock;
     int retry_period = 0;
+    bool incremental = false;
+    double full_interval = 7;
+    int nworkers = 0;
+    double start_time = dtime();
 
     check_stop_daemons();
     setbuf(stderr, 0);
@@ -961,6 +1181,22 @@ int main(int argc, char** argv) {
             retry_period = atoi(argv[i]);
             if (retry_period < 0) retry_period = 0;
             if (retry_period > 1000000) retry_period = 1000000;
+        } else if (is_arg(argv[i], "incremental")) {
+            incremental = true;
+        } else if (is_arg(argv[i], "full_interval")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            full_interval = atof(argv[i]);
+        } else if (is_arg(argv[i], "nworkers")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            nworkers = atoi(argv[i]);
         } else if (is_arg(argv[i], "d") || is_arg(argv[i], "debug_level")) {
             if (!argv[++i]) {
                 log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
@@ -1035,30 +1271,38 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
-    while ((retval = boinc_db.open(
-        config.replica_db_name,
-        db_host?db_host:config.replica_db_host,
-        config.replica_db_user,
-        config.replica_db_passwd
-    ))) {
-        log_messages.printf(MSG_CRITICAL, "Can't open DB: %d\n", retval);
-        if (retry_period == 0) exit(1);
-	boinc_sleep(retry_period);
-    }
-    retval = boinc_db.set_isolation_level(READ_UNCOMMITTED);
-    if (retval) {
-        log_messages.printf(MSG_CRITICAL,
-            "boinc_db.set_isolation_level: %s; %s\n",
-            boincerror(retval), boinc_db.error_string()
-        );
+    if (incremental) {
+        double last_full = read_state_file();
+        if (last_full
+            && start_time < last_full + full_interval*86400
+            && boinc_file_exists(spec.final_output_dir)
+        ) {
+            delta_since = last_full;
+            log_messages.printf(MSG_NORMAL,
+                "Incremental dump of changes since %s\n",
+                time_to_string(delta_since)
+            );
+        } else {
+            log_messages.printf(MSG_NORMAL, "Doing full dump\n");
+        }
     }
 
     boinc_mkdir(spec.output_dir);
 
-    unsigned int j;
-    for (j=0; j<spec.enumerations.size(); j++) {
-        ENUMERATION& e = spec.enumerations[j];
-        e.make_it_happen(spec.output_dir);
+    if (nworkers > 1) {
+        run_enumerations_parallel(spec, nworkers, db_host, retry_period);
+        open_db(db_host, retry_period);
+    } else {
+        open_db(db_host, retry_period);
+        unsigned int j;
+        for (j=0; j<spec.enumerations.size(); j++) {
+            ENUMERATION& e = spec.enumerations[j];
+            e.make_it_happen(spec.output_dir);
+        }
+    }
+
+    if (delta_since) {
+        link_full_files(spec);
     }
 
     if (config.credit_by_app) {
@@ -1123,6 +1367,9 @@ int main(int argc, char** argv) {
         log_messages.printf(MSG_CRITICAL, "Can't rename new stats\n");
         exit(1);
     }
+    if (incremental && !delta_since) {
+        write_state_file(start_time);
+    }
     log_messages.printf(MSG_NORMAL, "db_dump finished\n");
 }
 
@@ -28,6 +28,23 @@
 // where TIME is the time it was created.
 // In addition generate index files associating each WU and result ID
 // with the timestamp of the file it's in.
+// If --mod is used (or implied by --nworkers) the names also include
+// the modulus and remainder, e.g. wu_archive_TIME_4_1.
+//
+// With --binary the archives are written in a compact binary format
+// instead of XML (see write_binary_record() below).
+// The files have a .bin extension;
+// the index files consist of (ID, file offset) pairs,
+// so a given record can be read directly.
+//
+// With --batch_size N, N WUs and their results are archived
+// and then deleted from the DB with one query per table.
+//
+// With --resume, WUs are scanned in ID order and the ID of the last
+// WU purged is saved in a checkpoint file (db_purge_checkpoint*),
+// so that a restarted db_purge continues where it left off
+// rather than rescanning the workunit table.
+// When the scan reaches the end of the table it starts over.
 
 #include "config.h"
 #include <cstdio>
@@ -41,6 +58,7 @@
 #include <time.h>
 #include <errno.h>
 #include <string.h>
+#include <vector>
 #include "zlib.h"
 
 #include "boinc_db.h"
@@ -57,6 +75,9 @@
 #include "error_numbers.h"
 #include "str_util.h"
 
+using std::string;
+using std::vector;
+
 void usage() {
     fprintf(stderr,
         "Purge workunit and result records that are no longer needed.\n\n"
@@ -70,6 +91,10 @@ void usage() {
         "    [--no_archive]                Don't write output files, just purge\n"
         "    [--daily_dir]                 Write archives in a new directory each day\n"
         "    [--max_wu_per_file N]         Write at most N WUs per output file\n"
+        "    [--binary]                    Write archives in compact binary format, with binary index\n"
+        "    [--batch_size N]              Archive and delete N WUs at a time (default 1)\n"
+        "    [--resume]                    Scan WUs in ID order and checkpoint progress\n"
+        "    [--nworkers N]                Use N worker processes\n"
         "    [--sleep N]                   Sleep N sec after DB scan\n"
         "    [--one_pass]                  Make one DB scan, then exit\n"
         "    [--dont_delete]               Don't actually delete anything from the DB (for testing only)\n"
@@ -85,6 +110,10 @@ void usage() {
 #define RESULT_INDEX_FILENAME_PREFIX    "result_index"
 
 #define DB_QUERY_LIMIT                  1000
+#define CHECKPOINT_FILENAME             "db_purge_checkpoint"
+
+#define WU_BINARY_MAGIC                 "BOINCWU1"
+#define RESULT_BINARY_MAGIC             "BOINCRS1"
 
 #define COMPRESSION_NONE    0
 #define COMPRESSION_GZIP    1
@@ -242,7 +271,16 @@ int max_wu_per_file = 0;
 int wu_stored_in_file = 0;
     // keep track of how many WU archived in file so far
 int id_modulus=0, id_remainder=0;
-    // allow more than one to run - doesn't work if archiving is enabled
+    // allow more than one to run
+char name_suffix[64] = "";
+    // appended to archive and checkpoint file names if using --mod,
+    // so that instances don't collide
+bool binary_archive = false;
+int batch_size = 1;
+bool resume = false;
+DB_ID_TYPE checkpoint_wu_id = 0;
+    // if resume is set, ID of the last WU purged
+int nworkers = 0;
 char app_name[256];
 DB_APP app;
 
@@ -259,40 +297,58 @@ void fail(const char* msg) {
     exit(1);
 }
 
-// Open an archive.
-// If the user has asked for compression,
-// then we popen(2) a pipe to gzip or zip.
-// This does 'in place' compression.
+// get the path of an archive file.
+// If create_dir is set, create its daily directory if needed
 //
-void open_archive(const char* filename_prefix, void*& f){
-    char path[MAXPATHLEN];
-    char command[MAXPATHLEN+512];
-
+void archive_path(
+    const char* filename_prefix, char* path, int len, bool create_dir
+) {
+    const char* ext = binary_archive?"bin":"xml";
     if (daily_dir) {
         time_t time_time = time_int;
         char dirname[32];
         strftime(dirname, sizeof(dirname), "%Y_%m_%d", gmtime(&time_time));
-        safe_strcpy(path, config.project_path("archives/%s",dirname));
-        if (mkdir(path,0775)) {
-            if(errno!=EEXIST) {
-                char errstr[256];
-                sprintf(errstr, "could not create directory '%s': %s\n",
-                path, strerror(errno));
-                fail(errstr);
+        if (create_dir) {
+            strlcpy(path, config.project_path("archives/%s",dirname), len);
+            if (mkdir(path,0775)) {
+                if(errno!=EEXIST) {
+                    char errstr[256];
+                    sprintf(errstr, "could not create directory '%s': %s\n",
+                    path, strerror(errno));
+                    fail(errstr);
+                }
             }
         }
-        safe_strcpy(path,
+        strlcpy(path,
             config.project_path(
-                "archives/%s/%s_%d.xml", dirname, filename_prefix, time_int
-            )
+                "archives/%s/%s_%d%s.%s",
+                dirname, filename_prefix, time_int, name_suffix, ext
+            ),
+            len
         );
     } else {
-        safe_strcpy(path,
-            config.project_path("archives/%s_%d.xml", filename_prefix, time_int)
+        strlcpy(path,
+            config.project_path(
+                "archives/%s_%d%s.%s",
+                filename_prefix, time_int, name_suffix, ext
+            ),
+            len
         );
     }
     // append appropriate suffix for file type
-    safe_strcat(path, suffix[compression_type]);
+    strlcat(path, suffix[compression_type], len);
+}
+
+// Open an archive.
+// If the user has asked for compression,
+// then we popen(2) a pipe to gzip or zip.
+// This does 'in place' compression.
+//
+void open_archive(const char* filename_prefix, void*& f){
+    char path[MAXPATHLEN];
+    char command[MAXPATHLEN+512];
+
+    archive_path(filename_prefix, path, sizeof(path), true);
 
     // and construct appropriate command if needed
     if (compression_type == COMPRESSION_GZIP) {
@@ -335,7 +391,7 @@ void open_archive(const char* filename_prefix, void*& f){
         }
     }
 
-    if (compression_type != COMPRESSION_ZLIB) {
+    if (compression_type != COMPRESSION_ZLIB && !binary_archive) {
         //
         // set buffering to line buffered, since we are outputing XML on a
         // line-by-line basis.
@@ -366,22 +422,7 @@ void close_archive(const char *filename, void*& fp){
     fp = NULL;
 
     // reconstruct the filename
-    if (daily_dir) {
-        time_t time_time = time_int;
-        char dirname[32];
-        strftime(dirname, sizeof(dirname), "%Y_%m_%d", gmtime(&time_time));
-        safe_strcpy(path,
-            config.project_path(
-                  "archives/%s/%s_%d.xml", dirname, filename, time_int
-            )
-        );
-    } else {
-        safe_strcpy(path,
-            config.project_path("archives/%s_%d.xml", filename, time_int)
-        );
-    }
-    // append appropriate file type
-    safe_strcat(path, suffix[compression_type]);
+    archive_path(filename, path, sizeof(path), false);
 
     log_messages.printf(MSG_NORMAL,
         "Closed archive file %s containing records of %d workunits\n",
@@ -408,7 +449,10 @@ void open_all_archives() {
     open_archive(RESULT_FILENAME_PREFIX, re_stream);
     open_archive(RESULT_INDEX_FILENAME_PREFIX, re_index_stream);
     open_archive(WU_INDEX_FILENAME_PREFIX, wu_index_stream);
-    if (compression_type == COMPRESSION_ZLIB) {
+    if (binary_archive) {
+        fwrite(WU_BINARY_MAGIC, 1, 8, (FILE*)wu_stream);
+        fwrite(RESULT_BINARY_MAGIC, 1, 8, (FILE*)re_stream);
+    } else if (compression_type == COMPRESSION_ZLIB) {
         gzprintf((gzFile)wu_stream, "<archive>\n");
         gzprintf((gzFile)re_stream, "<archive>\n");
     } else {
@@ -422,7 +466,9 @@ void open_all_archives() {
 // pointers to indicate that files are not open.
 //
 void close_all_archives() {
-    if (compression_type == COMPRESSION_ZLIB) {
+    if (binary_archive) {
+        // no trailer
+    } else if (compression_type == COMPRESSION_ZLIB) {
         if (wu_stream) gzprintf((gzFile)wu_stream, "</archive>\n");
         if (re_stream) gzprintf((gzFile)re_stream, "</archive>\n");
     } else {
@@ -559,40 +605,289 @@ int archive_wu_gz (DB_WORKUNIT& wu) {
     return 0;
 }
 
-int purge_and_archive_results(DB_WORKUNIT& wu, int& number_results) {
-    int retval= 0;
+// Binary archive format.
+// A file starts with an 8-byte magic string
+// (WU_BINARY_MAGIC or RESULT_BINARY_MAGIC) followed by records.
+// A record is a 4-byte length (of the rest of the record)
+// followed by the fields in the same order as the XML format.
+// IDs are 8 bytes, ints are 4 bytes, doubles are 8 bytes,
+// and strings are a 4-byte length followed by the characters.
+// All numbers are in host byte order.
+// An index file is a sequence of (8-byte ID, 8-byte offset) pairs,
+// where offset is the position of the record's length field.
+//
+struct BINARY_RECORD {
+    string buf;
+
+    void put_id(DB_ID_TYPE x) {
+        unsigned long long y = x;
+        buf.append((const char*)&y, 8);
+    }
+    void put_int(int x) {
+        buf.append((const char*)&x, 4);
+    }
+    void put_double(double x) {
+        buf.append((const char*)&x, 8);
+    }
+    void put_str(const char* p) {
+        int n = (int)strlen(p);
+        put_int(n);
+        buf.append(p, n);
+    }
+};
+
+// write a record and its index entry
+//
+int write_binary_record(
+    BINARY_RECORD& rec, DB_ID_TYPE id, void* stream, void* index_stream
+) {
+    unsigned long long index_entry[2];
+    int len = (int)rec.buf.size();
+
+    index_entry[0] = id;
+    index_entry[1] = ftell((FILE*)stream);
+    if (fwrite(&len, 4, 1, (FILE*)stream) != 1) return ERR_FWRITE;
+    if (fwrite(rec.buf.data(), 1, len, (FILE*)stream) != (size_t)len) {
+        return ERR_FWRITE;
+    }
+    if (fwrite(index_entry, sizeof(index_entry), 1, (FILE*)index_stream) != 1) {
+        return ERR_FWRITE;
+    }
+    return 0;
+}
+
+int archive_result_bin(DB_RESULT& result) {
+    BINARY_RECORD rec;
+    rec.put_id(result.id);
+    rec.put_int(result.create_time);
+    rec.put_id(result.workunitid);
+    rec.put_int(result.server_state);
+    rec.put_int(result.outcome);
+    rec.put_int(result.client_state);
+    rec.put_id(result.hostid);
+    rec.put_id(result.userid);
+    rec.put_int(result.report_deadline);
+    rec.put_int(result.sent_time);
+    rec.put_int(result.received_time);
+    rec.put_str(result.name);
+    rec.put_double(result.cpu_time);
+    rec.put_str(result.xml_doc_in);
+    rec.put_str(result.xml_doc_out);
+    rec.put_str(result.stderr_out);
+    rec.put_int(result.batch);
+    rec.put_int(result.file_delete_state);
+    rec.put_int(result.validate_state);
+    rec.put_double(result.claimed_credit);
+    rec.put_double(result.granted_credit);
+    rec.put_double(result.opaque);
+    rec.put_int(result.random);
+    rec.put_int(result.app_version_num);
+    rec.put_id(result.app_version_id);
+    rec.put_id(result.appid);
+    rec.put_int(result.exit_status);
+    rec.put_id(result.teamid);
+    rec.put_int(result.priority);
+    rec.put_str(result.mod_time);
+    if (write_binary_record(rec, result.id, re_stream, re_index_stream)) {
+        fail("ERROR: writing binary result archive failed\n");
+    }
+    return 0;
+}
+
+int archive_wu_bin(DB_WORKUNIT& wu) {
+    BINARY_RECORD rec;
+    rec.put_id(wu.id);
+    rec.put_int(wu.create_time);
+    rec.put_id(wu.appid);
+    rec.put_str(wu.name);
+    rec.put_str(wu.xml_doc);
+    rec.put_int(wu.batch);
+    rec.put_double(wu.rsc_fpops_est);
+    rec.put_double(wu.rsc_fpops_bound);
+    rec.put_double(wu.rsc_memory_bound);
+    rec.put_double(wu.rsc_disk_bound);
+    rec.put_int(wu.need_validate);
+    rec.put_id(wu.canonical_resultid);
+    rec.put_double(wu.canonical_credit);
+    rec.put_int(wu.transition_time);
+    rec.put_int(wu.delay_bound);
+    rec.put_int(wu.error_mask);
+    rec.put_int(wu.file_delete_state);
+    rec.put_int(wu.assimilate_state);
+    rec.put_int(wu.hr_class);
+    rec.put_double(wu.opaque);
+    rec.put_int(wu.min_quorum);
+    rec.put_int(wu.target_nresults);
+    rec.put_int(wu.max_error_results);
+    rec.put_int(wu.max_total_results);
+    rec.put_int(wu.max_success_results);
+    rec.put_str(wu.result_template_file);
+    rec.put_int(wu.priority);
+    rec.put_str(wu.mod_time);
+    if (write_binary_record(rec, wu.id, wu_stream, wu_index_stream)) {
+        fail("ERROR: writing binary workunit archive failed\n");
+    }
+    return 0;
+}
+
+void checkpoint_path(char* path) {
+    strcpy(path, config.project_path("%s%s", CHECKPOINT_FILENAME, name_suffix));
+}
+
+void read_checkpoint() {
+    char path[MAXPATHLEN];
+    unsigned long id;
+
+    checkpoint_path(path);
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+    if (fscanf(f, "%lu", &id) == 1) {
+        checkpoint_wu_id = id;
+        log_messages.printf(MSG_NORMAL,
+            "Resuming after workunit %lu\n", id
+        );
+    }
+    fclose(f);
+}
+
+// write the checkpoint file; write a temp file and rename it,
+// so that the file is never partly written
+//
+void write_checkpoint() {
+    char path[MAXPATHLEN], tmp_path[MAXPATHLEN];
+
+    checkpoint_path(path);
+    sprintf(tmp_path, "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) {
+        log_messages.printf(MSG_CRITICAL,
+            "Can't write checkpoint file %s\n", tmp_path
+        );
+        return;
+    }
+    fprintf(f, "%lu\n", checkpoint_wu_id);
+    fclose(f);
+    rename(tmp_path, path);
+}
+
+// archive a batch of WUs and their results,
+// then delete them from the DB with one query per table
+//
+void purge_wu_batch(vector<DB_WORKUNIT>& wus, int& number_results) {
     DB_RESULT result;
+    string ids, clause;
     char buf[256];
+    int retval;
+    unsigned int i;
+
+    number_results = 0;
+    if (wus.empty()) return;
+
+    // if archives have not already been opened, then open them.
+    //
+    if (!no_archive && !wu_stream) {
+        open_all_archives();
+    }
 
-    number_results=0;
+    for (i=0; i<wus.size(); i++) {
+        sprintf(buf, "%s%lu", i?",":"", wus[i].id);
+        ids += buf;
+    }
 
-    sprintf(buf, "where workunitid=%lu", wu.id);
-    while (!result.enumerate(buf)) {
+    clause = "where workunitid in (" + ids + ")";
+    while (!result.enumerate(clause.c_str())) {
         if (!no_archive) {
-            if (compression_type == COMPRESSION_ZLIB) {
+            if (binary_archive) {
+                retval = archive_result_bin(result);
+            } else if (compression_type == COMPRESSION_ZLIB) {
                 retval = archive_result_gz(result);
             } else {
                 retval = archive_result(result);
             }
-            if (retval) return retval;
             log_messages.printf(MSG_DEBUG,
                 "Archived result [%lu] to a file\n", result.id
             );
         }
-        if (dont_delete) {
-            log_messages.printf(MSG_DEBUG,
-                "Didn't purge result [%lu] from database (-dont_delete)\n", result.id
-            );
+        number_results++;
+    }
+
+    for (i=0; i<wus.size(); i++) {
+        DB_WORKUNIT& wu = wus[i];
+        if (no_archive) break;
+        if (binary_archive) {
+            retval = archive_wu_bin(wu);
+        } else if (compression_type == COMPRESSION_ZLIB) {
+            retval= archive_wu_gz(wu);
         } else {
-            retval = result.delete_from_db();
-            if (retval) return retval;
-            log_messages.printf(MSG_DEBUG,
-                "Purged result [%lu] from database\n", result.id
+            retval= archive_wu(wu);
+        }
+        if (retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "Failed to write to XML file workunit:%lu\n", wu.id
             );
+            exit(5);
         }
-        number_results++;
+        log_messages.printf(MSG_DEBUG,
+            "Archived workunit [%lu] to a file\n", wu.id
+        );
     }
-    return 0;
+
+    // purge results and workunits from DB
+    //
+    if (dont_delete) {
+        log_messages.printf(MSG_DEBUG,
+            "Didn't purge %d workunits and %d results from database (-dont_delete)\n",
+            (int)wus.size(), number_results
+        );
+    } else {
+        clause = "workunitid in (" + ids + ")";
+        retval = result.delete_from_db_multi(clause.c_str());
+        if (retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "Can't delete results of workunits [%lu..%lu] from database:%d\n",
+                wus.front().id, wus.back().id, retval
+            );
+            exit(6);
+        }
+        if (config.enable_assignment) {
+            DB_ASSIGNMENT asg;
+            asg.delete_from_db_multi(clause.c_str());
+        }
+        clause = "id in (" + ids + ")";
+        retval = wus[0].delete_from_db_multi(clause.c_str());
+        if (retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "Can't delete workunits [%lu..%lu] from database:%d\n",
+                wus.front().id, wus.back().id, retval
+            );
+            exit(6);
+        }
+        log_messages.printf(MSG_DEBUG,
+            "Purged %d workunits and %d results from database\n",
+            (int)wus.size(), number_results
+        );
+    }
+
+    purged_workunits += wus.size();
+    wu_stored_in_file += wus.size();
+
+    if (!no_archive) {
+        fflush(NULL);
+
+        // if file has got max # of workunits, close and compress it.
+        // This sets file pointers to NULL
+        //
+        if (max_wu_per_file && wu_stored_in_file>=max_wu_per_file) {
+            close_all_archives();
+            wu_stored_in_file = 0;
+        }
+    }
+
+    if (resume) {
+        checkpoint_wu_id = wus.back().id;
+        write_checkpoint();
+    }
+    wus.clear();
 }
 
 // return true if did anything
@@ -636,10 +931,17 @@ bool do_pass() {
         sprintf(buf2, " and appid=%lu", app.id);
         strcat(buf, buf2);
     }
+    if (resume) {
+        sprintf(buf2, " and id>%lu order by id", checkpoint_wu_id);
+        strcat(buf, buf2);
+    }
     sprintf(buf2, " limit %d", DB_QUERY_LIMIT);
     strcat(buf, buf2);
 
-    int n=0;
+    int n=0, nscanned=0;
+    DB_ID_TYPE last_scanned_id = 0;
+    bool quit = false;
+    vector<DB_WORKUNIT> wus;
     while (1) {
         retval = wu.enumerate(buf);
         if (retval) {
@@ -651,80 +953,50 @@ bool do_pass() {
             }
             break;
         }
+        nscanned++;
+        last_scanned_id = wu.id;
         if (strstr(wu.name, "nodelete")) continue;
         did_something = true;
 
-        // if archives have not already been opened, then open them.
-        //
-        if (!no_archive && !wu_stream) {
-            open_all_archives();
+        wus.push_back(wu);
+        if ((int)wus.size() >= batch_size
+            || (max_number_workunits_to_purge
+                && purged_workunits + (int)wus.size() >= max_number_workunits_to_purge
+            )
+        ) {
+            do_pass_purged_workunits += wus.size();
+            purge_wu_batch(wus, n);
+            do_pass_purged_results += n;
         }
 
-        retval = purge_and_archive_results(wu, n);
-        do_pass_purged_results += n;
-
-        if (!no_archive) {
-            if (compression_type == COMPRESSION_ZLIB) {
-                retval= archive_wu_gz(wu);
-            } else {
-                retval= archive_wu(wu);
-            }
-            if (retval) {
-                log_messages.printf(MSG_CRITICAL,
-                    "Failed to write to XML file workunit:%lu\n", wu.id
-                );
-                exit(5);
-            }
-            log_messages.printf(MSG_DEBUG,
-                "Archived workunit [%lu] to a file\n", wu.id
-            );
+        if (time_to_quit()) {
+            quit = true;
+            wu.end_enumerate();
+            break;
         }
-
-        // purge workunit from DB
-        //
-        if (dont_delete) {
-            log_messages.printf(MSG_DEBUG,
-                "Didn't purge workunit [%lu] from database (-dont_delete)\n", wu.id
-            );
-        } else {
-            retval= wu.delete_from_db();
-            if (retval) {
-                log_messages.printf(MSG_CRITICAL,
-                    "Can't delete workunit [%lu] from database:%d\n",
-                    wu.id, retval
+    }
+    do_pass_purged_workunits += wus.size();
+    purge_wu_batch(wus, n);
+    do_pass_purged_results += n;
+
+    if (resume) {
+        if (!quit && nscanned < DB_QUERY_LIMIT) {
+            // we reached the end of the table;
+            // start from the beginning next time
+            //
+            if (checkpoint_wu_id) {
+                log_messages.printf(MSG_NORMAL,
+                    "Reached end of workunit table; restarting scan\n"
                 );
-                exit(6);
+                checkpoint_wu_id = 0;
+                write_checkpoint();
             }
-            if (config.enable_assignment) {
-                DB_ASSIGNMENT asg;
-                sprintf(buf2, "workunitid=%lu", wu.id);
-                asg.delete_from_db_multi(buf2);
-            }
-            log_messages.printf(MSG_DEBUG,
-                "Purged workunit [%lu] from database\n", wu.id
-            );
-        }
-
-        purged_workunits++;
-        do_pass_purged_workunits++;
-        wu_stored_in_file++;
-
-        if (!no_archive) {
-            fflush(NULL);
-
-            // if file has got max # of workunits, close and compress it.
-            // This sets file pointers to NULL
+        } else if (last_scanned_id > checkpoint_wu_id) {
+            // skip past WUs we scanned but didn't purge
             //
-            if (max_wu_per_file && wu_stored_in_file>=max_wu_per_file) {
-                close_all_archives();
-                wu_stored_in_file = 0;
-            }
+            checkpoint_wu_id = last_scanned_id;
+            write_checkpoint();
         }
-
-        if (time_to_quit()) {
-            break;
-        }
-
     }
 
     if (do_pass_purged_workunits) {
@@ -743,6 +1015,8 @@ bool do_pass() {
 
     if (do_pass_purged_workunits > DB_QUERY_LIMIT/2) {
         return true;
+    } else if (resume && nscanned == DB_QUERY_LIMIT) {
+        return true;
     } else {
         return false;
     }
@@ -801,6 +1075,31 @@ int main(int argc, char** argv) {
             max_wu_per_file = atoi(argv[i]);
         } else if (is_arg(argv[i], "no_archive")) {
             no_archive = true;
+        } else if (is_arg(argv[i], "binary")) {
+            binary_archive = true;
+        } else if (is_arg(argv[i], "resume")) {
+            resume = true;
+        } else if (is_arg(argv[i], "batch_size")) {
+            if(!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage();
+                exit(1);
+            }
+            batch_size = atoi(argv[i]);
+            if (batch_size < 1 || batch_size > DB_QUERY_LIMIT) {
+                log_messages.printf(MSG_CRITICAL,
+                    "batch_size must be between 1 and %d\n", DB_QUERY_LIMIT
+                );
+                usage();
+                exit(1);
+            }
+        } else if (is_arg(argv[i], "nworkers")) {
+            if(!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage();
+                exit(1);
+            }
+            nworkers = atoi(argv[i]);
         } else if (is_arg(argv[i], "sleep")) {
             if(!argv[++i]) {
                 log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
@@ -843,9 +1142,9 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (id_modulus && !no_archive) {
+    if (binary_archive && compression_type != COMPRESSION_NONE) {
         log_messages.printf(MSG_CRITICAL,
-            "If you use modulus, you must set no_archive\n\n"
+            "Can't use compression with binary archives\n\n"
         );
         usage();
         exit(1);
@@ -861,6 +1160,32 @@ int main(int argc, char** argv) {
 
     log_messages.printf(MSG_NORMAL, "Starting\n");
 
+    install_stop_signal_handler();
+
+    // fork before opening the DB; each worker gets its own connection
+    // and purges the WUs with (id mod nworkers) == worker index
+    //
+    if (nworkers > 1) {
+        int k = fork_workers(nworkers);
+        if (id_modulus) {
+            id_remainder += k*id_modulus;
+            id_modulus *= nworkers;
+        } else {
+            id_modulus = nworkers;
+            id_remainder = k;
+        }
+        log_messages.printf(MSG_NORMAL,
+            "worker %d: handling WUs with ID mod %d = %d\n",
+            k, id_modulus, id_remainder
+        );
+    }
+    if (id_modulus) {
+        sprintf(name_suffix, "_%d_%d", id_modulus, id_remainder);
+    }
+    if (resume) {
+        read_checkpoint();
+    }
+
     retval = boinc_db.open(
         config.db_name, config.db_host, config.db_user, config.db_passwd
     );
@@ -868,7 +1193,6 @@ int main(int argc, char** argv) {
         log_messages.printf(MSG_CRITICAL, "Can't open DB\n");
         exit(2);
     }
-    install_stop_signal_handler();
     boinc_mkdir(config.project_path("archives"));
 
     // on exit, either via the check_stop_daemons signal handler, or
@@ -32,6 +32,9 @@
 //  [ --wmod n i ]          handle only workunits with (id mod n) == i
 //                          recommended if using HR with multiple schedulers
 //  [ --sleep_interval x ]  sleep x seconds if nothing to do
+//  [ --poll_interval x ]   while sleeping, check every x seconds
+//                          (can be fractional) whether schedulers have
+//                          emptied slots, and if so refill them immediately
 //  [ --appids a1{,a2} ]    get work only for appids a1,...
 //                          (comma-separated list)
 //  [ --purge_stale x ]     remove work items from the shared memory segment
@@ -43,8 +46,8 @@
 // scan_work_array() scans the work array.
 // looking for empty slots and trying to fill them in.
 // The enumeration may return results already in the array.
-// So, for each result, we scan the entire array to make sure
-// it's not there already (can this be streamlined?)
+// So we keep a map of the result IDs in the array (results_in_array),
+// and check each enumerated result against it.
 //
 // The length of the enum (max and actual) and the number of empty
 // slots may differ; either one may be larger.
@@ -57,6 +60,9 @@
 // - If an enumerated job was already in the array,
 //   stop the scan and sleep for N seconds
 // - Otherwise immediately start another scan
+//
+// With --poll_interval, the sleep is cut short as soon as a scheduler
+// empties a slot (schedulers count these in SCHED_SHMEM::nslots_emptied).
 
 // If --allapps is used:
 // - there are separate DB enumerators for each app
@@ -106,7 +112,9 @@
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <vector>
+#include <map>
 using std::vector;
+using std::map;
 
 #include "boinc_db.h"
 #include "error_numbers.h"
@@ -121,6 +129,7 @@ using std::vector;
 #include "credit.h"
 #include "sched_config.h"
 #include "sched_shmem.h"
+#include "sched_auth_cache.h"
 #include "sched_util.h"
 #include "sched_msgs.h"
 #include "hr_info.h"
@@ -146,6 +155,14 @@ bool all_apps = false;
 int purge_stale_time = 0;
 int num_work_items = MAX_WU_RESULTS;
 int enum_limit = MAX_WU_RESULTS*2;
+double poll_interval = 0;
+
+// result IDs of jobs in the array, and the slot each one is in.
+// slot_resultids[] is the result we last put in each slot;
+// when a slot becomes empty we use it to remove the entry from the map.
+//
+map<DB_ID_TYPE, int> results_in_array;
+DB_ID_TYPE* slot_resultids;
 
 // The following defined if --allapps:
 int *enum_sizes;
@@ -170,6 +187,7 @@ void cleanup_shmem() {
     ssp->ready = false;
     detach_shmem((void*)ssp);
     destroy_shmem(config.shmem_key);
+    auth_cache_destroy();
 }
 
 int check_reread_trigger() {
@@ -182,6 +200,8 @@ int check_reread_trigger() {
             REREAD_DB_FILENAME
         );
         ssp->init(num_work_items);
+        results_in_array.clear();
+        memset(slot_resultids, 0, num_work_items*sizeof(DB_ID_TYPE));
         ssp->scan_tables();
         ssp->perf_info.get_from_db();
         int retval = unlink(config.project_path(REREAD_DB_FILENAME));
@@ -241,8 +261,7 @@ static bool get_job_from_db(
     int& enum_phase,
     int& ncollisions
 ) {
-    bool collision;
-    int retval, j, enum_size;
+    int retval, enum_size;
     char select_clause[256];
     
     if (all_apps) {
@@ -320,32 +339,32 @@ static bool get_job_from_db(
                 continue;
             }
 
-            // Check for collision (i.e. this result already is in the array)
+            // Check for collision (i.e. this result already is in the array).
+            // The map may contain results whose slots have been emptied
+            // by a scheduler since we last looked at them;
+            // these aren't collisions.
             //
-            collision = false;
-            for (j=0; j<ssp->max_wu_results; j++) {
-                if (ssp->wu_results[j].state != WR_STATE_EMPTY && ssp->wu_results[j].resultid == wi.res_id) {
+            map<DB_ID_TYPE, int>::iterator it = results_in_array.find(wi.res_id);
+            if (it != results_in_array.end()) {
+                WU_RESULT& wu_result = ssp->wu_results[it->second];
+                if (wu_result.state != WR_STATE_EMPTY && wu_result.resultid == wi.res_id) {
                     // If the result is already in shared mem,
                     // and another instance of the WU has been sent,
                     // bump the infeasible count to encourage
                     // it to get sent more quickly
                     //
-                    if (ssp->wu_results[j].infeasible_count == 0) {
+                    if (wu_result.infeasible_count == 0) {
                         if (wi.wu.hr_class > 0) {
-                            ssp->wu_results[j].infeasible_count++;
+                            wu_result.infeasible_count++;
                         }
                     }
                     ncollisions++;
-                    collision = true;
                     log_messages.printf(MSG_DEBUG,
                         "result [RESULT#%lu] already in array\n", wi.res_id
                     );
-                    break;
+                    continue;
                 }
             }
-            if (collision) {
-                continue;
-            }
 
             // if using HR, check whether we've exceeded quota for this class
             //
@@ -483,13 +502,24 @@ static bool scan_work_array(vector<DB_WORK_ITEM> &work_items) {
                     "remove result [RESULT#%lu] from slot %d because it is stale\n",
                     wu_result.resultid, i
                 );
+                // a scheduler using the job index may reserve the slot
+                // without locking; don't take it away in that case
+                //
+                if (!__sync_bool_compare_and_swap(
+                    &wu_result.state, WR_STATE_PRESENT, WR_STATE_EMPTY
+                )) {
+                    break;
+                }
                 purge_stale(wu_result);
-                wu_result.state = WR_STATE_EMPTY;
                 // fall through, refill this array slot
             } else {
                 break;
             }
         case WR_STATE_EMPTY:
+            if (slot_resultids[i]) {
+                results_in_array.erase(slot_resultids[i]);
+                slot_resultids[i] = 0;
+            }
             if (enum_phase[app_index] == ENUM_OVER) continue;
             found = get_job_from_db(
                 wi, app_index, enum_phase[app_index], ncollisions
@@ -521,6 +551,8 @@ static bool scan_work_array(vector<DB_WORK_ITEM> &work_items) {
                     wu_result.need_reliable = true;
                 }
                 wu_result.time_added_to_shared_memory = time(0);
+                results_in_array[wi.res_id] = i;
+                slot_resultids[i] = wi.res_id;
                 nadditions++;
             }
             break;
@@ -554,6 +586,34 @@ static bool scan_work_array(vector<DB_WORK_ITEM> &work_items) {
     return true;
 }
 
+// Sleep for sleep_interval seconds.
+// If --poll_interval was given, return early
+// if a scheduler empties a slot in the meantime.
+//
+static void feeder_sleep(int nemptied) {
+    if (poll_interval <= 0) {
+        daemon_sleep(sleep_interval);
+        return;
+    }
+    double now = dtime();
+    double end_time = now + sleep_interval;
+    double next_stop_check = now + 1;
+    while (now < end_time) {
+        if (ssp->nslots_emptied != nemptied) {
+            log_messages.printf(MSG_DEBUG,
+                "%d slots emptied; waking up\n", ssp->nslots_emptied - nemptied
+            );
+            return;
+        }
+        boinc_sleep(poll_interval);
+        now = dtime();
+        if (now > next_stop_check) {
+            check_stop_daemons();
+            next_stop_check = now + 1;
+        }
+    }
+}
+
 void feeder_loop() {
     vector<DB_WORK_ITEM> work_items;
     double next_av_update_time=0;
@@ -564,11 +624,19 @@ void feeder_loop() {
 
     while (1) {
         bool action;
+
+        // note the count of emptied slots before scanning,
+        // so that slots emptied during the scan will wake us up
+        //
+        int nemptied = ssp->nslots_emptied;
         if (config.dont_send_jobs) {
             action = false;
         } else {
             action = scan_work_array(work_items);
         }
+        if (ssp->job_index_enabled) {
+            ssp->build_job_index();
+        }
         ssp->ready = true;
         if (!action) {
 #ifdef GCL_SIMULATOR
@@ -580,7 +648,7 @@ void feeder_loop() {
             log_messages.printf(MSG_DEBUG,
                 "No action; sleeping %d sec\n", sleep_interval
             );
-            daemon_sleep(sleep_interval);
+            feeder_sleep(nemptied);
 #endif
         } else {
             if (config.job_size_matching) {
@@ -719,6 +787,8 @@ void usage(char *name) {
         "  [ --mod n i ]                    handle only results with (id mod n) == i\n"
         "  [ --wmod n i ]                   handle only workunits with (id mod n) == i\n"
         "  [ --sleep_interval x ]           sleep x seconds if nothing to do\n"
+        "  [ --poll_interval x ]            while sleeping, check every x seconds\n"
+        "                                   for slots emptied by schedulers\n"
         "  [ -h | --help ]                  Shows this help text.\n"
         "  [ -v | --version ]               Shows version information.\n",
         name, name
@@ -804,6 +874,13 @@ int main(int argc, char** argv) {
                 exit(1);
             }
             sleep_interval = atoi(argv[i]);
+        } else if (is_arg(argv[i], "poll_interval")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            poll_interval = atof(argv[i]);
         } else if (is_arg(argv[i], "v") || is_arg(argv[i], "version")) {
             show_version();
             exit(0);
@@ -856,6 +933,10 @@ int main(int argc, char** argv) {
     ssp = (SCHED_SHMEM*)p;
     ssp->init(num_work_items);
 
+    // if this fails the scheduler works without the cache
+    //
+    auth_cache_create();
+
     atexit(cleanup_shmem);
     install_stop_signal_handler();
 
@@ -874,6 +955,7 @@ int main(int argc, char** argv) {
             "boinc_db.set_isolation_level: %d; %s\n", retval, boinc_db.error_string()
         );
     }
+    boinc_db.use_prepared = config.db_prepared_statements;
     ssp->scan_tables();
 
     log_messages.printf(MSG_NORMAL,
@@ -892,6 +974,7 @@ int main(int argc, char** argv) {
     );
 
     app_indices = (int*) calloc(ssp->max_wu_results, sizeof(int));
+    slot_resultids = (DB_ID_TYPE*) calloc(ssp->max_wu_results, sizeof(DB_ID_TYPE));
 
     // If all_apps is set, make an array saying which array slot
     // is associated with which app
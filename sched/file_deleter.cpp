@@ -31,12 +31,16 @@
 
 #include "config.h"
 #include <list>
+#include <map>
+#include <vector>
 #include <cstring>
 #include <string>
 #include <cstdlib>
 #include <ctime>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -60,6 +64,8 @@
 #include "sched_msgs.h"
 
 using std::string;
+using std::vector;
+using std::map;
 
 #define LOCKFILE "file_deleter.out"
 #define PIDFILE  "file_deleter.pid"
@@ -75,6 +81,7 @@ bool do_input_files = true;
 bool do_output_files = true;
 bool dry_run = false;
 int sleep_interval = DEFAULT_SLEEP_INTERVAL;
+int nthreads = 0;
 char *xml_doc_like = NULL;
 char *download_dir = NULL;
 
@@ -106,6 +113,9 @@ void usage(char *name) {
         "  --output_files_only             delete only output (upload) files\n"
         "  --xml_doc_like L                only process workunits where xml_doc LIKE 'L'\n"
         "  --download_dir D                override download_dir from project config with D\n"
+        "  --nthreads N                    delete the files of each enumeration\n"
+        "                                  using N threads, and update the DB\n"
+        "                                  with one query per enumeration\n"
         "  [ -h | --help ]                 shows this help text\n"
         "  [ -v | --version ]              shows version information\n",
         name
@@ -317,6 +327,356 @@ int result_delete_files(RESULT& result) {
 static bool preserve_wu_files=false;
 static bool preserve_result_files=false;
 
+////////// batch mode (--nthreads) //////////
+//
+// Enumerate a batch of WUs or results, and make a list of their files.
+// Delete the files using a pool of threads.
+// Each thread unlinks files relative to open directory handles
+// (one per directory in the upload/download hierarchy,
+// at most MAX_DIR_FDS of them, closed at the end of the batch)
+// so that there's no path lookup or stat() of the file.
+// Then update the file_delete_state of the batch
+// with one query per new state.
+
+struct DELETE_FILE {
+    int row;            // index in rows
+    string dir;
+    string name;
+    bool is_wu;
+    int retval;         // 0, ERR_OPENDIR, ERR_OPEN, ERR_NOT_FOUND or ERR_UNLINK
+    int err;            // errno if ERR_OPEN or ERR_UNLINK
+};
+
+struct DELETE_ROW {
+    DB_ID_TYPE id;
+    int file_delete_state;
+    int outcome;
+    int client_state;
+    int count_deleted;
+    int retval;
+    bool retry;         // transient error; leave state as is
+};
+
+static vector<DELETE_FILE> delete_files;
+static size_t next_delete_file;
+static map<string, int> dir_fds;
+static pthread_mutex_t delete_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define MAX_DIR_FDS 256
+    // keep well below the usual limit of 1024 open files
+
+// get a handle for a directory; open it if needed.
+// If the cache is full, the caller must close the handle.
+//
+static int get_dir_fd(const string& dir, bool& cached) {
+    pthread_mutex_lock(&delete_mutex);
+    int fd;
+    map<string, int>::iterator i = dir_fds.find(dir);
+    if (i == dir_fds.end()) {
+        fd = open(dir.c_str(), O_RDONLY|O_DIRECTORY);
+        cached = false;
+        if (fd >= 0 && dir_fds.size() < MAX_DIR_FDS) {
+            dir_fds[dir] = fd;
+            cached = true;
+        }
+    } else {
+        fd = i->second;
+        cached = true;
+    }
+    pthread_mutex_unlock(&delete_mutex);
+    return fd;
+}
+
+static void close_dir_fds() {
+    map<string, int>::iterator i;
+    for (i = dir_fds.begin(); i != dir_fds.end(); ++i) {
+        close(i->second);
+    }
+    dir_fds.clear();
+}
+
+static void* delete_thread(void*) {
+    while (1) {
+        pthread_mutex_lock(&delete_mutex);
+        size_t i = next_delete_file++;
+        pthread_mutex_unlock(&delete_mutex);
+        if (i >= delete_files.size()) break;
+
+        DELETE_FILE& df = delete_files[i];
+        bool cached;
+        int fd = get_dir_fd(df.dir, cached);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                // out of file descriptors; try again later
+                //
+                df.retval = ERR_OPEN;
+                df.err = errno;
+            } else {
+                df.retval = ERR_OPENDIR;
+            }
+            continue;
+        }
+        if (unlinkat(fd, df.name.c_str(), 0)) {
+            if (errno == ENOENT) {
+                df.retval = ERR_NOT_FOUND;
+            } else {
+                df.retval = ERR_UNLINK;
+                df.err = errno;
+            }
+        } else {
+            df.retval = 0;
+            if (df.is_wu) {
+                // delete gzipped version and cached MD5 if present
+                //
+                unlinkat(fd, (df.name + ".gz").c_str(), 0);
+                if (config.cache_md5_info) {
+                    unlinkat(fd, (df.name + ".md5").c_str(), 0);
+                }
+            }
+        }
+        if (!cached) close(fd);
+    }
+    return NULL;
+}
+
+// get the names of the deletable files in a WU or result XML doc
+//
+static void get_file_names(const char* xml_doc, vector<string>& names) {
+    MIOFILE mf;
+    mf.init_buf_read(xml_doc);
+    XML_PARSER xp(&mf);
+    while (!xp.get_tag()) {
+        if (!xp.is_tag) continue;
+        if (!xp.match_tag("file_info")) continue;
+        string filename;
+        bool no_delete = false;
+        while (!xp.get_tag()) {
+            if (xp.parse_string("name", filename)) {
+                continue;
+            } else if (xp.parse_bool("no_delete", no_delete)) {
+                continue;
+            } else if (xp.match_tag("/file_info")) {
+                break;
+            }
+        }
+        if (!xp.match_tag("/file_info") || filename.empty()) {
+            log_messages.printf(MSG_CRITICAL, "bad XML: %s\n", xml_doc);
+        }
+        if (!no_delete && !filename.empty()) {
+            names.push_back(filename);
+        }
+    }
+}
+
+static void add_files(
+    int row, const char* xml_doc, const char* root, bool is_wu
+) {
+    char path[MAXPATHLEN];
+    vector<string> names;
+
+    get_file_names(xml_doc, names);
+    for (unsigned int i=0; i<names.size(); i++) {
+        DELETE_FILE df;
+        dir_hier_path(
+            names[i].c_str(), root, config.uldl_dir_fanout, path, false
+        );
+        char* p = strrchr(path, '/');
+        *p = 0;
+        df.row = row;
+        df.dir = path;
+        df.name = names[i];
+        df.is_wu = is_wu;
+        df.retval = 0;
+        df.err = 0;
+        delete_files.push_back(df);
+    }
+}
+
+static void delete_batch_files() {
+    vector<pthread_t> threads;
+
+    next_delete_file = 0;
+    for (int i=1; i<nthreads && i<(int)delete_files.size(); i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, delete_thread, NULL)) break;
+        threads.push_back(t);
+    }
+    delete_thread(NULL);
+    for (unsigned int i=0; i<threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+    close_dir_fds();
+}
+
+// set the file_delete_state of a list of WUs or results
+//
+static int update_batch_state(
+    DB_BASE& db, vector<DB_ID_TYPE>& ids, int new_state
+) {
+    char set_clause[256], buf[64];
+    string where_clause;
+
+    if (ids.empty()) return 0;
+    if (dry_run) return 0;
+    sprintf(set_clause, "file_delete_state=%d", new_state);
+    where_clause = "id in (";
+    for (unsigned int i=0; i<ids.size(); i++) {
+        sprintf(buf, i?",%lu":"%lu", ids[i]);
+        where_clause += buf;
+    }
+    where_clause += ")";
+    return db.update_fields_noid(set_clause, where_clause.c_str());
+}
+
+// delete the files of the WUs or results given by an enumeration clause.
+// Return true if we changed the file_delete_state of any.
+//
+static bool do_batch(bool is_wu, const char* clause) {
+    DB_WORKUNIT wu;
+    DB_RESULT result;
+    vector<DELETE_ROW> rows;
+    const char* type = is_wu?"WU":"RESULT";
+    int retval;
+
+    delete_files.clear();
+    while (1) {
+        DELETE_ROW row;
+        if (is_wu) {
+            retval = wu.enumerate(clause);
+        } else {
+            retval = result.enumerate(clause);
+        }
+        if (retval) {
+            if (retval != ERR_DB_NOT_FOUND) {
+                log_messages.printf(MSG_DEBUG, "DB connection lost, exiting\n");
+                exit(0);
+            }
+            break;
+        }
+        if (is_wu) {
+            row.id = wu.id;
+            row.file_delete_state = wu.file_delete_state;
+            row.outcome = 0;
+            row.client_state = 0;
+            if (!preserve_wu_files && !strstr(wu.name, "nodelete")) {
+                add_files((int)rows.size(), wu.xml_doc, download_dir, true);
+            }
+        } else {
+            row.id = result.id;
+            row.file_delete_state = result.file_delete_state;
+            row.outcome = result.outcome;
+            row.client_state = result.client_state;
+            if (!preserve_result_files) {
+                add_files(
+                    (int)rows.size(), result.xml_doc_in, config.upload_dir, false
+                );
+            }
+        }
+        row.count_deleted = 0;
+        row.retval = 0;
+        row.retry = false;
+        rows.push_back(row);
+    }
+    if (rows.empty()) return false;
+
+    delete_batch_files();
+
+    for (unsigned int i=0; i<delete_files.size(); i++) {
+        DELETE_FILE& df = delete_files[i];
+        DELETE_ROW& row = rows[df.row];
+        switch (df.retval) {
+        case 0:
+            row.count_deleted++;
+            log_messages.printf(MSG_NORMAL,
+                "[%s#%lu] deleted %s\n", type, row.id, df.name.c_str()
+            );
+            break;
+        case ERR_OPENDIR:
+            row.retval = is_wu?ERR_UNLINK:ERR_OPENDIR;
+            log_messages.printf(MSG_CRITICAL,
+                "[%s#%lu] missing dir for %s\n", type, row.id, df.name.c_str()
+            );
+            break;
+        case ERR_OPEN:
+            row.retry = true;
+            log_messages.printf(MSG_CRITICAL,
+                "[%s#%lu] can't open dir for %s: %s; will retry\n",
+                type, row.id, df.name.c_str(), strerror(df.err)
+            );
+            break;
+        case ERR_NOT_FOUND:
+            if (is_wu) {
+                log_messages.printf(MSG_CRITICAL,
+                    "[WU#%lu] No file %s to delete\n", row.id, df.name.c_str()
+                );
+            } else {
+                // see result_delete_files()
+                //
+                log_messages.printf(
+                    (row.outcome == RESULT_OUTCOME_SUCCESS)?MSG_CRITICAL:MSG_DEBUG,
+                    "[RESULT#%lu] outcome=%d client_state=%d No file %s to delete\n",
+                    row.id, row.outcome, row.client_state, df.name.c_str()
+                );
+            }
+            break;
+        default:
+            row.retval = ERR_UNLINK;
+            log_messages.printf(MSG_CRITICAL,
+                "[%s#%lu] unlink %s failed: %s\n",
+                type, row.id, df.name.c_str(), strerror(df.err)
+            );
+        }
+    }
+
+    vector<DB_ID_TYPE> done_ids, error_ids;
+    for (unsigned int i=0; i<rows.size(); i++) {
+        DELETE_ROW& row = rows[i];
+        log_messages.printf(MSG_DEBUG,
+            "[%s#%lu] deleted %d file(s)\n", type, row.id, row.count_deleted
+        );
+        if (row.retry) {
+            continue;
+        }
+        if (row.retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "[%s#%lu] file deletion failed: %s\n",
+                type, row.id, boincerror(row.retval)
+            );
+            if (row.file_delete_state != FILE_DELETE_ERROR) {
+                error_ids.push_back(row.id);
+            }
+        } else {
+            done_ids.push_back(row.id);
+        }
+    }
+
+    bool did_something = false;
+    DB_BASE& db = is_wu?(DB_BASE&)wu:(DB_BASE&)result;
+    retval = update_batch_state(db, done_ids, FILE_DELETE_DONE);
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "%s batch update failed: %s\n", type, boincerror(retval)
+        );
+    } else if (done_ids.size()) {
+        did_something = true;
+    }
+    retval = update_batch_state(db, error_ids, FILE_DELETE_ERROR);
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "%s batch update failed: %s\n", type, boincerror(retval)
+        );
+    } else if (error_ids.size()) {
+        did_something = true;
+    }
+    log_messages.printf(MSG_DEBUG,
+        "%s batch: %d records, %d files, %d done, %d errors\n",
+        type, (int)rows.size(), (int)delete_files.size(),
+        (int)done_ids.size(), (int)error_ids.size()
+    );
+    delete_files.clear();
+    return did_something;
+}
+
 // return true if we changed the file_delete_state of a WU or a result
 //
 bool do_pass(bool retry_error) {
@@ -347,7 +707,10 @@ bool do_pass(bool retry_error) {
         clause, RESULTS_PER_ENUM
     );
 
-    while (do_output_files) {
+    if (do_output_files && nthreads) {
+        if (do_batch(false, buf)) did_something = true;
+    }
+    while (do_output_files && !nthreads) {
         retval = result.enumerate(buf);
         if (retval) {
             if (retval != ERR_DB_NOT_FOUND) {
@@ -401,7 +764,10 @@ bool do_pass(bool retry_error) {
         clause, WUS_PER_ENUM
     );
 
-    while (do_input_files) {
+    if (do_input_files && nthreads) {
+        if (do_batch(true, buf)) did_something = true;
+    }
+    while (do_input_files && !nthreads) {
         retval = wu.enumerate(buf);
         if (retval) {
             if (retval != ERR_DB_NOT_FOUND) {
@@ -542,6 +908,13 @@ int main(int argc, char** argv) {
             do_output_files = false;
         } else if (is_arg(argv[i], "output_files_only")) {
             do_input_files = false;
+        } else if (is_arg(argv[i], "nthreads")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            nthreads = atoi(argv[i]);
         } else if (is_arg(argv[i], "sleep_interval")) {
             if (!argv[++i]) {
                 log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
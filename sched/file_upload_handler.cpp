@@ -18,6 +18,12 @@
 // The BOINC file upload handler.
 // See doc/upload.php for protocol spec.
 //
+// The FCGI version can also run as a standalone server:
+//   fcgi_file_upload_handler --fcgi_socket X [--fcgi_workers N]
+// listens on X (a Unix socket path or :port) and handles uploads
+// in N persistent worker processes.
+// Stop it with SIGHUP or SIGTERM;
+// workers finish the upload they're handling, if any.
 
 #include "config.h"
 #include <cstdlib>
@@ -33,6 +39,7 @@
 
 #ifdef _USING_FCGI_
 #include "boinc_fcgi.h"
+#include <fcgiapp.h>
 #else
 #include <cstdio>
 #endif
@@ -40,6 +47,8 @@
 #include "crypt.h"
 #include "error_numbers.h"
 #include "filesys.h"
+#include "md5.h"
+#include "md5_file.h"
 #include "parse.h"
 #include "str_replace.h"
 #include "str_util.h"
@@ -110,6 +119,87 @@ int return_success(const char* text) {
 #define BLOCK_SIZE  (256*1024)
 double bytes_left=-1;
 
+#ifdef _USING_FCGI_
+#define DEFAULT_FCGI_WORKERS    4
+#endif
+
+// number of uploaded files written since the last sync
+//
+int nfiles_unsynced = 0;
+
+// buffer for copying from the socket.
+// Allocated once (page-aligned) and reused for all requests
+//
+static unsigned char* get_copy_buf() {
+    static unsigned char* buf = NULL;
+    if (!buf) {
+        void* p;
+        if (posix_memalign(&p, 4096, BLOCK_SIZE)) return NULL;
+        buf = (unsigned char*)p;
+    }
+    return buf;
+}
+
+// start writing the file's data to disk, but don't wait for it
+//
+static void start_writeback(int fd) {
+#ifdef __linux__
+    sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+    nfiles_unsynced++;
+}
+
+// if files have been uploaded since the last sync,
+// and at least fuh_sync_interval seconds have passed,
+// flush the upload filesystem to disk.
+// Called between requests by the FCGI version,
+// so one sync covers many uploads
+//
+static void sync_upload_dir() {
+    static double last_sync_time = 0;
+
+    if (!nfiles_unsynced) return;
+    double now = dtime();
+    if (now < last_sync_time + config.fuh_sync_interval) return;
+#ifdef __linux__
+    int fd = open(config.upload_dir, O_RDONLY);
+    if (fd >= 0) {
+        syncfs(fd);
+        close(fd);
+    }
+#else
+    sync();
+#endif
+    last_sync_time = dtime();
+    log_messages.printf(MSG_DEBUG,
+        "synced %d uploaded files in %.3f sec\n",
+        nfiles_unsynced, last_sync_time - now
+    );
+    nfiles_unsynced = 0;
+}
+
+// add the first nbytes of the given file to an MD5 state
+// (for resumed uploads)
+//
+static int md5_file_prefix(const char* path, double nbytes, md5_state_t& state) {
+    unsigned char buf[65536];
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return ERR_OPEN;
+    while (nbytes > 0) {
+        size_t m = nbytes < sizeof(buf) ? (size_t)nbytes : sizeof(buf);
+        ssize_t n = read(fd, buf, m);
+        if (n <= 0) {
+            close(fd);
+            return ERR_READ;
+        }
+        md5_append(&state, buf, (int)n);
+        nbytes -= n;
+    }
+    close(fd);
+    return 0;
+}
+
 int accept_empty_file(char* name, char* path) {
     int fd = open(path,
         O_WRONLY|O_CREAT,
@@ -124,13 +214,24 @@ int accept_empty_file(char* name, char* path) {
     return return_success(0);
 }
 
-// read from socket, write to file
+// read from socket, write to file.
+// If config.fuh_check_md5 is set and the client sent a checksum,
+// compute the file's MD5 as we go, and reject it if it doesn't match.
 // ALWAYS returns an HTML reply
 //
-int copy_socket_to_file(FILE* in, char* name, char* path, double offset, double nbytes) {
-    unsigned char buf[BLOCK_SIZE];
+int copy_socket_to_file(
+    FILE* in, char* name, char* path, double offset, double nbytes,
+    const char* md5_cksum
+) {
+    unsigned char* buf = get_copy_buf();
     struct stat sbuf;
     int pid, fd=0;
+    md5_state_t md5_state;
+    bool do_md5 = config.fuh_check_md5 && strlen(md5_cksum);
+
+    if (!buf) {
+        return return_error(ERR_TRANSIENT, "can't allocate buffer");
+    }
 
     // caller guarantees that nbytes > offset
     //
@@ -218,6 +319,16 @@ int copy_socket_to_file(FILE* in, char* name, char* path, double offset, double
                      this_filename, (int)sbuf.st_size, offset
                 );
             }
+            if (do_md5) {
+                md5_init(&md5_state);
+                if (offset && md5_file_prefix(path, offset, md5_state)) {
+                    log_messages.printf(MSG_NORMAL,
+                        "can't read first %.0f bytes of %s; not checking MD5\n",
+                        offset, this_filename
+                    );
+                    do_md5 = false;
+                }
+            }
         }
 
         // try to write n bytes to file
@@ -239,6 +350,9 @@ int copy_socket_to_file(FILE* in, char* name, char* path, double offset, double
             }
             to_write -= ret;
         }
+        if (do_md5) {
+            md5_append(&md5_state, buf, n);
+        }
 
         // check that we got all bytes from socket that were requested
         // Note: fread() reads less than requested only if there's
@@ -266,6 +380,35 @@ int copy_socket_to_file(FILE* in, char* name, char* path, double offset, double
 
         bytes_left -= n;
     }
+    if (do_md5) {
+        unsigned char binout[16];
+        char md5_buf[MD5_LEN];
+        md5_finish(&md5_state, binout);
+        for (int i=0; i<16; i++) {
+            sprintf(md5_buf+2*i, "%02x", binout[i]);
+        }
+        if (strcasecmp(md5_buf, md5_cksum)) {
+            // discard the file.  The error is permanent:
+            // the client would send the same data again
+            //
+            log_messages.printf(MSG_CRITICAL,
+                "MD5 mismatch for %s: got %s, expected %s\n",
+                this_filename, md5_buf, md5_cksum
+            );
+            if (ftruncate(fd, 0)) {
+                log_messages.printf(MSG_CRITICAL,
+                    "can't truncate %s: %s\n", this_filename, strerror(errno)
+                );
+            }
+            close(fd);
+            return return_error(ERR_PERMANENT,
+                "MD5 checksum mismatch for file %s", name
+            );
+        }
+    }
+    if (config.fuh_sync_interval > 0) {
+        start_writeback(fd);
+    }
     close(fd);
     return return_success(0);
 }
@@ -273,8 +416,9 @@ int copy_socket_to_file(FILE* in, char* name, char* path, double offset, double
 // read from socket, discard data
 //
 void copy_socket_to_null(FILE* in) {
-    unsigned char buf[BLOCK_SIZE];
+    unsigned char* buf = get_copy_buf();
 
+    if (!buf) return;
     while (1) {
         int n = fread(buf, 1, BLOCK_SIZE, in);
         if (n <= 0) return;
@@ -285,7 +429,7 @@ void copy_socket_to_null(FILE* in) {
 //
 int handle_file_upload(FILE* in, R_RSA_PUBLIC_KEY& key) {
     char buf[256], path[MAXPATHLEN], signed_xml[1024];
-    char name[256], stemp[256];
+    char name[256], stemp[256], md5_cksum[MD5_LEN];
     double max_nbytes=-1;
     char xml_signature[1024];
     int retval;
@@ -293,6 +437,7 @@ int handle_file_upload(FILE* in, R_RSA_PUBLIC_KEY& key) {
     bool is_valid, btemp;
 
     strcpy(name, "");
+    strcpy(md5_cksum, "");
     strcpy(xml_signature, "");
     bool found_data = false;
     while (fgets(buf, 256, in)) {
@@ -306,7 +451,7 @@ int handle_file_upload(FILE* in, R_RSA_PUBLIC_KEY& key) {
         if (parse_bool(buf, "generated_locally", btemp)) continue;
         if (parse_bool(buf, "upload_when_present", btemp)) continue;
         if (parse_str(buf, "<url>", stemp, sizeof(stemp))) continue;
-        if (parse_str(buf, "<md5_cksum>", stemp, sizeof(stemp))) continue;
+        if (parse_str(buf, "<md5_cksum>", md5_cksum, sizeof(md5_cksum))) continue;
         if (match_tag(buf, "<xml_signature>")) {
             copy_element_contents(
                 in, "</xml_signature>", xml_signature, sizeof(xml_signature)
@@ -434,7 +579,7 @@ int handle_file_upload(FILE* in, R_RSA_PUBLIC_KEY& key) {
             );
             return return_success(0);
         }
-        retval = copy_socket_to_file(in, name, path, offset, nbytes);
+        retval = copy_socket_to_file(in, name, path, offset, nbytes, md5_cksum);
         log_messages.printf(MSG_NORMAL,
             "Ended upload of %s from %s; retval %d\n",
             name,
@@ -650,18 +795,102 @@ void usage(char *name) {
         "Normally this is run as a CGI program.\n\n"
         "Usage: %s [OPTION]...\n\n"
         "Options:\n"
+#ifdef _USING_FCGI_
+        "  [ --fcgi_socket X ]    Run as a standalone FastCGI server on X\n"
+        "                         (a Unix socket path or :port)\n"
+        "  [ --fcgi_workers N ]   Number of worker processes (default %d)\n"
+#endif
         "  [ -h | --help ]        Show this help text.\n"
         "  [ -v | --version ]     Show version information.\n",
         name
+#ifdef _USING_FCGI_
+        , DEFAULT_FCGI_WORKERS
+#endif
     );
 }
 
+#ifdef _USING_FCGI_
+// Stop signals in the standalone server.
+// The parent passes them on to the workers (see fork_workers())
+// and waits for the workers to exit.
+// A worker only sets a flag; it exits from the accept loop,
+// after finishing the current request if there is one.
+//
+static volatile sig_atomic_t stop_requested = 0;
+
+static void parent_stop_handler(int) {
+    caught_stop_signal = true;
+}
+
+static void worker_stop_handler(int) {
+    stop_requested = 1;
+
+    // make FCGI_Accept() return rather than retry accept()
+    //
+    FCGX_ShutdownPending();
+}
+
+static void worker_stop() {
+    log_messages.printf(MSG_NORMAL, "worker stopping\n");
+    exit(0);
+}
+
+// called between requests
+//
+static void end_request() {
+    if (stop_requested) {
+        FCGI_Finish();
+        worker_stop();
+    }
+}
+
+// Open a FastCGI listening socket, make it our stdin
+// (where FCGI_Accept() expects it) and fork worker processes.
+// Returns in each worker; the parent stays in fork_workers(),
+// restarting workers that fail.
+//
+static void start_fcgi_server(const char* socket_path, int nworkers) {
+    int sock = FCGX_OpenSocket(socket_path, 1024);
+    if (sock < 0) {
+        fprintf(stderr, "can't open FCGI socket %s\n", socket_path);
+        exit(1);
+    }
+    if (sock != 0) {
+        if (dup2(sock, 0) < 0) {
+            fprintf(stderr, "dup2() failed: %d\n", errno);
+            exit(1);
+        }
+        close(sock);
+    }
+    log_messages.printf(MSG_NORMAL,
+        "listening on %s with %d workers\n", socket_path, nworkers
+    );
+    install_stop_signal_handler();
+    signal(SIGTERM, parent_stop_handler);
+    int k = fork_workers(nworkers);
+    installer();
+
+    // no SA_RESTART, so that a signal interrupts accept() in FCGI_Accept()
+    //
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = worker_stop_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGHUP, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    log_messages.pid = getpid();
+    log_messages.printf(MSG_NORMAL, "worker %d started\n", k);
+}
+#endif
+
 int main(int argc, char *argv[]) {
     int retval;
     R_RSA_PUBLIC_KEY key;
     char log_path[MAXPATHLEN];
 #ifdef _USING_FCGI_
     unsigned int counter=0;
+    const char* fcgi_socket = NULL;
+    int fcgi_workers = DEFAULT_FCGI_WORKERS;
 #endif
 
     for(int c = 1; c < argc; c++) {
@@ -672,6 +901,13 @@ int main(int argc, char *argv[]) {
         } else if(option == "-h" || option == "--help") {
             usage(argv[0]);
             exit(0);
+#ifdef _USING_FCGI_
+        } else if (option == "--fcgi_socket" && c+1 < argc) {
+            fcgi_socket = argv[++c];
+        } else if (option == "--fcgi_workers" && c+1 < argc) {
+            fcgi_workers = atoi(argv[++c]);
+            if (fcgi_workers < 1) fcgi_workers = 1;
+#endif
         } else if (option.length()){
             fprintf(stderr, "unknown command line argument: %s\n\n", argv[c]);
             usage(argv[0]);
@@ -741,13 +977,17 @@ int main(int argc, char *argv[]) {
     }
 
 #ifdef _USING_FCGI_
-    while(FCGI_Accept() >= 0) {
+    if (fcgi_socket) {
+        start_fcgi_server(fcgi_socket, fcgi_workers);
+    }
+    while(!stop_requested && FCGI_Accept() >= 0) {
         counter++;
         //fprintf(stderr, "file_upload_handler (FCGI): counter: %d\n", counter);
         if (boinc_file_exists(config.project_path("stop_upload"))) {
             return_error(ERR_TRANSIENT,
                 "File uploads are temporarily disabled."
             );
+            end_request();
             continue;
         }
         log_messages.set_indent_level(0);
@@ -756,6 +996,17 @@ int main(int argc, char *argv[]) {
 #ifdef _USING_FCGI_
         // flush log for FCGI, otherwise it just buffers a lot
         log_messages.flush();
+
+        if (config.fuh_sync_interval > 0) {
+            // finish the reply before syncing, so the client doesn't wait
+            //
+            FCGI_Finish();
+            sync_upload_dir();
+        }
+        end_request();
+    }
+    if (stop_requested) {
+        worker_stop();
     }
     // when exiting, write headers back to apache so it won't complain
     // about "incomplete headers"
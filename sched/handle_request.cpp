@@ -50,6 +50,7 @@
 #include "sched_vda.h"
 
 #include "credit.h"
+#include "sched_auth_cache.h"
 #include "sched_files.h"
 #include "sched_main.h"
 #include "sched_types.h"
@@ -257,11 +258,11 @@ int authenticate_user() {
     DB_TEAM team;
 
     if (g_request->hostid) {
-        retval = host.lookup_id(g_request->hostid);
+        retval = auth_cache_lookup_host(g_request->hostid, host);
         while (!retval && host.userid==0) {
             // if host record is zombie, follow link to new host
             //
-            retval = host.lookup_id(host.rpc_seqno);
+            retval = auth_cache_lookup_host(host.rpc_seqno, host);
             if (!retval) {
                 g_reply->hostid = host.id;
                 log_messages.printf(MSG_NORMAL,
@@ -286,8 +287,7 @@ int authenticate_user() {
         // and see if the authenticator matches (regular or weak)
         //
         g_request->using_weak_auth = false;
-        sprintf(buf, "where id=%lu", host.userid);
-        retval = user.lookup(buf);
+        retval = auth_cache_lookup_user(host.userid, user);
         if (!retval && !strcmp(user.authenticator, g_request->authenticator)) {
             // req auth matches user auth - go on
         } else {
@@ -312,6 +312,7 @@ int authenticate_user() {
                 escape_string(user.authenticator, sizeof(user.authenticator));
                 sprintf(buf, "where authenticator='%s'", user.authenticator);
                 retval = user.lookup(buf);
+                if (!retval) auth_cache_put_user(user);
                 if (retval) {
                     g_reply->insert_message(
                         _("Invalid or missing account key.  To fix, remove and add this project."),
@@ -364,7 +365,7 @@ lookup_user_and_make_new_host:
         //
         if (strchr(g_request->authenticator, '_')) {
             int userid = atoi(g_request->authenticator);
-            retval = user.lookup_id(userid);
+            retval = auth_cache_lookup_user(userid, user);
             if (!retval) {
                 get_weak_auth(user, buf);
                 if (strcmp(buf, g_request->authenticator)) {
@@ -379,6 +380,7 @@ lookup_user_and_make_new_host:
             escape_string(user.authenticator, sizeof(user.authenticator));
             sprintf(buf, "where authenticator='%s'", user.authenticator);
             retval = user.lookup(buf);
+            if (!retval) auth_cache_put_user(user);
         }
         if (retval) {
             g_reply->insert_message(
@@ -488,7 +490,7 @@ got_host:
     //
 
     if (g_reply->user.teamid) {
-        retval = team.lookup_id(g_reply->user.teamid);
+        retval = auth_cache_lookup_team(g_reply->user.teamid, team);
         if (!retval) g_reply->team = team;
     }
 
@@ -509,6 +511,7 @@ got_host:
             sprintf(buf, "cross_project_id='%s'", g_request->cross_project_id);
             unescape_string(g_request->cross_project_id, sizeof(g_request->cross_project_id));
             user.update_field(buf);
+            auth_cache_invalidate(AUTH_CACHE_USER, user.id);
         }
     }
 
@@ -626,6 +629,9 @@ static int update_host_record(HOST& initial_host, HOST& xhost, USER& user) {
         log_messages.printf(MSG_CRITICAL,
             "host.update() failed: %s\n", boincerror(retval)
         );
+        auth_cache_invalidate(AUTH_CACHE_HOST, host.id);
+    } else {
+        auth_cache_update_host(host);
     }
     return 0;
 }
@@ -846,6 +852,7 @@ int handle_global_prefs() {
                     "user.update_field() failed: %s\n", boincerror(retval)
                 );
             }
+            auth_cache_invalidate(AUTH_CACHE_USER, user.id);
         }
     }
 
@@ -1381,7 +1388,6 @@ void process_request(char* code_sign_key) {
     if (g_request->have_other_results_list) {
         if (ok_to_send_work
             && (config.resend_lost_results || g_wreq->resend_lost_results)
-            && !g_request->results_truncated
         ) {
             if (resend_lost_work()) {
                 if (config.debug_send) {
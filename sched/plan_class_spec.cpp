@@ -30,6 +30,9 @@
 #include "sched_customize.h"
 #include "plan_class_spec.h"
 
+#define PLAN_CLASS_HOST_CACHE_SIZE  1000
+    // max # of host configurations in PLAN_CLASS_SPECS::host_check_cache
+
 using std::string;
 
 // this returns a numerical OS version for Darwin/OSX and Windows,
@@ -175,37 +178,12 @@ bool PLAN_CLASS_SPEC::opencl_check(OPENCL_DEVICE_PROP& opencl_prop) {
     return true;
 }
 
-// See whether the given host/user can be sent this plan class.
-// If so return the resource usage and estimated FLOPS in hu.
+// the checks that depend only on properties of the host
+// that rarely change (CPU, OS, client and VirtualBox versions).
+// These don't have side effects,
+// so PLAN_CLASS_SPECS::check() can cache the result.
 //
-bool PLAN_CLASS_SPEC::check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKUNIT* wu) {
-    COPROC* cpp = NULL;
-    bool can_use_multicore = true;
-
-    if (infeasible_random && drand()<infeasible_random) {
-        return false;
-    }
-    if (user_id && sreq.user_id != user_id) {
-        if (config.debug_version_select) {
-            log_messages.printf(MSG_NORMAL,
-                "[version] not specified user ID (%d %d)\n",
-                user_id, sreq.user_id
-            );
-        }
-        return false;
-    }
-
-    // default is sequential app
-    //
-    hu.sequential_app(sreq.host.p_fpops);
-
-    // WU restriction
-    if (min_wu_id || max_wu_id || min_batch || max_batch) {
-        if (wu_is_infeasible_for_plan_class(this, wu)) {
-            return false;
-        }
-    }
-
+bool PLAN_CLASS_SPEC::host_check(SCHEDULER_REQUEST& sreq) {
     // CPU features
     //
     // older clients report CPU features in p_model,
@@ -242,18 +220,6 @@ bool PLAN_CLASS_SPEC::check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKU
         }
     }
 
-    // min NCPUS
-    //
-    if (min_ncpus && g_wreq->effective_ncpus < min_ncpus) {
-        if (config.debug_version_select) {
-            log_messages.printf(MSG_NORMAL,
-                "[version] plan_class_spec: not enough CPUs: %d < %f\n",
-                g_wreq->effective_ncpus, min_ncpus
-            );
-        }
-        return false;
-    }
-
     // host summary
     //
     if (have_host_summary_regex
@@ -365,16 +331,6 @@ bool PLAN_CLASS_SPEC::check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKU
 
     // BOINC versions
     //
-    if (min_core_client_version && sreq.core_client_version < min_core_client_version) {
-        if (config.debug_version_select) {
-            log_messages.printf(MSG_NORMAL,
-                "[version] plan_class_spec: Need newer BOINC core client: %d < %d\n",
-                sreq.core_client_version, min_core_client_version
-            );
-        }
-        add_no_work_message("A newer BOINC may be required for some tasks.");
-        return false;
-    }
     if (max_core_client_version && sreq.core_client_version > max_core_client_version) {
         if (config.debug_version_select) {
             log_messages.printf(MSG_NORMAL,
@@ -385,21 +341,13 @@ bool PLAN_CLASS_SPEC::check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKU
         return false;
     }
 
-    if (virtualbox) {
-
-        // host must run 7.0+ client
-        //
-        if (sreq.core_client_major_version < 7) {
-            add_no_work_message("BOINC client 7.0+ required for Virtualbox jobs");
-            return false;
-        }
-
-        // host must have VirtualBox 3.2 or later
-        //
-        if (strlen(sreq.host.virtualbox_version) == 0) {
-            add_no_work_message("VirtualBox is not installed");
-            return false;
-        }
+    // VirtualBox version.
+    // If the client is too old or VirtualBox isn't installed,
+    // let check() fail and tell the user.
+    //
+    if (virtualbox && sreq.core_client_major_version >= 7
+        && strlen(sreq.host.virtualbox_version)
+    ) {
         int n, maj, min, rel;
         n = sscanf(sreq.host.virtualbox_version, "%d.%d.%d", &maj, &min, &rel);
         if (n != 3) {
@@ -450,7 +398,91 @@ bool PLAN_CLASS_SPEC::check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKU
                 return false;
             }
         }
+    }
+    return true;
+}
+
+// See whether the given host/user can be sent this plan class.
+// If so return the resource usage and estimated FLOPS in hu.
+//
+// If host_checked is set, the caller has already done host_check().
+//
+bool PLAN_CLASS_SPEC::check(
+    SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKUNIT* wu,
+    bool host_checked
+) {
+    COPROC* cpp = NULL;
+    bool can_use_multicore = true;
+
+    if (infeasible_random && drand()<infeasible_random) {
+        return false;
+    }
+    if (user_id && sreq.user_id != user_id) {
+        if (config.debug_version_select) {
+            log_messages.printf(MSG_NORMAL,
+                "[version] not specified user ID (%d %d)\n",
+                user_id, sreq.user_id
+            );
+        }
+        return false;
+    }
+
+    // default is sequential app
+    //
+    hu.sequential_app(sreq.host.p_fpops);
+
+    // WU restriction
+    if (min_wu_id || max_wu_id || min_batch || max_batch) {
+        if (wu_is_infeasible_for_plan_class(this, wu)) {
+            return false;
+        }
+    }
 
+    // checks that depend only on the host
+    //
+    if (!host_checked && !host_check(sreq)) {
+        return false;
+    }
+
+    // min NCPUS
+    //
+    if (min_ncpus && g_wreq->effective_ncpus < min_ncpus) {
+        if (config.debug_version_select) {
+            log_messages.printf(MSG_NORMAL,
+                "[version] plan_class_spec: not enough CPUs: %d < %f\n",
+                g_wreq->effective_ncpus, min_ncpus
+            );
+        }
+        return false;
+    }
+
+    // BOINC versions
+    //
+    if (min_core_client_version && sreq.core_client_version < min_core_client_version) {
+        if (config.debug_version_select) {
+            log_messages.printf(MSG_NORMAL,
+                "[version] plan_class_spec: Need newer BOINC core client: %d < %d\n",
+                sreq.core_client_version, min_core_client_version
+            );
+        }
+        add_no_work_message("A newer BOINC may be required for some tasks.");
+        return false;
+    }
+    if (virtualbox) {
+
+        // host must run 7.0+ client
+        //
+        if (sreq.core_client_major_version < 7) {
+            add_no_work_message("BOINC client 7.0+ required for Virtualbox jobs");
+            return false;
+        }
+
+        // host must have VirtualBox 3.2 or later
+        //
+        if (strlen(sreq.host.virtualbox_version) == 0) {
+            add_no_work_message("VirtualBox is not installed");
+            return false;
+        }
         // host must have VM acceleration in order to run multi-core jobs
         //
         if (max_threads > 1) {
@@ -955,13 +987,56 @@ bool PLAN_CLASS_SPEC::check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKU
 bool PLAN_CLASS_SPECS::check(
     SCHEDULER_REQUEST& sreq, char* plan_class, HOST_USAGE& hu, const WORKUNIT* wu
 ) {
-    for (unsigned int i=0; i<classes.size(); i++) {
-        if (!strcmp(classes[i].name, plan_class)) {
-            return classes[i].check(sreq, hu, wu);
-        }
+    std::map<std::string, int>::iterator it = class_index.find(plan_class);
+    if (it == class_index.end()) {
+        log_messages.printf(MSG_CRITICAL, "Unknown plan class: %s\n", plan_class);
+        return false;
     }
-    log_messages.printf(MSG_CRITICAL, "Unknown plan class: %s\n", plan_class);
-    return false;
+    int i = it->second;
+    PLAN_CLASS_SPEC& pc = classes[i];
+
+    // with debugging on, do the full check so that the reasons get logged
+    //
+    if (config.debug_version_select) {
+        return pc.check(sreq, hu, wu);
+    }
+
+    // A scheduler instance (particularly under FCGI) checks
+    // many app versions for the same host, and many requests
+    // from hosts with identical CPU/OS/client configurations.
+    // Cache the result of host_check() for each plan class,
+    // keyed by the host properties it uses.
+    //
+    char buf[64];
+    std::string key = sreq.host.p_features;
+    key += '\n'; key += sreq.host.p_model;
+    key += '\n'; key += sreq.host.p_vendor;
+    key += '\n'; key += sreq.host.os_name;
+    key += '\n'; key += sreq.host.os_version;
+    key += '\n'; key += g_reply->host.serialnum;
+    key += '\n'; key += sreq.host.virtualbox_version;
+    sprintf(buf, "\n%d %d %d",
+        sreq.core_client_version, sreq.core_client_major_version,
+        sreq.host.p_vm_extensions_disabled?1:0
+    );
+    key += buf;
+
+    std::map<std::string, std::vector<signed char> >::iterator ci
+        = host_check_cache.find(key);
+    if (ci == host_check_cache.end()) {
+        if (host_check_cache.size() >= PLAN_CLASS_HOST_CACHE_SIZE) {
+            host_check_cache.clear();
+        }
+        ci = host_check_cache.insert(make_pair(
+            key, std::vector<signed char>(classes.size(), -1)
+        )).first;
+    }
+    signed char& ok = ci->second[i];
+    if (ok < 0) {
+        ok = pc.host_check(sreq) ? 1 : 0;
+    }
+    if (!ok) return false;
+    return pc.check(sreq, hu, wu, true);
 }
 
 bool PLAN_CLASS_SPECS::wu_is_infeasible(char* plan_class_name, const WORKUNIT* wu) {
@@ -1120,6 +1195,9 @@ int PLAN_CLASS_SPECS::parse_specs(FILE* f) {
             int retval = pc.parse(xp);
             if (retval) return retval;
             classes.push_back(pc);
+            class_index.insert(make_pair(
+                std::string(pc.name), (int)classes.size()-1
+            ));
         }
     }
     return ERR_XML_PARSE;
@@ -19,6 +19,7 @@
 // configurable app plan functions.
 // see https://boinc.berkeley.edu/trac/wiki/AppPlanConfig
 
+#include <map>
 #include <string>
 #include <vector>
 #include <regex.h>
@@ -119,12 +120,22 @@ struct PLAN_CLASS_SPEC {
 
     int parse(XML_PARSER&);
     bool opencl_check(OPENCL_DEVICE_PROP&);
-    bool check(SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKUNIT* wu);
+    bool host_check(SCHEDULER_REQUEST&);
+    bool check(
+        SCHEDULER_REQUEST& sreq, HOST_USAGE& hu, const WORKUNIT* wu,
+        bool host_checked=false
+    );
     PLAN_CLASS_SPEC();
 };
 
 struct PLAN_CLASS_SPECS {
     std::vector<PLAN_CLASS_SPEC> classes;
+    std::map<std::string, int> class_index;
+        // name -> index in classes
+    std::map<std::string, std::vector<signed char> > host_check_cache;
+        // results of host_check() for recently seen hosts,
+        // keyed by the host properties it looks at.
+        // -1 = not computed yet
     int parse_file(const char*);
     int parse_specs(FILE*);
     bool check(SCHEDULER_REQUEST& sreq, char* plan_class, HOST_USAGE& hu, const WORKUNIT* wu);
@@ -293,7 +293,11 @@ recheck:
         // ideally we should use a transaction from now until when
         // we commit to sending the results.
 
-        wu_result.state = g_pid;
+        if (!wu_result.claim(g_pid)) {
+            // reserved by a scheduler using the job index
+            //
+            continue;
+        }
         unlock_sema();
         sema_locked = false;
 
@@ -308,6 +312,7 @@ recheck:
             // can't send this job to any host
             //
             wu_result.state = WR_STATE_EMPTY;
+            ssp->slot_emptied();
             break;
         default:
             // slow_check() refreshes fields of wu_result.workunit;
@@ -320,6 +325,7 @@ recheck:
             // (since otherwise feeder might overwrite it)
             //
             wu_result.state = WR_STATE_EMPTY;
+            ssp->slot_emptied();
 
             // reread result from DB, make sure it's still unsent
             // TODO: from here to end of add_result_to_reply()
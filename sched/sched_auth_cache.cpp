@@ -0,0 +1,287 @@
+// This file is part of BOINC.
+// http://boinc.berkeley.edu
+// Copyright (C) 2018 University of California
+//
+// BOINC is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// BOINC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with BOINC.  If not, see <http://www.gnu.org/licenses/>.
+
+// shared-memory cache of host/user/team records; see sched_auth_cache.h
+
+#include "config.h"
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+#include <csignal>
+#include <sched.h>
+#include <unistd.h>
+
+#include "shmem.h"
+#include "util.h"
+
+#include "sched_config.h"
+#include "sched_msgs.h"
+#include "sched_auth_cache.h"
+
+static AUTH_CACHE* acp = 0;
+
+static key_t auth_cache_key() {
+    return config.shmem_key + 1;
+}
+
+static int auth_cache_shmem_size(int n) {
+    return (int)(sizeof(AUTH_CACHE) + n*sizeof(AUTH_CACHE_ENTRY));
+}
+
+int auth_cache_create() {
+    void* p;
+    int n = config.auth_cache_size;
+
+    if (n <= 0) return 0;
+    destroy_shmem(auth_cache_key());
+    int size = auth_cache_shmem_size(n);
+    int retval = create_shmem(auth_cache_key(), size, 0, &p);
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "can't create host/user cache: %s\n", boincerror(retval)
+        );
+        return retval;
+    }
+    acp = (AUTH_CACHE*)p;
+    memset(acp, 0, size);
+    acp->entry_size = sizeof(AUTH_CACHE_ENTRY);
+    acp->nentries = n;
+    log_messages.printf(MSG_NORMAL,
+        "created host/user cache: %d entries, %.1f MB\n",
+        n, size/1e6
+    );
+    return 0;
+}
+
+void auth_cache_destroy() {
+    if (!acp) return;
+    detach_shmem((void*)acp);
+    destroy_shmem(auth_cache_key());
+    acp = 0;
+}
+
+void auth_cache_attach() {
+    void* p;
+
+    if (config.auth_cache_size <= 0) return;
+    int retval = attach_shmem(auth_cache_key(), &p);
+    if (retval || !p) {
+        log_messages.printf(MSG_NORMAL,
+            "can't attach host/user cache; not using it\n"
+        );
+        return;
+    }
+    AUTH_CACHE* ac = (AUTH_CACHE*)p;
+    if (ac->entry_size != (int)sizeof(AUTH_CACHE_ENTRY) || ac->nentries <= 0) {
+        log_messages.printf(MSG_CRITICAL,
+            "host/user cache has wrong format - recompile\n"
+        );
+        detach_shmem(p);
+        return;
+    }
+    acp = ac;
+}
+
+static AUTH_CACHE_ENTRY& get_entry(int type, DB_ID_TYPE id) {
+    unsigned long h = (unsigned long)(id*4 + type) * 2654435761UL;
+    return acp->entries[h % acp->nentries];
+}
+
+// Entries are locked with the PID of the process using them.
+// If we can't get the lock in a reasonable time, skip the cache.
+// If the process holding the lock died, take it over.
+//
+static bool lock_entry(AUTH_CACHE_ENTRY& e) {
+    int pid = getpid();
+    for (int i=0; i<100; i++) {
+        if (__sync_bool_compare_and_swap(&e.lock, 0, pid)) return true;
+        sched_yield();
+    }
+    int holder = e.lock;
+    if (holder && kill(holder, 0) && errno == ESRCH) {
+        return __sync_bool_compare_and_swap(&e.lock, holder, pid);
+    }
+    return false;
+}
+
+static void unlock_entry(AUTH_CACHE_ENTRY& e) {
+    __sync_lock_release(&e.lock);
+}
+
+// Copy a DB record to an entry,
+// storing its BLOB fields (given as a list of offsets, in order)
+// as strings rather than full-size arrays.
+// Return false if it doesn't fit.
+//
+static bool pack(
+    AUTH_CACHE_ENTRY& e, const void* rec, size_t size,
+    const size_t* blobs, int nblobs
+) {
+    const char* in = (const char*)rec;
+    char* out = e.data;
+    char* end = e.data + AUTH_CACHE_DATA_SIZE;
+    size_t pos = 0;
+
+    for (int i=0; i<nblobs; i++) {
+        size_t n = blobs[i] - pos;
+        size_t len = strnlen(in+blobs[i], BLOB_SIZE);
+        if (len == BLOB_SIZE) return false;
+        if (out + n + len + 1 > end) return false;
+        memcpy(out, in+pos, n);
+        out += n;
+        memcpy(out, in+blobs[i], len+1);
+        out += len+1;
+        pos = blobs[i] + BLOB_SIZE;
+    }
+    if (out + (size-pos) > end) return false;
+    memcpy(out, in+pos, size-pos);
+    out += size-pos;
+    e.len = (int)(out - e.data);
+    return true;
+}
+
+static void unpack(
+    const AUTH_CACHE_ENTRY& e, void* rec, size_t size,
+    const size_t* blobs, int nblobs
+) {
+    const char* in = e.data;
+    char* out = (char*)rec;
+    size_t pos = 0;
+
+    for (int i=0; i<nblobs; i++) {
+        size_t n = blobs[i] - pos;
+        memcpy(out+pos, in, n);
+        in += n;
+        size_t len = strlen(in);
+        memcpy(out+blobs[i], in, len+1);
+        in += len+1;
+        pos = blobs[i] + BLOB_SIZE;
+    }
+    memcpy(out+pos, in, size-pos);
+}
+
+static bool cache_get(
+    int type, DB_ID_TYPE id, void* rec, size_t size,
+    const size_t* blobs, int nblobs
+) {
+    if (!acp || !id) return false;
+    AUTH_CACHE_ENTRY& e = get_entry(type, id);
+    if (!lock_entry(e)) return false;
+    bool found = e.type == type && e.id == id
+        && e.time > dtime() - config.auth_cache_ttl;
+    if (found) {
+        unpack(e, rec, size, blobs, nblobs);
+    }
+    unlock_entry(e);
+    return found;
+}
+
+// Add a record.
+// If update is set, the record was modified by us and written to the DB;
+// replace the cached copy only if there is one,
+// and keep the time it was read from the DB,
+// so that changes made elsewhere are seen within auth_cache_ttl.
+//
+static void cache_put(
+    int type, DB_ID_TYPE id, const void* rec, size_t size,
+    const size_t* blobs, int nblobs, bool update=false
+) {
+    if (!acp || !id) return;
+    AUTH_CACHE_ENTRY& e = get_entry(type, id);
+    if (!lock_entry(e)) return;
+    double t = dtime();
+    if (update) {
+        if (e.type != type || e.id != id || e.time <= t - config.auth_cache_ttl) {
+            unlock_entry(e);
+            return;
+        }
+        t = e.time;
+    }
+    if (pack(e, rec, size, blobs, nblobs)) {
+        e.type = type;
+        e.id = id;
+        e.time = t;
+    } else {
+        e.type = 0;
+    }
+    unlock_entry(e);
+}
+
+static const size_t user_blobs[] = {
+    offsetof(USER, global_prefs), offsetof(USER, project_prefs)
+};
+static const size_t team_blobs[] = {
+    offsetof(TEAM, description)
+};
+
+void auth_cache_put_host(HOST& host) {
+    cache_put(AUTH_CACHE_HOST, host.id, &host, sizeof(HOST), NULL, 0);
+}
+
+void auth_cache_update_host(HOST& host) {
+    cache_put(AUTH_CACHE_HOST, host.id, &host, sizeof(HOST), NULL, 0, true);
+}
+
+void auth_cache_put_user(USER& user) {
+    cache_put(AUTH_CACHE_USER, user.id, &user, sizeof(USER), user_blobs, 2);
+}
+
+void auth_cache_invalidate(int type, DB_ID_TYPE id) {
+    if (!acp || !id) return;
+    AUTH_CACHE_ENTRY& e = get_entry(type, id);
+    if (!lock_entry(e)) return;
+    if (e.type == type && e.id == id) {
+        e.type = 0;
+    }
+    unlock_entry(e);
+}
+
+int auth_cache_lookup_host(DB_ID_TYPE id, HOST& host) {
+    if (cache_get(AUTH_CACHE_HOST, id, &host, sizeof(HOST), NULL, 0)) {
+        return 0;
+    }
+    DB_HOST h;
+    int retval = h.lookup_id(id);
+    if (retval) return retval;
+    host = h;
+    auth_cache_put_host(host);
+    return 0;
+}
+
+int auth_cache_lookup_user(DB_ID_TYPE id, USER& user) {
+    if (cache_get(AUTH_CACHE_USER, id, &user, sizeof(USER), user_blobs, 2)) {
+        return 0;
+    }
+    DB_USER u;
+    int retval = u.lookup_id(id);
+    if (retval) return retval;
+    user = u;
+    auth_cache_put_user(user);
+    return 0;
+}
+
+int auth_cache_lookup_team(DB_ID_TYPE id, TEAM& team) {
+    if (cache_get(AUTH_CACHE_TEAM, id, &team, sizeof(TEAM), team_blobs, 1)) {
+        return 0;
+    }
+    DB_TEAM t;
+    int retval = t.lookup_id(id);
+    if (retval) return retval;
+    team = t;
+    cache_put(AUTH_CACHE_TEAM, team.id, &team, sizeof(TEAM), team_blobs, 1);
+    return 0;
+}
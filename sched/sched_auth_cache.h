@@ -0,0 +1,101 @@
+// This file is part of BOINC.
+// http://boinc.berkeley.edu
+// Copyright (C) 2018 University of California
+//
+// BOINC is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// BOINC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with BOINC.  If not, see <http://www.gnu.org/licenses/>.
+
+// AUTH_CACHE is an optional cache, in shared memory,
+// of the host, user and team records of recently active hosts.
+// It lets the scheduler authenticate a request
+// without reading these records from the DB.
+//
+// It's enabled with <auth_cache_size> in config.xml.
+// The feeder creates it (and clears it when restarted);
+// scheduler instances attach to it.
+//
+// - The cache is direct-mapped by (type, ID);
+//   a new record replaces whatever was in its slot.
+// - Records changed by the scheduler are written through
+//   (host record) or removed (user record).
+//   Writing through doesn't extend the life of the entry.
+// - Records changed elsewhere (web site, daemons) may be stale
+//   for up to <auth_cache_ttl> seconds.
+
+#ifndef BOINC_SCHED_AUTH_CACHE_H
+#define BOINC_SCHED_AUTH_CACHE_H
+
+#include "boinc_db.h"
+
+#define AUTH_CACHE_HOST     1
+#define AUTH_CACHE_USER     2
+#define AUTH_CACHE_TEAM     3
+
+#define AUTH_CACHE_DATA_SIZE    16384
+    // user and team records are stored with their BLOB fields packed,
+    // so this is enough unless they have large prefs or descriptions.
+    // Those aren't cached.
+
+struct AUTH_CACHE_ENTRY {
+    int lock;
+        // 0, or PID of process using the entry
+    int type;
+        // AUTH_CACHE_*, or 0 if empty
+    DB_ID_TYPE id;
+    double time;
+        // when the record was read from or written to the DB
+    int len;
+    char data[AUTH_CACHE_DATA_SIZE];
+};
+
+struct AUTH_CACHE {
+    int entry_size;     // sizeof(AUTH_CACHE_ENTRY), to check format
+    int nentries;
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+    AUTH_CACHE_ENTRY entries[];
+#else
+    AUTH_CACHE_ENTRY entries[0];
+#endif
+};
+
+// called by the feeder
+//
+extern int auth_cache_create();
+extern void auth_cache_destroy();
+
+// called by the scheduler
+//
+extern void auth_cache_attach();
+
+// look up a record, in the cache if possible, else in the DB.
+// Records read from the DB are added to the cache.
+//
+extern int auth_cache_lookup_host(DB_ID_TYPE id, HOST&);
+extern int auth_cache_lookup_user(DB_ID_TYPE id, USER&);
+extern int auth_cache_lookup_team(DB_ID_TYPE id, TEAM&);
+
+// add records read from (or written to) the DB
+//
+extern void auth_cache_put_host(HOST&);
+extern void auth_cache_put_user(USER&);
+
+// replace a cached host record after we've updated it in the DB.
+// The entry still expires auth_cache_ttl after it was read from the DB.
+//
+extern void auth_cache_update_host(HOST&);
+
+// remove a record, e.g. after updating some of its fields in the DB
+//
+extern void auth_cache_invalidate(int type, DB_ID_TYPE id);
+
+#endif
@@ -93,6 +93,7 @@ int SCHED_CONFIG::parse(FILE* f) {
     scheduler_log_buffer = 32768;
     version_select_random_factor = 1.;
     maintenance_delay = 3600;
+    auth_cache_ttl = 600;
 
     if (!xp.parse_start("boinc")) return ERR_XML_PARSE;
     if (!xp.parse_start("config")) return ERR_XML_PARSE;
@@ -128,6 +129,7 @@ int SCHED_CONFIG::parse(FILE* f) {
         if (xp.parse_str("db_user", db_user, sizeof(db_user))) continue;
         if (xp.parse_str("db_passwd", db_passwd, sizeof(db_passwd))) continue;
         if (xp.parse_str("db_host", db_host, sizeof(db_host))) continue;
+        if (xp.parse_bool("db_prepared_statements", db_prepared_statements)) continue;
         if (xp.parse_str("replica_db_name", replica_db_name, sizeof(replica_db_name))) continue;
         if (xp.parse_str("replica_db_user", replica_db_user, sizeof(replica_db_user))) continue;
         if (xp.parse_str("replica_db_passwd", replica_db_passwd, sizeof(replica_db_passwd))) continue;
@@ -150,6 +152,8 @@ int SCHED_CONFIG::parse(FILE* f) {
         if (xp.parse_int("uldl_dir_fanout", uldl_dir_fanout)) continue;
         if (xp.parse_bool("cache_md5_info", cache_md5_info)) continue;
         if (xp.parse_int("fuh_debug_level", fuh_debug_level)) continue;
+        if (xp.parse_bool("fuh_check_md5", fuh_check_md5)) continue;
+        if (xp.parse_double("fuh_sync_interval", fuh_sync_interval)) continue;
         if (xp.parse_int("reliable_priority_on_over", reliable_priority_on_over)) continue;
         if (xp.parse_int("reliable_priority_on_over_except_error", reliable_priority_on_over_except_error)) continue;
         if (xp.parse_int("reliable_on_priority", reliable_on_priority)) continue;
@@ -165,6 +169,7 @@ int SCHED_CONFIG::parse(FILE* f) {
         if (xp.parse_bool("distinct_beta_apps", distinct_beta_apps)) continue;
         if (xp.parse_bool("ended", ended)) continue;
         if (xp.parse_int("shmem_work_items", shmem_work_items)) continue;
+        if (xp.parse_bool("shmem_job_index", shmem_job_index)) continue;
         if (xp.parse_int("feeder_query_size", feeder_query_size)) continue;
         if (xp.parse_str("httpd_user", httpd_user, sizeof(httpd_user))) continue;
         if (xp.parse_bool("enable_vda", enable_vda)) continue;
@@ -195,6 +200,9 @@ int SCHED_CONFIG::parse(FILE* f) {
             }
             continue;
         }
+        if (xp.parse_int("auth_cache_size", auth_cache_size)) continue;
+        if (xp.parse_double("auth_cache_ttl", auth_cache_ttl)) continue;
+        if (xp.parse_bool("batch_result_updates", batch_result_updates)) continue;
         if (xp.parse_int("dont_search_host_for_user", retval)) {
             dont_search_host_for_userid.push_back(retval);
             continue;
@@ -232,6 +240,8 @@ int SCHED_CONFIG::parse(FILE* f) {
         }
         if (xp.parse_bool("sched_old", sched_old)) continue;
         if (xp.parse_int("max_ncpus", max_ncpus)) continue;
+        if (xp.parse_int("max_file_infos_accepted", max_file_infos_accepted)) continue;
+        if (xp.parse_int("max_other_results_accepted", max_other_results_accepted)) continue;
         if (xp.parse_int("max_wus_in_progress", itemp)) {
             max_jobs_in_progress.project_limits.proc_type_limits[PROC_TYPE_CPU].base_limit = itemp;
             max_jobs_in_progress.project_limits.proc_type_limits[PROC_TYPE_CPU].per_proc = true;
@@ -47,6 +47,8 @@ struct SCHED_CONFIG {
     char db_user[256];
     char db_passwd[256];
     char db_host[256];
+    bool db_prepared_statements;
+        // scheduler and feeder use prepared statements for hot queries
     char replica_db_name[256];
     char replica_db_user[256];
     char replica_db_passwd[256];
@@ -73,6 +75,14 @@ struct SCHED_CONFIG {
     int uldl_dir_fanout;        // fanout of ul/dl dirs; 0 if none
     bool cache_md5_info;
     int fuh_debug_level;
+    bool fuh_check_md5;
+        // file upload handler: compute the MD5 of uploaded files
+        // while writing them, and reject files that don't match
+        // the checksum sent by the client
+    double fuh_sync_interval;
+        // file upload handler: if nonzero, start writeback of
+        // each uploaded file when it's complete, and (FCGI version)
+        // sync the upload filesystem at most this often (seconds)
     int reliable_priority_on_over;
         // additional results generated after at least one result
         // is over will have their priority boosted by this amount    
@@ -89,6 +99,9 @@ struct SCHED_CONFIG {
         // Project has ended - tell clients to detach
     int shmem_work_items;
         // number of work items in shared memory
+    bool shmem_job_index;
+        // feeder maintains an index of the work items by (app, size class);
+        // schedulers use it instead of scanning and locking the whole array
     int feeder_query_size;
         // number of work items to request in each feeder query
     char httpd_user[256];
@@ -102,8 +115,18 @@ struct SCHED_CONFIG {
 
     //////////// STUFF RELEVANT ONLY TO SCHEDULER FOLLOWS ///////////
 
+    int auth_cache_size;
+        // if nonzero, the feeder creates a shared-memory cache
+        // of this many host/user/team records (16 KB each;
+        // shmem key is shmem_key+1), used to authenticate requests
+    double auth_cache_ttl;
+        // use cached records at most this old (default 600 sec).
+        // Bounds staleness for changes made outside the scheduler.
     vector<regex_t> *ban_cpu;
     vector<regex_t> *ban_os;
+    bool batch_result_updates;
+        // update reported results with a few multi-row queries
+        // rather than one query per result
     int daily_result_quota;         // max results per day is this * mult
     char debug_req_reply_dir[256];
         // keep sched_request and sched_reply in files in this directory
@@ -125,13 +148,20 @@ struct SCHED_CONFIG {
     vector<regex_t> *locality_scheduling_sticky_file;
     bool sched_old;
     int max_download_urls_per_file;
+    int max_file_infos_accepted;
+        // keep at most this many <file_info>s from a request
+        // (locality scheduling; hosts can have huge numbers of files)
     int max_ncpus;
+    int max_other_results_accepted;
+        // keep at most this many <other_result>s from a request.
+        // If there are more, don't resend lost jobs to the host.
     JOB_LIMITS max_jobs_in_progress;
     int max_results_accepted;
         // skip reported jobs beyond this limit
         // (they'll get reported in the next RPC)
         // This limits the memory usage of the scheduler;
         // otherwise it can crash if the client is reporting thousands of jobs.
+        // report_max, if smaller, is also applied while parsing.
     int max_wus_to_send;            // max results per RPC is this * mult
     int min_core_client_version;
     int min_core_client_version_announced;
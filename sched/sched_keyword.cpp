@@ -85,8 +85,16 @@ void keyword_sched_remove_job(int i) {
     job_keywords_array[i].clear();
 }
 
-// called at CGI start to initialize job keyword array
+// called at the start of each request to initialize job keyword array.
+// A fast CGI process handles many requests, and other processes
+// may have changed the job array in between; so clear, don't reuse.
 //
 void keyword_sched_init() {
-    job_keywords_array = new JOB_KEYWORD_IDS[ssp->max_wu_results];
+    if (!job_keywords_array) {
+        job_keywords_array = new JOB_KEYWORD_IDS[ssp->max_wu_results];
+        return;
+    }
+    for (int i=0; i<ssp->max_wu_results; i++) {
+        job_keywords_array[i].clear();
+    }
 }
@@ -21,6 +21,13 @@
 // - manually for debugging, with a single request
 // - for simulation or performance testing, with a stream of requests
 //   (using --batch)
+// - (fast CGI version only) as a standalone FastCGI server
+//   (using --fcgi_socket and --fcgi_workers).
+//   This opens the listening socket itself and forks a pool of
+//   persistent worker processes, each handling requests in turn
+//   with its own DB connection and shared-memory attachment.
+//   Config files are parsed once, before the workers are forked;
+//   restart the server to pick up changes.
 
 // TODO: what does the following mean?
 // Also, You can call debug_sched() for whatever situation is of
@@ -47,6 +54,10 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#ifdef _USING_FCGI_
+#include <sys/wait.h>
+#include <fcgiapp.h>
+#endif
 
 #include "boinc_db.h"
 #include "error_numbers.h"
@@ -59,6 +70,7 @@
 #include "util.h"
 
 #include "handle_request.h"
+#include "sched_auth_cache.h"
 #include "sched_config.h"
 #include "sched_files.h"
 #include "sched_keyword.h"
@@ -95,6 +107,11 @@ static void usage(char* p) {
         "  --mark_jobs_done   When send a job, also mark it as done.\n"
         "                     (for performance testing)\n"
         "  --debug_log        Write messages to the file 'debug_log'\n"
+#ifdef _USING_FCGI_
+        "  --fcgi_socket X    Run as a FastCGI server listening on X\n"
+        "                     (a Unix socket path, or :port for TCP)\n"
+        "  --fcgi_workers N   Number of worker processes (default 4)\n"
+#endif
         "  --simulator X      Start with simulated time X\n"
         "                     (only if compiled with GCL_SIMULATOR)\n"
         "  -h | --help        Show this help text\n"
@@ -203,6 +220,7 @@ int open_database() {
         log_messages.printf(MSG_CRITICAL, "can't open database\n");
         return retval;
     }
+    boinc_db.use_prepared = config.db_prepared_statements;
     db_opened = true;
     return 0;
 }
@@ -342,6 +360,7 @@ void attach_to_feeder_shmem() {
             exit(0);
         }
     }
+    auth_cache_attach();
 
     all_apps_use_hr = true;
     for (i=0; i<ssp->napps; i++) {
@@ -352,6 +371,121 @@ void attach_to_feeder_shmem() {
     }
 }
 
+#ifdef _USING_FCGI_
+
+#define DEFAULT_FCGI_WORKERS    4
+
+#define FCGI_WORKER_MIN_LIFETIME    10
+    // if a worker exits sooner than this after it started,
+    // wait this long before starting another one in its place
+
+static volatile sig_atomic_t fcgi_server_stop = 0;
+
+static void fcgi_server_sigterm_handler(int) {
+    fcgi_server_stop = 1;
+}
+
+// Open a FastCGI listening socket and make it the socket
+// FCGI_Accept() uses (descriptor 0).
+// Then fork the given number of workers and return in each of them.
+// The parent doesn't return;
+// it waits for workers to exit and replaces them.
+// On SIGTERM it passes the signal on to the workers,
+// waits for them to exit, and exits.
+//
+static void run_fcgi_server(const char* socket_path, int nworkers) {
+    vector<int> pids(nworkers, 0);
+    vector<double> start_times(nworkers, 0);
+    vector<double> restart_times(nworkers, 0);
+    int i, pid, status, nrunning = 0;
+
+    int sock = FCGX_OpenSocket(socket_path, 1024);
+    if (sock < 0) {
+        fprintf(stderr, "FCGI: can't open socket %s\n", socket_path);
+        exit(1);
+    }
+    if (sock != 0) {
+        if (dup2(sock, 0) < 0) {
+            fprintf(stderr, "FCGI: dup2() failed: %d\n", errno);
+            exit(1);
+        }
+        close(sock);
+    }
+    log_messages.printf(MSG_NORMAL,
+        "FCGI: listening on %s with %d workers\n", socket_path, nworkers
+    );
+    signal(SIGTERM, fcgi_server_sigterm_handler);
+
+    while (!fcgi_server_stop) {
+        double now = dtime();
+        for (i=0; i<nworkers; i++) {
+            if (pids[i] || now < restart_times[i]) continue;
+            fflush((FILE*)NULL);
+            pid = fork();
+            if (pid < 0) {
+                log_messages.printf(MSG_CRITICAL,
+                    "FCGI: fork() failed: %d\n", errno
+                );
+                restart_times[i] = now + FCGI_WORKER_MIN_LIFETIME;
+                continue;
+            }
+            if (pid == 0) {
+                signal(SIGTERM, sigterm_handler);
+                log_messages.pid = getpid();
+                srand(time(0)+getpid());
+                return;
+            }
+            pids[i] = pid;
+            start_times[i] = now;
+            nrunning++;
+        }
+        pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0) {
+            boinc_sleep(1);
+            continue;
+        }
+        for (i=0; i<nworkers; i++) {
+            if (pids[i] != pid) continue;
+            pids[i] = 0;
+            nrunning--;
+            now = dtime();
+            if (now < start_times[i] + FCGI_WORKER_MIN_LIFETIME) {
+                restart_times[i] = now + FCGI_WORKER_MIN_LIFETIME;
+                log_messages.printf(MSG_CRITICAL,
+                    "FCGI: worker %d exited with status %d; restarting in %d sec\n",
+                    pid, status, FCGI_WORKER_MIN_LIFETIME
+                );
+            } else {
+                log_messages.printf(MSG_NORMAL,
+                    "FCGI: worker %d exited with status %d; restarting\n",
+                    pid, status
+                );
+            }
+        }
+    }
+
+    log_messages.printf(MSG_NORMAL, "FCGI: caught SIGTERM; stopping workers\n");
+    for (i=0; i<nworkers; i++) {
+        if (pids[i]) kill(pids[i], SIGTERM);
+    }
+    while (nrunning) {
+        pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (i=0; i<nworkers; i++) {
+            if (pids[i] == pid) {
+                pids[i] = 0;
+                nrunning--;
+            }
+        }
+    }
+    log_messages.printf(MSG_NORMAL, "FCGI: all workers have exited\n");
+    exit(0);
+}
+#endif
+
 inline static const char* get_remote_addr() {
     const char * r = getenv("REMOTE_ADDR");
     return r ? r : "?.?.?.?";
@@ -387,6 +521,10 @@ int main(int argc, char** argv) {
     int length = -1;
     log_messages.pid = getpid();
     bool debug_log = false;
+#ifdef _USING_FCGI_
+    const char* fcgi_socket = NULL;
+    int fcgi_workers = DEFAULT_FCGI_WORKERS;
+#endif
 
     for (i=1; i<argc; i++) {
         if (!strcmp(argv[i], "--batch")) {
@@ -396,6 +534,23 @@ int main(int argc, char** argv) {
             mark_jobs_done = true;
         } else if (!strcmp(argv[i], "--debug_log")) {
             debug_log = true;
+#ifdef _USING_FCGI_
+        } else if (!strcmp(argv[i], "--fcgi_socket")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            fcgi_socket = argv[i];
+        } else if (!strcmp(argv[i], "--fcgi_workers")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            fcgi_workers = atoi(argv[i]);
+            if (fcgi_workers < 1) fcgi_workers = 1;
+#endif
 #ifdef GCL_SIMULATOR
         } else if (!strcmp(argv[i], "--simulator")) {
             if(!argv[++i]) {
@@ -517,6 +672,11 @@ int main(int argc, char** argv) {
     }
     strip_whitespace(code_sign_key);
 
+#ifdef _USING_FCGI_
+    if (fcgi_socket) {
+        run_fcgi_server(fcgi_socket, fcgi_workers);
+    }
+#endif
 
     g_pid = getpid();
 #ifdef _USING_FCGI_
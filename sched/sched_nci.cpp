@@ -84,10 +84,11 @@ static int send_job_for_app(APP& app) {
             );
             return -1;
         }
-        wu_result.state = g_pid;
+        if (!wu_result.claim(g_pid)) continue;
         unlock_sema();
         result.id = wu_result.resultid;
         wu_result.state = WR_STATE_EMPTY;
+        ssp->slot_emptied();
         if (result_still_sendable(result, wu)) {
             if (config.debug_send) {
                 log_messages.printf(MSG_NORMAL,
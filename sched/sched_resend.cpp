@@ -133,6 +133,16 @@ bool resend_lost_work() {
         }
         if (found) continue;
 
+        // reported, but beyond the limit on reported results
+        //
+        for (i=0; i<g_request->unhandled_result_names.size(); i++) {
+            if (g_request->unhandled_result_names[i] == result.name) {
+                found = true;
+                break;
+            }
+        }
+        if (found) continue;
+
         num_eligible_to_resend++;
         if (config.debug_resend) {
             log_messages.printf(MSG_NORMAL,
@@ -425,12 +425,21 @@ int handle_results() {
     } // loop over all incoming results
 
     // Update the result records
-    // (skip items that we previously marked to skip)
+    // (skip items that we previously marked to skip).
+    // If <batch_result_updates> is set, do this with multi-row queries.
     //
+    vector<int> update_retvals;
+    if (config.batch_result_updates) {
+        result_handler.update_results(update_retvals);
+    }
     for (i=0; i<result_handler.results.size(); i++) {
         SCHED_RESULT_ITEM& sri = result_handler.results[i];
         if (sri.id == 0) continue;
-        retval = result_handler.update_result(sri);
+        if (config.batch_result_updates) {
+            retval = update_retvals[i];
+        } else {
+            retval = result_handler.update_result(sri);
+        }
         if (retval) {
             log_messages.printf(MSG_CRITICAL,
                 "[HOST#%lu] [RESULT#%lu] [WU#%lu] can't update result: %s\n",
@@ -174,19 +174,73 @@ static void restore_others(int rt) {
     }
 }
 
-// send work for a particular processor type
+// If the job in the given slot can be sent, score it and add it to the list
 //
-void send_work_score_type(int rt) {
-    vector<JOB> jobs;
+static void add_job_for_slot(int i, vector<JOB>& jobs) {
+    WU_RESULT& wu_result = ssp->wu_results[i];
+    if (wu_result.state != WR_STATE_PRESENT  && wu_result.state != g_pid) {
+        return;
+    }
+    WORKUNIT wu = wu_result.workunit;
+    JOB job;
+    job.app = ssp->lookup_app(wu.appid);
+    if (job.app->non_cpu_intensive) {
+        if (config.debug_send_job) {
+            log_messages.printf(MSG_NORMAL,
+                "[send_job] [RESULT#%lu] app is non compute intensive\n",
+                wu_result.resultid
+            );
+        }
+        return;
+    }
+    job.bavp = get_app_version(wu, true, false);
+    if (!job.bavp) {
+        if (config.debug_send_job) {
+            log_messages.printf(MSG_NORMAL,
+                "[send_job] [RESULT#%lu] no app version available\n",
+                wu_result.resultid
+            );
+        }
+        return;
+    }
 
-    if (config.debug_send_scan) {
+    job.index = i;
+    job.result_id = wu_result.resultid;
+    if (!job.get_score(i)) {
+        if (config.debug_send_job) {
+            log_messages.printf(MSG_NORMAL,
+                "[send_job] [RESULT#%lu] get_score() returned false\n",
+                wu_result.resultid
+            );
+        }
+        return;
+    }
+    if (config.debug_send_job) {
         log_messages.printf(MSG_NORMAL,
-            "[send_scan] scanning for %s jobs\n", proc_type_name(rt)
+            "[send_job] [RESULT#%lu] score: %f\n",
+            wu_result.resultid, job.score
         );
     }
+    jobs.push_back(job);
+}
 
-    clear_others(rt);
+// return true if get_score() would reject all jobs for this app,
+// so that we can skip its job index buckets
+//
+static bool app_is_excluded(APP& app) {
+    if (app.non_cpu_intensive) return true;
+    if (app.beta && !g_wreq->project_prefs.allow_beta_work) return true;
+    if (app_not_selected(app.id)
+        && !g_wreq->project_prefs.allow_non_preferred_apps
+    ) {
+        return true;
+    }
+    return false;
+}
 
+// get candidate jobs by scanning the entire job array
+//
+static void scan_job_array(vector<JOB>& jobs) {
     int nscan = ssp->max_wu_results;
     int rnd_off = rand() % ssp->max_wu_results;
     if (config.debug_send_scan) {
@@ -196,51 +250,71 @@ void send_work_score_type(int rt) {
     }
     for (int j=0; j<nscan; j++) {
         int i = (j+rnd_off) % ssp->max_wu_results;
-        WU_RESULT& wu_result = ssp->wu_results[i];
-        if (wu_result.state != WR_STATE_PRESENT  && wu_result.state != g_pid) {
-            continue;
-        }
-        WORKUNIT wu = wu_result.workunit;
-        JOB job;
-        job.app = ssp->lookup_app(wu.appid);
-        if (job.app->non_cpu_intensive) {
-            if (config.debug_send_job) {
-                log_messages.printf(MSG_NORMAL,
-                    "[send_job] [RESULT#%lu] app is non compute intensive\n",
-                    wu_result.resultid
-                );
-            }
-            continue;
-        }
-        job.bavp = get_app_version(wu, true, false);
-        if (!job.bavp) {
-            if (config.debug_send_job) {
+        add_job_for_slot(i, jobs);
+    }
+}
+
+// get candidate jobs using the job index,
+// looking only at the buckets of apps we can send
+//
+static void scan_job_index(vector<JOB>& jobs) {
+    int gen = ssp->job_index_gen;
+    JOB_INDEX& ji = ssp->job_index[gen];
+    int nscan = 0;
+    if (!ssp->napps) return;
+    int rnd_off = rand() % ssp->napps;
+    for (int j=0; j<ssp->napps; j++) {
+        int app_index = (j+rnd_off) % ssp->napps;
+        APP& app = ssp->apps[app_index];
+        if (app_is_excluded(app)) {
+            if (config.debug_send_scan) {
                 log_messages.printf(MSG_NORMAL,
-                    "[send_job] [RESULT#%lu] no app version available\n",
-                    wu_result.resultid
+                    "[send_scan] skipping jobs for app %s\n", app.name
                 );
             }
             continue;
         }
+        for (int k=0; k<MAX_SIZE_CLASSES; k++) {
+            int b = SCHED_SHMEM::job_index_bucket(app_index, k);
+            int n = ji.count[b];
 
-        job.index = i;
-        job.result_id = wu_result.resultid;
-        if (!job.get_score(i)) {
-            if (config.debug_send_job) {
-                log_messages.printf(MSG_NORMAL,
-                    "[send_job] [RESULT#%lu] get_score() returned false\n",
-                    wu_result.resultid
-                );
+            // the lists may change under us if the feeder
+            // rebuilds the index twice during the traversal;
+            // the count keeps us from looping
+            //
+            int i = ji.head[b];
+            for (int m=0; m<n && i>=0 && i<ssp->max_wu_results; m++) {
+                add_job_for_slot(i, jobs);
+                i = ssp->wu_results[i].next[gen];
+                nscan++;
             }
-            continue;
-        }
-        if (config.debug_send_job) {
-            log_messages.printf(MSG_NORMAL,
-                "[send_job] [RESULT#%lu] score: %f\n",
-                wu_result.resultid, job.score
-            );
         }
-        jobs.push_back(job);
+    }
+    if (config.debug_send_scan) {
+        log_messages.printf(MSG_NORMAL,
+            "[send_scan] scanned %d of %d slots using job index\n",
+            nscan, ssp->max_wu_results
+        );
+    }
+}
+
+// send work for a particular processor type
+//
+void send_work_score_type(int rt) {
+    vector<JOB> jobs;
+
+    if (config.debug_send_scan) {
+        log_messages.printf(MSG_NORMAL,
+            "[send_scan] scanning for %s jobs\n", proc_type_name(rt)
+        );
+    }
+
+    clear_others(rt);
+
+    if (ssp->job_index_enabled) {
+        scan_job_index(jobs);
+    } else {
+        scan_job_array(jobs);
     }
 
     std::sort(jobs.begin(), jobs.end(), job_compare);
@@ -272,13 +346,15 @@ void send_work_score_type(int rt) {
             continue;
         }
 
-        if (!sema_locked) {
+        // if using the job index, slots are reserved using claim()
+        // and we don't need the semaphore
+        //
+        if (!sema_locked && !ssp->job_index_enabled) {
             lock_sema();
             sema_locked = true;
         }
 
         // make sure the job is still in the cache
-        // array is locked at this point.
         //
         WU_RESULT& wu_result = ssp->wu_results[job.index];
         if (wu_result.state != WR_STATE_PRESENT  && wu_result.state != g_pid) {
@@ -299,13 +375,25 @@ void send_work_score_type(int rt) {
         if (retval) {
             continue;
         }
-        wu_result.state = g_pid;
+        if (!wu_result.claim(g_pid)) {
+            continue;
+        }
+
+        // if not locked, the slot may have been refilled
+        // since we checked it
+        //
+        if (wu_result.resultid != job.result_id) {
+            wu_result.state = WR_STATE_PRESENT;
+            continue;
+        }
 
         // It passed fast checks.
         // Release sema and do slow checks
         //
-        unlock_sema();
-        sema_locked = false;
+        if (sema_locked) {
+            unlock_sema();
+            sema_locked = false;
+        }
 
         switch (slow_check(wu_result, job.app, job.bavp)) {
         case CHECK_NO_HOST:
@@ -313,6 +401,7 @@ void send_work_score_type(int rt) {
             break;
         case CHECK_NO_ANY:
             wu_result.state = WR_STATE_EMPTY;
+            ssp->slot_emptied();
             if (config.keyword_sched) {
                 keyword_sched_remove_job(job.index);
             }
@@ -328,6 +417,7 @@ void send_work_score_type(int rt) {
             // (since otherwise feeder might overwrite it)
             //
             wu_result.state = WR_STATE_EMPTY;
+            ssp->slot_emptied();
             if (config.keyword_sched) {
                 keyword_sched_remove_job(job.index);
             }
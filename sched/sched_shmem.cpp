@@ -59,6 +59,12 @@ void SCHED_SHMEM::init(int nwu_results) {
     max_app_versions = MAX_APP_VERSIONS;
     max_assignments = MAX_ASSIGNMENTS;
     max_wu_results = nwu_results;
+    job_index_enabled = config.shmem_job_index;
+    for (int i=0; i<2; i++) {
+        for (int j=0; j<JOB_INDEX_NBUCKETS; j++) {
+            job_index[i].head[j] = -1;
+        }
+    }
 }
 
 static int error_return(const char* p, int expe, int got) {
@@ -294,6 +300,13 @@ APP* SCHED_SHMEM::lookup_app(DB_ID_TYPE id) {
     return NULL;
 }
 
+int SCHED_SHMEM::lookup_app_index(DB_ID_TYPE id) {
+    for (int i=0; i<napps; i++) {
+        if (apps[i].id == id) return i;
+    }
+    return -1;
+}
+
 APP* SCHED_SHMEM::lookup_app_name(char* name) {
     for (int i=0; i<napps; i++) {
         if (!strcmp(name, apps[i].name)) return &apps[i];
@@ -334,8 +347,9 @@ bool SCHED_SHMEM::no_work(int pid) {
     if (!ready) return true;
     for (int i=0; i<max_wu_results; i++) {
         if (wu_results[i].state == WR_STATE_PRESENT) {
-            wu_results[i].state = pid;
-            return false;
+            if (wu_results[i].claim(pid)) {
+                return false;
+            }
         }
     }
     return true;
@@ -350,6 +364,81 @@ void SCHED_SHMEM::restore_work(int pid) {
     }
 }
 
+// Rebuild the job index from the current contents of the array.
+// Build it in the non-current copy, then make that copy current.
+// Called by the feeder only.
+//
+void SCHED_SHMEM::build_job_index() {
+    int gen = 1 - job_index_gen;
+    JOB_INDEX& ji = job_index[gen];
+    int i;
+
+    for (i=0; i<JOB_INDEX_NBUCKETS; i++) {
+        ji.head[i] = -1;
+        ji.count[i] = 0;
+    }
+
+    // go backwards so that each list is in slot order
+    //
+    for (i=max_wu_results-1; i>=0; i--) {
+        WU_RESULT& wu_result = wu_results[i];
+        wu_result.next[gen] = -1;
+        if (wu_result.state == WR_STATE_EMPTY) continue;
+        int app_index = lookup_app_index(wu_result.workunit.appid);
+        if (app_index < 0) continue;
+        int b = job_index_bucket(app_index, wu_result.workunit.size_class);
+        wu_result.next[gen] = ji.head[b];
+        ji.head[b] = i;
+        ji.count[b]++;
+    }
+
+    // make sure the new copy is visible before we switch to it
+    //
+    __sync_synchronize();
+    job_index_gen = gen;
+}
+
+void SCHED_SHMEM::show_job_index(FILE* f) {
+    if (!job_index_enabled) {
+        fprintf(f, "job index not enabled\n");
+        return;
+    }
+    int gen = job_index_gen;
+    JOB_INDEX& ji = job_index[gen];
+    fprintf(f, "job index (copy %d):\n", gen);
+    fprintf(f, "%12s %10s %6s %8s %8s  %s\n",
+        "app", "size class", "slots", "present", "reserved", "slot list"
+    );
+    for (int i=0; i<napps; i++) {
+        for (int j=0; j<MAX_SIZE_CLASSES; j++) {
+            int b = job_index_bucket(i, j);
+            if (ji.count[b] == 0) continue;
+            int npresent = 0, nreserved = 0;
+            fprintf(f, "%12.12s %10d %6d ", apps[i].name, j, ji.count[b]);
+            std::string slots;
+            int k = 0;
+            for (int n=ji.head[b]; n>=0 && k<ji.count[b]; n=wu_results[n].next[gen], k++) {
+                char buf[32];
+                switch (wu_results[n].state) {
+                case WR_STATE_EMPTY:
+                    sprintf(buf, " %d-", n);
+                    break;
+                case WR_STATE_PRESENT:
+                    npresent++;
+                    sprintf(buf, " %d", n);
+                    break;
+                default:
+                    nreserved++;
+                    sprintf(buf, " %d*", n);
+                }
+                slots += buf;
+            }
+            fprintf(f, "%8d %8d  %s\n", npresent, nreserved, slots.c_str());
+        }
+    }
+    fprintf(f, "(- = emptied since index was built, * = reserved)\n");
+}
+
 void SCHED_SHMEM::show(FILE* f) {
     fprintf(f, "apps:\n");
     for (int i=0; i<napps; i++) {
@@ -392,6 +481,7 @@ void SCHED_SHMEM::show(FILE* f) {
     );
     fprintf(f, "ready: %d\n", ready);
     fprintf(f, "max_wu_results: %d\n", max_wu_results);
+    fprintf(f, "job index: %s\n", job_index_enabled?"yes":"no");
     for (int i=0; i<max_wu_results; i++) {
         if (i%24 == 0) {
             fprintf(f,
@@ -63,6 +63,29 @@
 // If neither of the above, the value is the PID of a scheduler process
 // that has this item reserved
 
+// The job index (enabled by <shmem_job_index/> in config.xml)
+// groups the slots of the job array into buckets by (app, size class),
+// so that a scheduler can skip apps it can't use
+// without looking at each of their slots.
+// Each bucket is a list threaded through WU_RESULT.next[].
+//
+// The feeder rebuilds the index after each scan of the array,
+// alternating between two copies so that a scheduler traversing
+// the current copy isn't disturbed.
+// Schedulers use the index without locking the semaphore,
+// and reserve slots with WU_RESULT::claim().
+// The index is only a hint; a slot's state and result ID
+// must be checked after it's claimed.
+//
+#define JOB_INDEX_NBUCKETS  (MAX_APPS*MAX_SIZE_CLASSES)
+
+struct JOB_INDEX {
+    int head[JOB_INDEX_NBUCKETS];
+        // first slot in bucket, or -1
+    int count[JOB_INDEX_NBUCKETS];
+        // number of slots in bucket when index was built
+};
+
 // a workunit/result pair
 struct WU_RESULT {
     int state;
@@ -76,6 +99,16 @@ struct WU_RESULT {
     int res_server_state;
     double res_report_deadline;
     double fpops_size;      // measured in stdevs
+    int next[2];
+        // next slot in the same job index bucket, or -1
+
+    // atomically change state from PRESENT to the given PID.
+    // Return false if another process reserved the slot first.
+    //
+    bool claim(int pid) {
+        if (state == pid) return true;
+        return __sync_bool_compare_and_swap(&state, WR_STATE_PRESENT, pid);
+    }
 };
 
 // this struct is followed in memory by an array of WU_RESULTS
@@ -104,6 +137,12 @@ struct SCHED_SHMEM {
     bool have_nci_app;
     bool have_apps_for_proc_type[NPROC_TYPES];
     PERF_INFO perf_info;
+    int nslots_emptied;
+        // incremented by schedulers when they empty a slot;
+        // the feeder watches this to refill slots quickly
+    bool job_index_enabled;
+    int job_index_gen;      // which element of job_index[] is current
+    JOB_INDEX job_index[2];
     PLATFORM platforms[MAX_PLATFORMS];
     APP apps[MAX_APPS];
     APP_VERSION app_versions[MAX_APP_VERSIONS];
@@ -122,11 +161,23 @@ struct SCHED_SHMEM {
     void restore_work(int pid);
 #ifndef _USING_FCGI_
     void show(FILE*);
+    void show_job_index(FILE*);
 #else
     void show(FCGI_FILE*);
+    void show_job_index(FCGI_FILE*);
 #endif
+    void build_job_index();
+    void slot_emptied() {
+        __sync_fetch_and_add(&nslots_emptied, 1);
+    }
+    static int job_index_bucket(int app_index, int size_class) {
+        if (size_class < 0) size_class = 0;
+        if (size_class >= MAX_SIZE_CLASSES) size_class = MAX_SIZE_CLASSES-1;
+        return app_index*MAX_SIZE_CLASSES + size_class;
+    }
 
     APP* lookup_app(DB_ID_TYPE);
+    int lookup_app_index(DB_ID_TYPE);
     APP* lookup_app_name(char*);
     APP_VERSION* lookup_app_version(DB_ID_TYPE);
     APP_VERSION* lookup_app_version_platform_plan_class(
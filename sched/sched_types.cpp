@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <cassert>
 #include <vector>
+#include <set>
 #include <string>
 #include <cstring>
 
@@ -268,6 +269,8 @@ void SCHEDULER_REQUEST::clear() {
     global_prefs.defaults();
     strcpy(global_prefs_source_email_hash, "");
     results_truncated = false;
+    unhandled_result_names.clear();
+    file_infos_truncated = false;
     have_other_results_list = false;
     have_ip_results_list = false;
     have_time_stats_log = false;
@@ -284,6 +287,15 @@ void SCHEDULER_REQUEST::clear() {
 const char* SCHEDULER_REQUEST::parse(XML_PARSER& xp) {
     SCHED_DB_RESULT result;
     int retval;
+    std::set<std::string> result_names;
+
+    // Reported jobs beyond report_max would be dropped later anyway,
+    // so don't keep them; each one takes a few hundred KB.
+    //
+    int max_results = config.max_results_accepted;
+    if (config.report_max && (!max_results || config.report_max < max_results)) {
+        max_results = config.report_max;
+    }
 
     strcpy(authenticator, "");
     strcpy(platform.name, "");
@@ -315,6 +327,8 @@ const char* SCHEDULER_REQUEST::parse(XML_PARSER& xp) {
     sandbox = -1;
     allow_multiple_clients = -1;
     results_truncated = false;
+    unhandled_result_names.clear();
+    file_infos_truncated = false;
     uptime = 0;
     previous_uptime = 0;
 
@@ -454,21 +468,15 @@ const char* SCHEDULER_REQUEST::parse(XML_PARSER& xp) {
                 file_xfer_results.push_back(result);
                 continue;
             }
-            if (config.max_results_accepted && (int)(results.size()) >= config.max_results_accepted) {
+            if (max_results && (int)(results.size()) >= max_results) {
                 results_truncated = true;
+                unhandled_result_names.push_back(result.name);
                 continue;
             }
             // check if client is sending the same result twice.
             // Shouldn't happen, but if it does bad things will happen
             //
-            bool found = false;
-            for (unsigned int i=0; i<results.size(); i++) {
-                if (!strcmp(results[i].name, result.name)) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
+            if (result_names.insert(result.name).second) {
                 results.push_back(result);
             }
             continue;
@@ -487,6 +495,21 @@ const char* SCHEDULER_REQUEST::parse(XML_PARSER& xp) {
             continue;
         }
         if (xp.match_tag("file_info")) {
+            if (config.max_file_infos_accepted
+                && (int)(file_infos.size()) >= config.max_file_infos_accepted
+            ) {
+                // skip without parsing
+                //
+                if (!file_infos_truncated) {
+                    log_messages.printf(MSG_NORMAL,
+                        "Request has more than %d file infos; ignoring the rest\n",
+                        config.max_file_infos_accepted
+                    );
+                    file_infos_truncated = true;
+                }
+                xp.skip_unexpected();
+                continue;
+            }
             FILE_INFO fi;
             retval = fi.parse(xp);
             if (!retval) {
@@ -502,6 +525,21 @@ const char* SCHEDULER_REQUEST::parse(XML_PARSER& xp) {
             while (!xp.get_tag()) {
                 if (xp.match_tag("/other_results")) break;
                 if (xp.match_tag("other_result")) {
+                    if (config.max_other_results_accepted
+                        && (int)(other_results.size()) >= config.max_other_results_accepted
+                    ) {
+                        if (have_other_results_list) {
+                            log_messages.printf(MSG_NORMAL,
+                                "Request has more than %d other results; ignoring the rest\n",
+                                config.max_other_results_accepted
+                            );
+                        }
+                        // with a partial list we'd think jobs were lost
+                        //
+                        have_other_results_list = false;
+                        xp.skip_unexpected();
+                        continue;
+                    }
                     OTHER_RESULT o_r;
                     retval = o_r.parse(xp);
                     if (!retval) {
@@ -19,6 +19,7 @@
 #define BOINC_SCHED_TYPES_H
 
 #include <cstdio>
+#include <deque>
 #include <vector>
 
 #include "boinc_db.h"
@@ -309,16 +310,22 @@ struct SCHEDULER_REQUEST {
     HOST host;      // request message is parsed into here.
                     // does NOT contain the full host record.
     COPROCS coprocs;
-    std::vector<SCHED_DB_RESULT> results;
-        // completed results being reported
+    std::deque<SCHED_DB_RESULT> results;
+        // completed results being reported.
+        // A deque, since these are big and a vector would copy them
+        // each time it grows.
     bool results_truncated;
         // set if (to limit memory usage) we capped this size of "results"
-        // In this case, don't resend lost results
-        // since we don't know what was lost.
+    std::vector<std::string> unhandled_result_names;
+        // names of the reported results beyond the cap.
+        // They're reported again in the next RPC;
+        // resend_lost_work() must not treat them as lost.
     std::vector<RESULT> file_xfer_results;
     std::vector<MSG_FROM_HOST_DESC> msgs_from_host;
     std::vector<FILE_INFO> file_infos;
         // sticky files reported by host
+    bool file_infos_truncated;
+        // more than config.max_file_infos_accepted
 
     // temps used by locality scheduling:
     std::vector<FILE_INFO> file_delete_candidates;
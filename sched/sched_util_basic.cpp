@@ -24,7 +24,9 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <fcntl.h>
+#include <vector>
 
 #include "error_numbers.h"
 #include "filesys.h"
@@ -99,6 +101,79 @@ void daemon_sleep(int nsecs) {
     }
 }
 
+static int fork_worker(int index) {
+    fflush(stdout);
+    fflush(stderr);
+    int pid = fork();
+    if (pid < 0) {
+        log_messages.printf(MSG_CRITICAL,
+            "fork() failed for worker %d: %d\n", index, errno
+        );
+    }
+    return pid;
+}
+
+int fork_workers(int n, void (*poll_func)(), int poll_period) {
+    std::vector<int> pids(n, 0);
+    int i, pid, status, nrunning = 0;
+    double next_poll_time = 0;
+
+    for (i=0; i<n; i++) {
+        pid = fork_worker(i);
+        if (pid == 0) return i;
+        if (pid > 0) {
+            pids[i] = pid;
+            nrunning++;
+        }
+    }
+    log_messages.printf(MSG_NORMAL, "started %d worker processes\n", nrunning);
+
+    bool stopping = false;
+    while (nrunning) {
+        if (caught_stop_signal && !stopping) {
+            log_messages.printf(MSG_NORMAL, "stopping workers\n");
+            for (i=0; i<n; i++) {
+                if (pids[i]) kill(pids[i], STOP_SIGNAL);
+            }
+            stopping = true;
+        }
+        pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0) {
+            if (poll_func && !stopping && dtime() > next_poll_time) {
+                poll_func();
+                next_poll_time = dtime() + poll_period;
+            }
+            sleep(1);
+            continue;
+        }
+        for (i=0; i<n; i++) {
+            if (pids[i] != pid) continue;
+            pids[i] = 0;
+            nrunning--;
+            if (stopping || (WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+                log_messages.printf(MSG_NORMAL,
+                    "worker %d (PID %d) exited\n", i, pid
+                );
+                break;
+            }
+            log_messages.printf(MSG_CRITICAL,
+                "worker %d (PID %d) failed (status %d); restarting in 10 sec\n",
+                i, pid, status
+            );
+            sleep(10);
+            pid = fork_worker(i);
+            if (pid == 0) return i;
+            if (pid > 0) {
+                pids[i] = pid;
+                nrunning++;
+            }
+            break;
+        }
+    }
+    log_messages.printf(MSG_NORMAL, "all workers have exited\n");
+    exit(0);
+}
+
 bool check_stop_sched() {
     return boinc_file_exists(config.project_path(STOP_SCHED_FILENAME));
 }
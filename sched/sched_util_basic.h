@@ -37,9 +37,20 @@ extern void check_stop_daemons();
 extern void daemon_sleep(int);
 extern bool check_stop_sched();
 extern void install_stop_signal_handler();
+extern bool caught_stop_signal;
 extern int try_fopen(const char* path, FILE*& f, const char* mode);
 extern int get_log_path(char*, const char*);
 
+// Split a daemon into n worker processes.
+// Returns the worker's index (0..n-1) in each worker.
+// Doesn't return in the parent, which restarts workers that exit
+// with nonzero status, passes on the stop signal,
+// and exits when all workers have exited with zero status.
+// If poll_func is given, the parent calls it every poll_period seconds.
+// Call this before opening DB connections.
+//
+extern int fork_workers(int n, void (*poll_func)()=NULL, int poll_period=60);
+
 // convert filename to path in a hierarchical directory system
 //
 extern int dir_hier_path(
@@ -34,6 +34,7 @@ void usage(char *name) {
         "Displays the work_item part of shared-memory structure.\n\n"
         "Usage: %s [OPTION]\n\n"
         "Options:\n"
+        "  [ --index ]            Show the job index instead of the job array.\n"
         "  [ -h | --help ]        Show this help text.\n"
         "  [ -v | --version ]     Shows version information.\n",
         name
@@ -44,10 +45,13 @@ int main(int argc, char *argv[]) {
     SCHED_SHMEM* ssp;
     int retval;
     void* p;
+    bool show_index = false;
 
     for (int c = 1; c < argc; c++) {
         std::string option(argv[c]);
-        if(option == "-h" || option == "--help") {
+        if (option == "--index") {
+            show_index = true;
+        } else if(option == "-h" || option == "--help") {
             usage(argv[0]);
             exit(0);
         } else if(option == "-v" || option == "--version") {
@@ -72,7 +76,11 @@ int main(int argc, char *argv[]) {
     }
     ssp = (SCHED_SHMEM*)p;
     retval = ssp->verify();
-    ssp->show(stdout);
+    if (show_index) {
+        ssp->show_job_index(stdout);
+    } else {
+        ssp->show(stdout);
+    }
 }
 
 const char *BOINC_RCSID_a370415aab = "$Id$";
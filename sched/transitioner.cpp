@@ -24,8 +24,17 @@
 //   [ --one_pass ]          do one pass, then exit
 //   [ --d x ]               debug level x
 //   [ --mod n i ]           process only WUs with (id mod n) == i
+//   [ --nworkers n ]        split into n worker processes,
+//                           each handling a subset of the WUs
 //   [ --sleep_interval x ]  sleep x seconds if nothing to do
 //   [ --wu_id n ]           transition WU n (debugging)
+//
+// With --nworkers, each worker has its own DB connection and
+// handles the WUs with (id mod n) == worker index
+// (within the subset given by --mod, if any).
+// Each worker logs its throughput after every pass,
+// and the parent process logs the number of overdue WUs
+// (the transition backlog) every BACKLOG_PERIOD seconds.
 
 #include "config.h"
 #include <vector>
@@ -61,6 +70,7 @@
 #define SELECT_LIMIT    1000
 
 #define DEFAULT_SLEEP_INTERVAL  5
+#define BACKLOG_PERIOD          60
 
 int startup_time;
 R_RSA_PRIVATE_KEY key;
@@ -69,6 +79,7 @@ bool do_mod = false;
 bool one_pass = false;
 int sleep_interval = DEFAULT_SLEEP_INTERVAL;
 int wu_id = 0;
+int nworkers = 0;
 
 void signal_handler(int) {
     log_messages.printf(MSG_NORMAL, "Signaled by simulator\n");
@@ -688,6 +699,8 @@ bool do_pass() {
     DB_TRANSITIONER_ITEM_SET transitioner;
     std::vector<TRANSITIONER_ITEM> items;
     bool did_something = false;
+    int nwus = 0;
+    double start_time = dtime();
 
     if (!one_pass) check_stop_daemons();
 
@@ -725,13 +738,67 @@ bool do_pass() {
             //
             exit(1);
         }
+        nwus++;
 
         if (!one_pass) check_stop_daemons();
         if (wu_id) break;
     }
+    if (nwus) {
+        double dt = dtime() - start_time;
+        log_messages.printf(MSG_NORMAL,
+            "pass done: %d WUs in %.1f sec (%.1f WUs/sec)\n",
+            nwus, dt, dt>0?nwus/dt:0
+        );
+    }
     return did_something;
 }
 
+// called periodically in the parent process if using --nworkers.
+// Log the number of WUs that are due for transition.
+//
+void show_backlog() {
+    static bool db_opened = false;
+    char clause[256], buf[256];
+    long n;
+    double min_time;
+    int retval;
+
+    if (!db_opened) {
+        retval = boinc_db.open(
+            config.db_name, config.db_host, config.db_user, config.db_passwd
+        );
+        if (retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "boinc_db.open: %s\n", boincerror(retval)
+            );
+            return;
+        }
+        db_opened = true;
+    }
+    int now = (int)time(0);
+    sprintf(clause, "where transition_time < %d", now);
+    if (do_mod) {
+        sprintf(buf, " and id %% %d = %d", mod_n, mod_i);
+        strcat(clause, buf);
+    }
+    retval = count_workunits(n, clause);
+    if (retval) {
+        log_messages.printf(MSG_CRITICAL,
+            "count_workunits(): %s\n", boincerror(retval)
+        );
+        return;
+    }
+    sprintf(buf, "select min(transition_time) from workunit %s", clause);
+    retval = boinc_db.get_double(buf, min_time);
+    if (retval || n == 0) {
+        min_time = now;
+    }
+    log_messages.printf(MSG_NORMAL,
+        "backlog: %ld WUs due for transition, oldest %.0f sec overdue\n",
+        n, now - min_time
+    );
+}
+
 void main_loop() {
     int retval;
 
@@ -772,6 +839,7 @@ void usage(char *name) {
         "  [ --one_pass ]                  do one pass, then exit\n"
         "  [ --d x ]                       debug level x\n"
         "  [ --mod n i ]                   process only WUs with (id mod n) == i\n"
+        "  [ --nworkers n ]                use n worker processes\n"
         "  [ --sleep_interval x ]          sleep x seconds if nothing to do\n"
         "  [ -h | --help ]                 Show this help text.\n"
         "  [ -v | --version ]              Shows version information.\n",
@@ -805,6 +873,13 @@ int main(int argc, char** argv) {
             mod_n = atoi(argv[++i]);
             mod_i = atoi(argv[++i]);
             do_mod = true;
+        } else if (is_arg(argv[i], "nworkers")) {
+            if (!argv[++i]) {
+                log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
+                usage(argv[0]);
+                exit(1);
+            }
+            nworkers = atoi(argv[i]);
         } else if (is_arg(argv[i], "sleep_interval")) {
             if (!argv[++i]) {
                 log_messages.printf(MSG_CRITICAL, "%s requires an argument\n\n", argv[--i]);
@@ -846,6 +921,24 @@ int main(int argc, char** argv) {
 
     install_stop_signal_handler();
 
+    if (nworkers > 1 && !wu_id) {
+        int k = fork_workers(nworkers, show_backlog, BACKLOG_PERIOD);
+
+        // worker k handles the k'th subset of our WUs
+        //
+        if (do_mod) {
+            mod_i += k*mod_n;
+            mod_n *= nworkers;
+        } else {
+            mod_n = nworkers;
+            mod_i = k;
+            do_mod = true;
+        }
+        log_messages.printf(MSG_NORMAL,
+            "worker %d: handling WUs with ID mod %d = %d\n", k, mod_n, mod_i
+        );
+    }
+
     main_loop();
 }
 
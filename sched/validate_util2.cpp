@@ -38,6 +38,23 @@
 
 using std::vector;
 
+// check_pair() is called once for each new result of a WU,
+// with the same canonical result each time.
+// To avoid re-reading the canonical result's output files each time,
+// keep its init_result() data until we're called with a different one.
+//
+static DB_ID_TYPE canonical_id = 0;
+static RESULT canonical_result;
+static void* canonical_data = NULL;
+
+static void release_canonical_data() {
+    if (canonical_id) {
+        cleanup_result(canonical_result, canonical_data);
+        canonical_id = 0;
+        canonical_data = NULL;
+    }
+}
+
 // Given a set of results:
 // 1) call init_result() for each one;
 //    this detects results with bad or missing output files
@@ -68,6 +85,7 @@ int check_set(
     int i, j, neq = 0, n, retval;
     int min_valid = wu.min_quorum/2+1;
 
+    release_canonical_data();
     retry = false;
     n = results.size();
     data.resize(n);
@@ -166,7 +184,6 @@ cleanup:
 //
 void check_pair(RESULT& r1, RESULT& r2, bool& retry) {
     void* data1;
-    void* data2;
     int retval;
     bool match;
 
@@ -189,28 +206,32 @@ void check_pair(RESULT& r1, RESULT& r2, bool& retry) {
         return;
     }
 
-    retval = init_result(r2, data2);
-    if (retval == ERR_OPENDIR) {
-        log_messages.printf(MSG_CRITICAL,
-            "check_pair: init_result([RESULT#%lu %s]) transient failure 2\n",
-            r2.id, r2.name
-        );
-        cleanup_result(r1, data1);
-        retry = true;
-        return;
-    } else if (retval) {
-        log_messages.printf(MSG_CRITICAL,
-            "check_pair: init_result([RESULT#%lu %s]) perm failure2\n",
-            r2.id, r2.name
-        );
-        cleanup_result(r1, data1);
-        r1.outcome = RESULT_OUTCOME_VALIDATE_ERROR;
-        r1.validate_state = VALIDATE_STATE_INVALID;
-        return;
+    if (canonical_id != r2.id) {
+        release_canonical_data();
+        retval = init_result(r2, canonical_data);
+        if (retval == ERR_OPENDIR) {
+            log_messages.printf(MSG_CRITICAL,
+                "check_pair: init_result([RESULT#%lu %s]) transient failure 2\n",
+                r2.id, r2.name
+            );
+            cleanup_result(r1, data1);
+            retry = true;
+            return;
+        } else if (retval) {
+            log_messages.printf(MSG_CRITICAL,
+                "check_pair: init_result([RESULT#%lu %s]) perm failure2\n",
+                r2.id, r2.name
+            );
+            cleanup_result(r1, data1);
+            r1.outcome = RESULT_OUTCOME_VALIDATE_ERROR;
+            r1.validate_state = VALIDATE_STATE_INVALID;
+            return;
+        }
+        canonical_id = r2.id;
+        canonical_result = r2;
     }
 
-    retval = compare_results(r1, data1, r2, data2, match);
+    retval = compare_results(r1, data1, canonical_result, canonical_data, match);
     r1.validate_state = match?VALIDATE_STATE_VALID:VALIDATE_STATE_INVALID;
     cleanup_result(r1, data1);
-    cleanup_result(r2, data2);
 }
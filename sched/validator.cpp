@@ -32,6 +32,8 @@
 //  [--one_pass_N_WU N]         Validate only N WU in one pass, then exit
 //  [--one_pass]                make one pass through WU table, then exit
 //  [--mod n i]                 process only WUs with (id mod n) == i
+//  [--nworkers n]              split into n worker processes,
+//                              each validating a subset of the WUs
 //  [--max_granted_credit X]    limit maximum granted credit to X
 //  [--update_credited_job]     add userid/wuid pair to credited_job table
 //
@@ -44,6 +46,12 @@
 //  [--credit_from_wu]          get credit from workunit.canonical_credit
 //  [--credit_from_runtime]     grant credit based on runtime,
 //  [--wu_id n]                 Validate WU n (debugging)
+//
+// With --nworkers, each worker has its own DB connection and
+// handles the WUs with (id mod n) == worker index
+// (within the subset given by --mod, if any).
+// This lets validation of large output files use several CPUs.
+// Each worker logs its throughput after every pass.
 
 #include "config.h"
 #include <unistd.h>
@@ -92,6 +100,7 @@ char app_name[256];
 DB_APP app;
 int wu_id_modulus=0;
 int wu_id_remainder=0;
+int nworkers=0;
 int wu_id_min=0;
 int wu_id_max=0;
 int one_pass_N_WU=0;
@@ -728,7 +737,8 @@ bool do_validate_scan() {
     DB_VALIDATOR_ITEM_SET validator;
     std::vector<VALIDATOR_ITEM> items;
     bool found=false;
-    int retval, i=0;
+    int retval, i=0, nwus=0;
+    double start = dtime();
 
     // loop over entries that need to be checked
     //
@@ -752,10 +762,20 @@ bool do_validate_scan() {
             break;
         }
         retval = handle_wu(validator, items);
-        if (!retval) found = true;
+        if (!retval) {
+            found = true;
+            nwus++;
+        }
         if (++i == one_pass_N_WU) break;
         if (wu_id) break;
     }
+    if (nwus) {
+        double dt = dtime() - start;
+        log_messages.printf(MSG_NORMAL,
+            "pass done: %d WUs in %.1f sec (%.1f WUs/sec)\n",
+            nwus, dt, dt>0?nwus/dt:0
+        );
+    }
     return found;
 }
 
@@ -810,6 +830,7 @@ void usage(char* name) {
         "    [--one_pass]               Make one pass through WU table, then exit\n"
         "    [--dry_run]                Don't update db, just write logs (for debugging)\n"
         "    [--mod n i]                Process only WUs with (id mod n) == i\n"
+        "    [--nworkers n]             Use n worker processes\n"
         "    [--max_wu_id n]            Process only WUs with id <= n\n"
         "    [--min_wu_id n]            Process only WUs with id >= n\n"
         "    [--max_granted_credit X]   Grant no more than this amount of credit to a result\n"
@@ -868,6 +889,8 @@ int main(int argc, char** argv) {
         } else if (is_arg(argv[i], "mod")) {
             wu_id_modulus = atoi(argv[++i]);
             wu_id_remainder = atoi(argv[++i]);
+        } else if (is_arg(argv[i], "nworkers")) {
+            nworkers = atoi(argv[++i]);
         } else if (is_arg(argv[i], "min_wu_id")) {
             wu_id_min = atoi(argv[++i]);
         } else if (is_arg(argv[i], "max_wu_id")) {
@@ -909,6 +932,23 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
+    // fork before opening the DB; each worker gets its own connection
+    //
+    if (nworkers > 1 && !wu_id) {
+        install_stop_signal_handler();
+        int k = fork_workers(nworkers);
+
+        // worker k handles the k'th subset of our WUs
+        //
+        if (wu_id_modulus) {
+            wu_id_remainder += k*wu_id_modulus;
+            wu_id_modulus *= nworkers;
+        } else {
+            wu_id_modulus = nworkers;
+            wu_id_remainder = k;
+        }
+    }
+
     retval = boinc_db.open(
         config.db_name, config.db_host, config.db_user, config.db_passwd
     );
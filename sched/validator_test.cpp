@@ -25,14 +25,24 @@
 // validator_test file1 file2
 // and it will compare those two output files
 // (this only works if your functions expect 1 file per result)
+//
+// With --bench N it instead times N simulated workunits,
+// each validated with check_set() followed by check_pair() calls
+// for late results, and prints the throughput in WUs/sec.
+// --synth nbytes first writes identical pseudo-random contents
+// of the given size to file1 and file2.
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "svn_version.h"
+#include "util.h"
 #include "sched_util_basic.h"
 #include "validate_util.h"
 #include "validate_util2.h"
 
+using std::vector;
+
 void usage(char* prog) {
     fprintf(stderr,
         "This program is a test validator; \n"
@@ -40,10 +50,14 @@ void usage(char* prog) {
     );
     fprintf(stderr, "usage: %s [options] file1 file2\n"
         "    Options:\n"
-        "    [-h|--help]     Print this usage information and exit\n"
-        "    [-v|--version]  Print version information and exit\n"
-        "    file1           Path to file to be compared (must be second to last)\n"
-        "    file2           Path to file to be compared (must be last)\n"
+        "    [-h|--help]       Print this usage information and exit\n"
+        "    [-v|--version]    Print version information and exit\n"
+        "    [--bench N]       Time validation of N simulated WUs\n"
+        "    [--nresults n]    With --bench: results per WU passed to check_set() (default 2)\n"
+        "    [--npair n]       With --bench: late results per WU passed to check_pair() (default 2)\n"
+        "    [--synth nbytes]  Write identical pseudo-random files of this size to file1, file2\n"
+        "    file1             Path to file to be compared (must be second to last)\n"
+        "    file2             Path to file to be compared (must be last)\n"
         "\n",
         prog);
     validate_handler_usage();
@@ -54,24 +68,140 @@ int get_output_file_info(RESULT r, OUTPUT_FILE_INFO& fi) {
     return 0;
 }
 
+// write the same pseudo-random data to both files
+//
+int write_synth_files(const char* path1, const char* path2, double nbytes) {
+    char buf[65536];
+    FILE* f1 = fopen(path1, "wb");
+    FILE* f2 = fopen(path2, "wb");
+    if (!f1 || !f2) {
+        if (f1) fclose(f1);
+        if (f2) fclose(f2);
+        return -1;
+    }
+    srand(1);
+    while (nbytes > 0) {
+        size_t n = nbytes < sizeof(buf) ? (size_t)nbytes : sizeof(buf);
+        for (size_t i=0; i<n; i++) {
+            buf[i] = (char)(rand() & 0xff);
+        }
+        fwrite(buf, 1, n, f1);
+        fwrite(buf, 1, n, f2);
+        nbytes -= n;
+    }
+    fclose(f1);
+    fclose(f2);
+    return 0;
+}
+
+// Simulate the validator's work for nwus workunits:
+// check_set() on a quorum of nresults,
+// then check_pair() for npair late results against the canonical one.
+// Results alternate between the two files.
+//
+void bench(int nwus, int nresults, int npair, char* path1, char* path2) {
+    vector<RESULT> results(nresults);
+    RESULT late;
+    WORKUNIT wu;
+    DB_ID_TYPE id = 1, canonicalid;
+    double credit;
+    bool retry;
+    int i, j, k, nvalid = 0;
+
+    wu.min_quorum = nresults;
+    double start = dtime();
+    for (i=0; i<nwus; i++) {
+        for (j=0; j<nresults; j++) {
+            results[j].id = id++;
+            sprintf(results[j].name, "bench_%d_%d", i, j);
+            sprintf(results[j].xml_doc_in,
+                "<file_ref><file_name>%s</file_name></file_ref>",
+                j%2?path2:path1
+            );
+            results[j].outcome = RESULT_OUTCOME_SUCCESS;
+            results[j].validate_state = VALIDATE_STATE_INIT;
+        }
+        canonicalid = 0;
+        check_set(results, wu, canonicalid, credit, retry);
+        if (!canonicalid) continue;
+        nvalid++;
+        for (k=0; k<nresults; k++) {
+            if (results[k].id == canonicalid) break;
+        }
+        RESULT& canonical = results[k];
+        for (j=0; j<npair; j++) {
+            late.id = id++;
+            sprintf(late.name, "bench_%d_late_%d", i, j);
+            sprintf(late.xml_doc_in,
+                "<file_ref><file_name>%s</file_name></file_ref>",
+                j%2?path1:path2
+            );
+            check_pair(late, canonical, retry);
+        }
+    }
+    double dt = dtime() - start;
+    printf("%d WUs (%d valid) in %.3f sec: %.2f WUs/sec\n",
+        nwus, nvalid, dt, dt>0?nwus/dt:0
+    );
+}
+
+static void missing_argument(char* prog, char* arg) {
+    fprintf(stderr, "%s requires an argument\n\n", arg);
+    usage(prog);
+    exit(1);
+}
+
 int main(int argc, char** argv) {
     int retval;
+    int nbench = 0, nresults = 2, npair = 2;
+    double synth_nbytes = 0;
 
-    if (argc > 1) {
-      if (is_arg(argv[1], "h") || is_arg(argv[1], "help")) {
-        usage(argv[0]);
-        exit(0);
-      } else if (is_arg(argv[1], "v") || is_arg(argv[1], "version")) {
-        printf("%s\n", SVN_VERSION);
-        exit(0);
-      }
+    // arguments other than ours (including the file names)
+    // are passed to the handler
+    //
+    vector<char*> handler_argv;
+    handler_argv.push_back(argv[0]);
+    for (int i=1; i<argc; i++) {
+        if (is_arg(argv[i], "h") || is_arg(argv[i], "help")) {
+            usage(argv[0]);
+            exit(0);
+        } else if (is_arg(argv[i], "v") || is_arg(argv[i], "version")) {
+            printf("%s\n", SVN_VERSION);
+            exit(0);
+        } else if (is_arg(argv[i], "bench")) {
+            if (!argv[++i]) missing_argument(argv[0], argv[i-1]);
+            nbench = atoi(argv[i]);
+        } else if (is_arg(argv[i], "nresults")) {
+            if (!argv[++i]) missing_argument(argv[0], argv[i-1]);
+            nresults = atoi(argv[i]);
+        } else if (is_arg(argv[i], "npair")) {
+            if (!argv[++i]) missing_argument(argv[0], argv[i-1]);
+            npair = atoi(argv[i]);
+        } else if (is_arg(argv[i], "synth")) {
+            if (!argv[++i]) missing_argument(argv[0], argv[i-1]);
+            synth_nbytes = atof(argv[i]);
+        } else {
+            handler_argv.push_back(argv[i]);
+        }
     }
-    if (argc < 3) {
+    int nargs = (int)handler_argv.size();
+    if (nargs < 3) {
         usage(argv[0]);
         exit(0);
     }
+    char* file1 = handler_argv[nargs-2];
+    char* file2 = handler_argv[nargs-1];
+    handler_argv.push_back(NULL);
+
+    if (synth_nbytes > 0) {
+        retval = write_synth_files(file1, file2, synth_nbytes);
+        if (retval) {
+            fprintf(stderr, "can't write synthetic files\n");
+            exit(1);
+        }
+    }
 
-    retval = validate_handler_init(argc, argv);
+    retval = validate_handler_init(nargs, &handler_argv[0]);
     if (retval) exit(1);
 
     void* data1, *data2;
@@ -80,8 +210,14 @@ int main(int argc, char** argv) {
 
     standalone = true;
 
-    sprintf(r1.xml_doc_in, "<file_ref><file_name>%s</file_name></file_ref>", argv[argc-2]);
-    sprintf(r2.xml_doc_in, "<file_ref><file_name>%s</file_name></file_ref>", argv[argc-1]);
+    if (nbench) {
+        if (nresults < 2) nresults = 2;
+        bench(nbench, nresults, npair, file1, file2);
+        exit(0);
+    }
+
+    sprintf(r1.xml_doc_in, "<file_ref><file_name>%s</file_name></file_ref>", file1);
+    sprintf(r2.xml_doc_in, "<file_ref><file_name>%s</file_name></file_ref>", file2);
 
     retval = init_result(r1, data1);
     if (retval) {
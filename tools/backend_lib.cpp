@@ -303,13 +303,19 @@ int create_work2(
 
     // check for presence of result template.
     // we don't need to actually look at it.
+    // When creating many jobs, they usually have the same one;
+    // remember the last one found.
     //
-    const char* p = config_loc.project_path(result_template_filename);
-    if (!boinc_file_exists(p)) {
-        fprintf(stderr,
-            "create_work: result template file %s doesn't exist\n", p
-        );
-        return retval;
+    static string last_result_template;
+    if (last_result_template != result_template_filename) {
+        const char* p = config_loc.project_path(result_template_filename);
+        if (!boinc_file_exists(p)) {
+            fprintf(stderr,
+                "create_work: result template file %s doesn't exist\n", p
+            );
+            return retval;
+        }
+        last_result_template = result_template_filename;
     }
 
     if (strlen(result_template_filename) > sizeof(wu.result_template_file)-1) {
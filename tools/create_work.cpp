@@ -28,6 +28,7 @@
 #include <cstring>
 #include <ctime>
 #include <string>
+#include <vector>
 #include <map>
 #include <sys/param.h>
 #include <unistd.h>
@@ -42,12 +43,20 @@
 #include "util.h"
 
 #include "backend_lib.h"
+#include "process_input_template.h"
 
 using std::string;
+using std::vector;
 using std::map;
 
+// with --stdin, read this many jobs at a time,
+// and compute the MD5s of their input files in parallel
+//
+#define STDIN_CHUNK_SIZE    1000
+
 bool verbose = false;
 bool continue_on_error = false;
+int md5_threads = 4;
 
 void usage() {
     fprintf(stderr,
@@ -70,6 +79,7 @@ void usage() {
         "   [ --max_error_results n ]\n"
         "   [ --max_success_results n ]\n"
         "   [ --max_total_results n ]\n"
+        "   [ --md5_threads n ]             with --stdin; default 4\n"
         "   [ --min_quorum n ]\n"
         "   [ --priority n ]\n"
         "   [ --result_template filename ]  default: appname_out\n"
@@ -154,7 +164,7 @@ struct JOB_DESC {
         wu.delay_bound = DEFAULT_DELAY_BOUND;
 
     }
-    void create();
+    int create();
     void parse_cmdline(int, char**);
 };
 
@@ -205,7 +215,7 @@ void JOB_DESC::parse_cmdline(int argc, char** argv) {
 // To avoid rereading files, cache them in a map.
 // Get from cache if there, else read the file and add to cache
 //
-void get_wu_template(JOB_DESC& jd2) {
+int get_wu_template(JOB_DESC& jd2) {
     // the jobs may specify WU templates.
     //
     static map<string, char*> wu_templates;
@@ -218,11 +228,40 @@ void get_wu_template(JOB_DESC& jd2) {
             fprintf(
                 stderr, "Can't read WU template %s\n", jd2.wu_template_file
             );
-            exit(1);
+            return retval;
         }
         wu_templates[s] = p;
     }
     strcpy(jd2.wu_template, wu_templates[s]);
+    return 0;
+}
+
+// Read the next chunk of job lines from stdin,
+// and compute the MD5s of the jobs' input files in parallel
+// so that create_work2() doesn't have to do it one file at a time.
+// Return false if no more lines.
+//
+bool read_stdin_chunk(vector<string>& lines) {
+    char buf[4096];
+    int _argc;
+    char* _argv[100];
+    JOB_DESC* scan = new JOB_DESC;
+    vector<INFILE_DESC> infiles;
+
+    lines.clear();
+    clear_md5_info();
+    while ((int)lines.size() < STDIN_CHUNK_SIZE) {
+        char* p = fgets(buf, sizeof(buf), stdin);
+        if (p == NULL) break;
+        lines.push_back(buf);
+        scan->infiles.clear();
+        _argc = parse_command_line(buf, _argv);
+        scan->parse_cmdline(_argc, _argv);
+        infiles.insert(infiles.end(), scan->infiles.begin(), scan->infiles.end());
+    }
+    delete scan;
+    prefetch_md5_info(infiles, config, md5_threads);
+    return !lines.empty();
 }
 
 int main(int argc, char** argv) {
@@ -342,6 +381,9 @@ int main(int argc, char** argv) {
             verbose = true;
         } else if (arg(argv, i, "continue_on_error")) {
             continue_on_error = true;
+        } else if (arg(argv, i, "md5_threads")) {
+            md5_threads = atoi(argv[++i]);
+            if (md5_threads < 1) md5_threads = 1;
         } else if (arg(argv, i, "keywords")) {
             strcpy(jd.wu.keywords, argv[++i]);
         } else {
@@ -427,100 +469,124 @@ int main(int argc, char** argv) {
             // if we're doing assignment we can't use the bulk-query method;
             // create the jobs one at a time.
             //
+            // Do each chunk of jobs in a transaction
+            // so that the DB doesn't commit each insert separately.
+            // If a job fails, commit the ones before it
+            // (their input files are already staged) and stop.
+            //
             int _argc;
             char* _argv[100];
-            for (int j=0; ; j++) {
-                char* p = fgets(buf, sizeof(buf), stdin);
-                if (p == NULL) break;
-                JOB_DESC jd2 = jd;
-                strcpy(jd2.wu.name, "");
-                _argc = parse_command_line(buf, _argv);
-                jd2.parse_cmdline(_argc, _argv);
-                if (!strlen(jd2.wu.name)) {
-                    sprintf(jd2.wu.name, "%s_%d", jd.wu.name, j);
-                }
-                if (strlen(jd2.wu_template_file)) {
-                    get_wu_template(jd2);
-                }
-                if (!strlen(jd2.wu_template)) {
-                    fprintf(stderr, "job is missing input template\n");
-                    exit(1);
+            vector<string> lines;
+            int j = 0;
+            while (read_stdin_chunk(lines)) {
+                boinc_db.start_transaction();
+                for (unsigned int k=0; k<lines.size(); k++, j++) {
+                    safe_strcpy(buf, lines[k].c_str());
+                    JOB_DESC jd2 = jd;
+                    strcpy(jd2.wu.name, "");
+                    _argc = parse_command_line(buf, _argv);
+                    jd2.parse_cmdline(_argc, _argv);
+                    if (!strlen(jd2.wu.name)) {
+                        sprintf(jd2.wu.name, "%s_%d", jd.wu.name, j);
+                    }
+                    retval = 0;
+                    if (strlen(jd2.wu_template_file)) {
+                        retval = get_wu_template(jd2);
+                    }
+                    if (!retval && !strlen(jd2.wu_template)) {
+                        fprintf(stderr, "job is missing input template\n");
+                        retval = ERR_NOT_FOUND;
+                    }
+                    if (!retval) {
+                        retval = jd2.create();
+                    }
+                    if (retval) {
+                        boinc_db.commit_transaction();
+                        fprintf(stderr,
+                            "create_work: job on stdin line %d failed; previous jobs were created\n",
+                            j+1
+                        );
+                        exit(1);
+                    }
                 }
-                jd2.create();
+                boinc_db.commit_transaction();
             }
         } else {
             string values;
             DB_WORKUNIT wu;
             int _argc;
             char* _argv[100], value_buf[MAX_QUERY_LEN];
-            for (int j=0; ; j++) {
-                char* p = fgets(buf, sizeof(buf), stdin);
-                if (p == NULL) break;
-                JOB_DESC jd2 = jd;
-                strcpy(jd2.wu.name, "");
-                _argc = parse_command_line(buf, _argv);
-                jd2.parse_cmdline(_argc, _argv);
-                if (!strlen(jd2.wu.name)) {
-                    sprintf(jd2.wu.name, "%s_%d", jd.wu.name, j);
-                }
-                // if the stdin line specified assignment,
-                // create the job individually
-                //
-                if (jd2.assign_flag) {
-                    jd2.create();
-                    continue;
-                }
-                // otherwise accumulate a SQL query so that we can
-                // create jobs en masse
-                //
-                if (strlen(jd2.wu_template_file)) {
-                    get_wu_template(jd2);
-                }
-                if (!strlen(jd2.wu_template)) {
-                    fprintf(stderr, "job is missing input template\n");
-                    exit(1);
-                }
-                retval = create_work2(
-                    jd2.wu,
-                    jd2.wu_template,
-                    jd2.result_template_file,
-                    jd2.result_template_path,
-                    jd2.infiles,
-                    config,
-                    jd2.command_line,
-                    NULL,
-                    value_buf
-                );
-                if (retval) {
-                    fprintf(stderr, "create_work() failed: %d\n", retval);
-                    if (continue_on_error) {
+            vector<string> lines;
+            int j = 0;
+            while (read_stdin_chunk(lines)) {
+                for (unsigned int k=0; k<lines.size(); k++, j++) {
+                    safe_strcpy(buf, lines[k].c_str());
+                    JOB_DESC jd2 = jd;
+                    strcpy(jd2.wu.name, "");
+                    _argc = parse_command_line(buf, _argv);
+                    jd2.parse_cmdline(_argc, _argv);
+                    if (!strlen(jd2.wu.name)) {
+                        sprintf(jd2.wu.name, "%s_%d", jd.wu.name, j);
+                    }
+                    // if the stdin line specified assignment,
+                    // create the job individually
+                    //
+                    if (jd2.assign_flag) {
+                        if (jd2.create()) exit(1);
                         continue;
-                    } else {
+                    }
+                    // otherwise accumulate a SQL query so that we can
+                    // create jobs en masse
+                    //
+                    if (strlen(jd2.wu_template_file)) {
+                        if (get_wu_template(jd2)) exit(1);
+                    }
+                    if (!strlen(jd2.wu_template)) {
+                        fprintf(stderr, "job is missing input template\n");
                         exit(1);
                     }
-                }
-                if (values.size()) {
-                    values += ",";
-                    values += value_buf;
-                } else {
-                    values = value_buf;
-                }
-                // MySQL can handles queries at least 1 MB
-                //
-                int n = strlen(value_buf);
-                if (values.size() + 2*n > 1000000) {
-                    retval = wu.insert_batch(values);
+                    retval = create_work2(
+                        jd2.wu,
+                        jd2.wu_template,
+                        jd2.result_template_file,
+                        jd2.result_template_path,
+                        jd2.infiles,
+                        config,
+                        jd2.command_line,
+                        NULL,
+                        value_buf
+                    );
                     if (retval) {
-                        fprintf(stderr,
-                            "wu.insert_batch() failed: %d; size %d\n",
-                            retval, (int)values.size()
-                        );
-                        fprintf(stderr,
-                            "MySQL error: %s\n", boinc_db.error_string()
-                        );
-                        exit(1);
+                        fprintf(stderr, "create_work() failed: %d\n", retval);
+                        if (continue_on_error) {
+                            continue;
+                        } else {
+                            exit(1);
+                        }
+                    }
+                    if (values.size()) {
+                        values += ",";
+                        values += value_buf;
+                    } else {
+                        values = value_buf;
+                    }
+                    // MySQL can handles queries at least 1 MB
+                    //
+                    int n = strlen(value_buf);
+                    if (values.size() + 2*n > 1000000) {
+                        retval = wu.insert_batch(values);
+                        if (retval) {
+                            fprintf(stderr,
+                                "wu.insert_batch() failed: %d; size %d\n",
+                                retval, (int)values.size()
+                            );
+                            fprintf(stderr,
+                                "MySQL error: %s\n", boinc_db.error_string()
+                            );
+                            exit(1);
+                        }
+                        values.clear();
                     }
-                    values.clear();
                 }
             }
             if (values.size()) {
@@ -537,7 +603,7 @@ int main(int argc, char** argv) {
             }
         }
     } else {
-        jd.create();
+        if (jd.create()) exit(1);
         if (show_wu_name) {
             printf("workunit name: %s\n", jd.wu.name);
         }
@@ -545,7 +611,7 @@ int main(int argc, char** argv) {
     boinc_db.close();
 }
 
-void JOB_DESC::create() {
+int JOB_DESC::create() {
     if (assign_flag) {
         wu.transitioner_flags = assign_multi?TRANSITION_NONE:TRANSITION_NO_NEW_RESULTS;
     }
@@ -560,7 +626,7 @@ void JOB_DESC::create() {
     );
     if (retval) {
         fprintf(stderr, "create_work: %s\n", boincerror(retval));
-        exit(1);
+        return retval;
     }
     if (verbose) {
         fprintf(stderr, "created workunit; name %s, ID %lu\n", wu.name, wu.id);
@@ -578,9 +644,10 @@ void JOB_DESC::create() {
             fprintf(stderr,
                 "assignment.insert() failed: %s\n", boincerror(retval)
             );
-            exit(1);
+            return retval;
         }
     }
+    return 0;
 }
 
 const char *BOINC_RCSID_3865dbbf46 = "$Id$";
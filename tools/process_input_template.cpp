@@ -22,6 +22,8 @@
 
 #include <stdio.h>
 #include <string>
+#include <map>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -37,6 +39,7 @@
 
 using std::string;
 using std::vector;
+using std::map;
 
 // look for file named FILENAME.md5 containing md5sum and length.
 // If found, and newer mod time than file,
@@ -145,6 +148,109 @@ static void write_md5_info(
     return;
 }
 
+// MD5 info for input files, computed by prefetch_md5_info().
+// Keyed by path in the download hierarchy.
+//
+struct MD5_INFO {
+    char md5[33];
+    double nbytes;
+};
+
+static map<string, MD5_INFO> md5_info_cache;
+
+// shared state of prefetch threads
+//
+struct MD5_PREFETCH {
+    SCHED_CONFIG* config;
+    vector<string> paths;
+    vector<MD5_INFO> info;
+    vector<int> status;
+    size_t next;
+    pthread_mutex_t mutex;
+};
+
+static void* md5_prefetch_thread(void* p) {
+    MD5_PREFETCH& mp = *(MD5_PREFETCH*)p;
+    while (1) {
+        pthread_mutex_lock(&mp.mutex);
+        size_t i = mp.next++;
+        pthread_mutex_unlock(&mp.mutex);
+        if (i >= mp.paths.size()) break;
+
+        const char* path = mp.paths[i].c_str();
+        MD5_INFO& mi = mp.info[i];
+        if (mp.config->cache_md5_info && got_md5_info(path, mi.md5, &mi.nbytes)) {
+            mp.status[i] = 0;
+            continue;
+        }
+        mp.status[i] = md5_file(path, mi.md5, mi.nbytes);
+        if (!mp.status[i] && mp.config->cache_md5_info) {
+            write_md5_info(path, mi.md5, mi.nbytes);
+        }
+    }
+    return NULL;
+}
+
+// Compute the MD5s and sizes of the given (local) input files,
+// using nthreads threads, and remember them
+// for later calls to process_input_template().
+// Files not yet in the download hierarchy are skipped;
+// process_input_template() will stage them.
+//
+void prefetch_md5_info(
+    vector<INFILE_DESC> &infiles, SCHED_CONFIG& config_loc, int nthreads
+) {
+    MD5_PREFETCH mp;
+    char path[MAXPATHLEN];
+
+    for (unsigned int i=0; i<infiles.size(); i++) {
+        if (infiles[i].is_remote) continue;
+        dir_hier_path(
+            infiles[i].name, config_loc.download_dir,
+            config_loc.uldl_dir_fanout, path, true
+        );
+        if (md5_info_cache.count(path)) continue;
+        if (!boinc_file_exists(path)) continue;
+        md5_info_cache[path].nbytes = -1;
+            // placeholder so we don't list the file twice
+        mp.paths.push_back(path);
+    }
+    if (mp.paths.empty()) return;
+
+    mp.config = &config_loc;
+    mp.info.resize(mp.paths.size());
+    mp.status.resize(mp.paths.size(), ERR_NOT_FOUND);
+    mp.next = 0;
+    pthread_mutex_init(&mp.mutex, NULL);
+
+    if (nthreads > (int)mp.paths.size()) nthreads = (int)mp.paths.size();
+    vector<pthread_t> threads;
+    for (int i=1; i<nthreads; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, md5_prefetch_thread, &mp)) break;
+        threads.push_back(t);
+    }
+    md5_prefetch_thread(&mp);
+    for (unsigned int i=0; i<threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&mp.mutex);
+
+    for (unsigned int i=0; i<mp.paths.size(); i++) {
+        if (mp.status[i]) {
+            // let process_input_template() try again and report the error
+            //
+            md5_info_cache.erase(mp.paths[i]);
+        } else {
+            md5_info_cache[mp.paths[i]] = mp.info[i];
+        }
+    }
+}
+
+void clear_md5_info() {
+    md5_info_cache.clear();
+}
+
 // generate a <file_info> element for workunit XML doc,
 // based on the input template and list of variable files
 //
@@ -329,7 +435,11 @@ static int process_file_info(
                     printf("copy %s to %s\n", top_download_path, path);
                 }
 
-                if (!config_loc.cache_md5_info || !got_md5_info(path, md5, &nbytes)) {
+                map<string, MD5_INFO>::iterator mi = md5_info_cache.find(path);
+                if (mi != md5_info_cache.end()) {
+                    strcpy(md5, mi->second.md5);
+                    nbytes = mi->second.nbytes;
+                } else if (!config_loc.cache_md5_info || !got_md5_info(path, md5, &nbytes)) {
                     retval = md5_file(path, md5, nbytes);
                     if (retval) {
                         fprintf(stderr,
@@ -33,4 +33,14 @@ extern int process_input_template(
     const char* additional_xml
 );
 
+// compute MD5s of input files in parallel
+// before creating a batch of jobs that use them
+//
+extern void prefetch_md5_info(
+    std::vector<INFILE_DESC> &infiles,
+    SCHED_CONFIG& config_loc,
+    int nthreads
+);
+extern void clear_md5_info();
+
 #endif